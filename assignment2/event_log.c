@@ -0,0 +1,362 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "event_log.h"
+#include "log_format.h"
+#include "memwatch.h"
+
+#define NAME_BUCKETS (EL_MAX_NAMES * 2)
+#define NO_ENTRY -1
+
+typedef struct _InternedName {
+    char name[EL_NAME_LENGTH];
+    uint8_t type;       // EL_PROGRAM or EL_NODE
+    int next;           // in the same bucket
+} InternedName;
+
+static bool enabled = false;
+static int64_t baseMonotonic;
+static int64_t baseRealtime;
+
+// id i lives in names[i - 1]
+static InternedName names[EL_MAX_NAMES - 1];
+static int nameCount = 0;
+static int buckets[NAME_BUCKETS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t clockNs(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// a time known only to the second is put in the middle of it, so the drift
+// between the two clocks never moves it into the next or last one
+static int64_t monotonicAt(time_t when) {
+    return baseMonotonic + ((int64_t) when * 1000000000LL + 500000000LL - baseRealtime);
+}
+
+static unsigned int hashName(uint8_t type, const char *name) {
+    unsigned int hash = 2166136261u ^ type;
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (unsigned char) *name) * 16777619u;
+    }
+    return hash % NAME_BUCKETS;
+}
+
+static size_t putRecord(char *buffer, size_t size, EventType type, int64_t time, int pid, unsigned int value,
+                        uint16_t program, uint16_t node, const char *text, size_t length) {
+    if (size < sizeof(EventRecord)) {
+        return 0;
+    }
+    if (length > size - sizeof(EventRecord)) {
+        length = size - sizeof(EventRecord);
+    }
+    if (length > EL_MAX_TEXT) {
+        length = EL_MAX_TEXT;
+    }
+    EventRecord record;
+    memset(&record, 0, sizeof(record));
+    record.time = time;
+    record.pid = pid;
+    record.value = value;
+    record.program = program;
+    record.node = node;
+    record.length = (uint16_t) length;
+    record.type = (uint8_t) type;
+    memcpy(buffer, &record, sizeof(record));
+    if (text != buffer + sizeof(record)) {
+        memcpy(buffer + sizeof(record), text, length);
+    }
+    return sizeof(record) + length;
+}
+
+// must hold lock. Returns the name's id, EL_NO_NAME for an empty name and -1
+// once the table is full. A name seen for the first time gets its DEFINE
+// record written to buffer and *used grows by its length.
+static int intern(uint8_t type, const char *name, char *buffer, size_t size, size_t *used) {
+    if (name == NULL || name[0] == '\0') {
+        return EL_NO_NAME;
+    }
+    unsigned int bucket = hashName(type, name);
+    for (int index = buckets[bucket]; index != NO_ENTRY; index = names[index].next) {
+        if (names[index].type == type && strcmp(names[index].name, name) == 0) {
+            return index + 1;
+        }
+    }
+    size_t length = strlen(name);
+    if (nameCount == EL_MAX_NAMES - 1 || length >= EL_NAME_LENGTH
+        || *used + sizeof(EventRecord) + length > size) {
+        return -1;
+    }
+
+    int index = nameCount++;
+    memcpy(names[index].name, name, length + 1);
+    names[index].type = type;
+    names[index].next = buckets[bucket];
+    buckets[bucket] = index;
+    uint16_t id = (uint16_t) (index + 1);
+    *used += putRecord(buffer + *used, size - *used, (EventType) type, 0, 0, 0,
+                       type == EL_PROGRAM ? id : EL_NO_NAME, type == EL_NODE ? id : EL_NO_NAME, name, length);
+    return id;
+}
+
+const char *el_typeName(EventType type) {
+    return type == EL_KILL ? "Action" : "Info";
+}
+
+size_t el_describe(EventType type, int pid, const char *program, const char *node, unsigned int value,
+                   char *out, size_t size) {
+    bool remote = node != NULL && node[0] != '\0';
+    int length = 0;
+    switch (type) {
+        case EL_MONITOR:
+            length = snprintf(out, size, "Initializing monitoring of process '%s' (PID %d)%s%s.",
+                              program, pid, remote ? " on node " : "", remote ? node : "");
+            break;
+        case EL_KILL:
+            if (value == 0) {
+                length = snprintf(out, size, "PID %d (%s)%s%s killed on request.",
+                                  pid, program, remote ? " on " : "", remote ? node : "");
+            }
+            else {
+                length = snprintf(out, size, "PID %d (%s)%s%s killed after exceeding %u seconds.",
+                                  pid, program, remote ? " on " : "", remote ? node : "", value);
+            }
+            break;
+        case EL_NOT_FOUND:
+            if (remote) {
+                length = snprintf(out, size, "No '%s' processes found on %s", program, node);
+            }
+            else {
+                length = snprintf(out, size, "No '%s' processes found.", program);
+            }
+            break;
+        default:
+            out[0] = '\0';
+            break;
+    }
+    if (length < 0) {
+        return 0;
+    }
+    return (size_t) length < size ? (size_t) length : size - 1;
+}
+
+bool el_requested() {
+    char *format = getenv("PROCNANNYLOGFORMAT");
+    return format != NULL && strcasecmp(format, "binary") == 0;
+}
+
+void el_enable() {
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < NAME_BUCKETS; i++) {
+        buckets[i] = NO_ENTRY;
+    }
+    nameCount = 0;
+    baseMonotonic = clockNs(CLOCK_MONOTONIC);
+    baseRealtime = clockNs(CLOCK_REALTIME);
+    enabled = true;
+    pthread_mutex_unlock(&lock);
+}
+
+bool el_enabled() {
+    return enabled;
+}
+
+void el_writePreamble(int fd) {
+    char buffer[sizeof(EventRecord) + EL_NAME_LENGTH];
+    char clock[sizeof(EL_MAGIC) - 1 + sizeof(int64_t)];
+    int64_t monotonic = clockNs(CLOCK_MONOTONIC);
+    int64_t realtime = clockNs(CLOCK_REALTIME);
+    memcpy(clock, EL_MAGIC, sizeof(EL_MAGIC) - 1);
+    memcpy(clock + sizeof(EL_MAGIC) - 1, &realtime, sizeof(realtime));
+    size_t length = putRecord(buffer, sizeof(buffer), EL_CLOCK, monotonic, 0, 0, EL_NO_NAME, EL_NO_NAME,
+                              clock, sizeof(clock));
+    write(fd, buffer, length);
+
+    pthread_mutex_lock(&lock);
+    for (int index = 0; index < nameCount; index++) {
+        uint16_t id = (uint16_t) (index + 1);
+        length = putRecord(buffer, sizeof(buffer), (EventType) names[index].type, 0, 0, 0,
+                           names[index].type == EL_PROGRAM ? id : EL_NO_NAME,
+                           names[index].type == EL_NODE ? id : EL_NO_NAME,
+                           names[index].name, strlen(names[index].name));
+        write(fd, buffer, length);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+size_t el_event(char *buffer, size_t size, EventType type, time_t when, int pid, const char *program,
+                const char *node, unsigned int value) {
+    int64_t time = when == 0 ? clockNs(CLOCK_MONOTONIC) : monotonicAt(when);
+    size_t used = 0;
+    pthread_mutex_lock(&lock);
+    int programId = intern(EL_PROGRAM, program, buffer, size, &used);
+    int nodeId = intern(EL_NODE, node, buffer, size, &used);
+    pthread_mutex_unlock(&lock);
+
+    if (programId == -1 || nodeId == -1) {
+        // out of ids, the event goes in as its text instead
+        char text[EL_NAME_LENGTH * 2 + 128];
+        el_describe(type, pid, program, node, value, text, sizeof(text));
+        return used + el_message(buffer + used, size - used, el_typeName(type), text);
+    }
+    return used + putRecord(buffer + used, size - used, type, time, pid, value, (uint16_t) programId,
+                            (uint16_t) nodeId, NULL, 0);
+}
+
+char *el_messageText(char *buffer) {
+    return buffer + sizeof(EventRecord);
+}
+
+size_t el_finishMessage(char *buffer, size_t size, size_t length) {
+    return putRecord(buffer, size, EL_MESSAGE, clockNs(CLOCK_MONOTONIC), 0, 0, EL_NO_NAME, EL_NO_NAME,
+                     el_messageText(buffer), length);
+}
+
+size_t el_message(char *buffer, size_t size, const char *type, const char *msg) {
+    if (size < sizeof(EventRecord)) {
+        return 0;
+    }
+    // the text goes straight into place behind the record
+    size_t room = size - sizeof(EventRecord) < EL_MAX_TEXT ? size - sizeof(EventRecord) : EL_MAX_TEXT;
+    char *text = el_messageText(buffer);
+    size_t typeLength = strlen(type);
+    size_t msgLength = strlen(msg);
+    size_t length = 0;
+    if (typeLength + 2 <= room) {
+        memcpy(text, type, typeLength);
+        memcpy(text + typeLength, ": ", 2);
+        length = typeLength + 2;
+        if (msgLength > room - length) {
+            msgLength = room - length;
+        }
+        memcpy(text + length, msg, msgLength);
+        length += msgLength;
+    }
+    return el_finishMessage(buffer, size, length);
+}
+
+size_t el_line(char *buffer, size_t size, const char *line, size_t length) {
+    // most lines from clients are stamped with the current second, which the
+    // record's time can stand in for
+    time_t now = time(NULL);
+    char timestamp[LF_TIMESTAMP_LENGTH];
+    size_t timestampLength = lf_timestamp(now, timestamp);
+    if (length > timestampLength + 3 && line[0] == '[' && memcmp(line + 1, timestamp, timestampLength) == 0
+        && memcmp(line + 1 + timestampLength, "] ", 2) == 0 && line[length - 1] == '\n') {
+        return putRecord(buffer, size, EL_MESSAGE, monotonicAt(now), 0, 0, EL_NO_NAME, EL_NO_NAME,
+                         line + timestampLength + 3, length - timestampLength - 4);
+    }
+    return putRecord(buffer, size, EL_LINE, clockNs(CLOCK_MONOTONIC), 0, 0, EL_NO_NAME, EL_NO_NAME,
+                     line, length);
+}
+
+void el_readerInit(EventReader *reader) {
+    memset(reader, 0, sizeof(*reader));
+}
+
+void el_readerFree(EventReader *reader) {
+    for (int i = 0; i < EL_MAX_NAMES; i++) {
+        free(reader->names[i]);
+        reader->names[i] = NULL;
+    }
+}
+
+static const char *nameOf(EventReader *reader, uint16_t id) {
+    if (id == EL_NO_NAME) {
+        return "";
+    }
+    return id < EL_MAX_NAMES && reader->names[id] != NULL ? reader->names[id] : "?";
+}
+
+size_t el_render(EventReader *reader, const EventRecord *record, const char *text, char *out, size_t size) {
+    switch (record->type) {
+        case EL_CLOCK:
+            if (record->length >= sizeof(EL_MAGIC) - 1 + sizeof(int64_t)) {
+                // a new process or a new file, its names start over
+                el_readerFree(reader);
+                memcpy(&reader->clockRealtime, text + sizeof(EL_MAGIC) - 1, sizeof(int64_t));
+                reader->clockMonotonic = record->time;
+                reader->clocked = true;
+            }
+            return 0;
+        case EL_PROGRAM:
+        case EL_NODE: {
+            uint16_t id = record->type == EL_PROGRAM ? record->program : record->node;
+            if (id != EL_NO_NAME && id < EL_MAX_NAMES) {
+                free(reader->names[id]);
+                reader->names[id] = malloc((size_t) record->length + 1);
+                memcpy(reader->names[id], text, record->length);
+                reader->names[id][record->length] = '\0';
+            }
+            return 0;
+        }
+        case EL_LINE: {
+            size_t length = record->length < size ? record->length : size - 1;
+            memcpy(out, text, length);
+            out[length] = '\0';
+            return length;
+        }
+        case EL_MESSAGE:
+        case EL_MONITOR:
+        case EL_KILL:
+        case EL_NOT_FOUND:
+            break;
+        default:
+            return 0;
+    }
+
+    // "[time] " then the rest of the line
+    time_t when = 0;
+    if (reader->clocked) {
+        when = (time_t) ((reader->clockRealtime + (record->time - reader->clockMonotonic)) / 1000000000LL);
+    }
+    char timestamp[LF_TIMESTAMP_LENGTH];
+    lf_timestamp(when, timestamp);
+    int used = snprintf(out, size, "[%s] ", timestamp);
+    if (used < 0 || (size_t) used >= size) {
+        return 0;
+    }
+
+    size_t length;
+    if (record->type == EL_MESSAGE) {
+        length = record->length < size - used - 1 ? record->length : size - used - 2;
+        memcpy(out + used, text, length);
+    }
+    else {
+        int typed = snprintf(out + used, size - used, "%s: ", el_typeName((EventType) record->type));
+        if (typed < 0 || (size_t) typed >= size - used - 1) {
+            return 0;
+        }
+        length = typed + el_describe((EventType) record->type, record->pid, nameOf(reader, record->program),
+                                     nameOf(reader, record->node), record->value, out + used + typed,
+                                     size - used - typed - 1);
+    }
+    out[used + length] = '\n';
+    out[used + length + 1] = '\0';
+    length++;
+    return used + length;
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INTRUSIVE_LIST_H
+#define INTRUSIVE_LIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Lists threaded through a Link kept inside the items themselves. Nothing
+// is allocated or copied, an item with several Links can be on as many
+// lists at once, and moving it between lists is O(1). A list is a Link of
+// its own that is never an item, joining its tail back to its head.
+
+typedef struct _Link {
+    struct _Link *prev;
+    struct _Link *next;
+} Link;
+
+// the item holding link, given the item's type and the Link's field name
+#define IL_ENTRY(link, type, member) ((type *) ((char *) (link) - offsetof(type, member)))
+
+// link may be removed from list, or moved to another, inside the loop
+#define IL_FOR_EACH(list, link, following) \
+    for ((link) = (list)->next, (following) = (link)->next; (link) != (list); \
+         (link) = (following), (following) = (link)->next)
+
+// lists, and links that are on no list, must start out initialized
+void    il_init(Link *list);
+
+bool    il_isEmpty(Link *list);
+
+bool    il_isLinked(Link *link);
+
+void    il_pushFront(Link *list, Link *link);
+
+void    il_pushBack(Link *list, Link *link);
+
+// leaves link initialized, doing nothing if it is on no list
+void    il_remove(Link *link);
+
+// takes link off whatever list it is on first
+void    il_moveBack(Link *list, Link *link);
+
+// NULL when the list is empty
+Link*   il_popFront(Link *list);
+
+int     il_size(Link *list);
+
+#endif //INTRUSIVE_LIST_H
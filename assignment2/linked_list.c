@@ -14,35 +14,67 @@
  * limitations under the License.
  */
 
+
 #include <stdlib.h>
 #include <string.h>
 #include "linked_list.h"
 #include "memwatch.h"
 
+#define ITEM_ALIGNMENT sizeof(long long)
+
+static void addSlab(List *list) {
+    Slab *slab = malloc(sizeof(Slab) + list->nodeStride * (size_t) list->slabNodes);
+    slab->next = list->slabs;
+    list->slabs = slab;
+    // pushed in reverse so nodes are handed out in address order
+    for (int i = list->slabNodes - 1; i >= 0; i--) {
+        Node *node = (Node *) (slab->nodes + list->nodeStride * (size_t) i);
+        node->next = list->freeNodes;
+        list->freeNodes = node;
+    }
+    if (list->slabNodes < LL_SLAB_MAX_NODES) {
+        list->slabNodes *= 2;
+    }
+}
+
+static void releaseNode(List *list, Node *node) {
+    node->next = list->freeNodes;
+    list->freeNodes = node;
+    list->length--;
+}
+
 void ll_init(List *list, size_t nodeSize, Comparator comparator) {
     list->length = 0;
     list->head = NULL;
     list->tail = NULL;
     list->nodeSize = nodeSize;
+    list->nodeStride = (sizeof(Node) + nodeSize + ITEM_ALIGNMENT - 1) & ~(ITEM_ALIGNMENT - 1);
     list->comparator = comparator;
+    list->freeNodes = NULL;
+    list->slabs = NULL;
+    list->slabNodes = LL_SLAB_MIN_NODES;
 }
 
 void ll_free(List *list) {
-    Node *temp;
-    while(list->head != NULL) {
-        temp = list->head;
-        list->head = temp->next;
-        free(temp->data);
-        free(temp);
+    Slab *slab;
+    while(list->slabs != NULL) {
+        slab = list->slabs;
+        list->slabs = slab->next;
+        free(slab);
     }
+    list->head = list->tail = list->freeNodes = NULL;
+    list->length = 0;
+    list->slabNodes = LL_SLAB_MIN_NODES;
 }
 
-void ll_add(List *list, void *data) {
-    Node *node = malloc(sizeof(Node));
-    node->data = malloc(list->nodeSize);
+void* ll_emplace(List *list) {
+    if (list->freeNodes == NULL) {
+        addSlab(list);
+    }
+    Node *node = list->freeNodes;
+    list->freeNodes = node->next;
     node->next = NULL;
-
-    memcpy(node->data, data, list->nodeSize);
+    memset(node->data, 0, list->nodeSize);
 
     if(list->length == 0) {
         list->head = list->tail = node;
@@ -52,6 +84,11 @@ void ll_add(List *list, void *data) {
     }
 
     list->length++;
+    return node->data;
+}
+
+void ll_add(List *list, void *data) {
+    memcpy(ll_emplace(list), data, list->nodeSize);
 }
 
 void ll_add_unique(List *list, void *data)  {
@@ -87,33 +124,24 @@ void ll_removeIf(List *list, Predicate operation) {
         return;
     }
     Node* node = list->head;
-    Node* previousNode = list->head;
+    Node* previousNode = NULL;
     while(node != NULL) {
-        bool remove = operation(node->data);
-        if (remove) {
-            Node* temp = node;
-            if (node == list->head) {
-                list->head = node->next;
-                previousNode = list->head;
-                node = list->head;
+        Node* next = node->next;
+        if (operation(node->data)) {
+            if (previousNode == NULL) {
+                list->head = next;
+            } else {
+                previousNode->next = next;
             }
-            else if(node == list->tail) {
+            if (node == list->tail) {
                 list->tail = previousNode;
-                previousNode->next = NULL;
-                node = NULL;
             }
-            else {
-                previousNode->next = node->next;
-                node = previousNode->next;
-            }
-            list->length--;
-            free(temp->data);
-            free(temp);
+            releaseNode(list, node);
         }
         else {
             previousNode = node;
-            node = node->next;
         }
+        node = next;
     }
 }
 
@@ -122,33 +150,24 @@ void ll_remove(List *list, void *data) {
         return;
     }
     Node* node = list->head;
-    Node* previousNode = list->head;
+    Node* previousNode = NULL;
     while(node != NULL) {
-        bool remove = list->comparator(node->data, data);
-        if (remove) {
-            Node* temp = node;
-            if (node == list->head) {
-                list->head = node->next;
-                previousNode = list->head;
-                node = list->head;
+        Node* next = node->next;
+        if (list->comparator(node->data, data)) {
+            if (previousNode == NULL) {
+                list->head = next;
+            } else {
+                previousNode->next = next;
             }
-            else if(node == list->tail) {
+            if (node == list->tail) {
                 list->tail = previousNode;
-                previousNode->next = NULL;
-                node = NULL;
-            }
-            else {
-                previousNode->next = node->next;
-                node = previousNode->next;
             }
-            list->length--;
-            free(temp->data);
-            free(temp);
+            releaseNode(list, node);
         }
         else {
             previousNode = node;
-            node = node->next;
         }
+        node = next;
     }
 }
 
@@ -0,0 +1,43 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stddef.h>
+#include <time.h>
+
+// Every log line starts with "[<time>] <type>: ". The formatted time only
+// changes once a second, so it is kept per thread along with the prefixes
+// built from it, and a line then costs a couple of memcpys.
+
+#define LF_TIMESTAMP_LENGTH 40      // what callers' time buffers must hold
+#define LF_PREFIX_SLOTS 8           // distinct message types cached per thread
+
+// fills buffer with when in the log's "%a %b %d %H:%M:%S %Z %Y" format,
+// returns its length
+size_t  lf_timestamp(time_t when, char *buffer);
+
+// writes "[<now>] <type>: " to buffer, which holds at least size bytes,
+// returns its length
+size_t  lf_prefix(const char *type, char *buffer, size_t size);
+
+// writes a whole "[<now>] <type>: <msg>\n" line, cutting msg short if it does
+// not fit but always ending in a newline, returns its length
+size_t  lf_format(const char *type, const char *msg, char *buffer, size_t size);
+
+#endif //LOG_FORMAT_H
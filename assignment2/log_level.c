@@ -0,0 +1,103 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "log_level.h"
+#include "memwatch.h"
+
+#define FILTER_LENGTH 256
+
+unsigned char lv_levels[LM_COUNT] = {LV_DEFAULT_LEVEL, LV_DEFAULT_LEVEL, LV_DEFAULT_LEVEL, LV_DEFAULT_LEVEL,
+                                     LV_DEFAULT_LEVEL};
+
+static const char *levelNames[] = {"", "error", "warning", "action", "info", "debug"};
+static const char *typeNames[] = {"", "Error", "Warning", "Action", "Info", "Debug"};
+static const char *moduleNames[] = {"general", "config", "clients", "monitor", "stats"};
+
+static int levelNamed(const char *name) {
+    for (int level = LV_ERROR; level <= LV_DEBUG; level++) {
+        if (strcasecmp(name, levelNames[level]) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+static int moduleNamed(const char *name) {
+    for (int module = 0; module < LM_COUNT; module++) {
+        if (strcasecmp(name, moduleNames[module]) == 0) {
+            return module;
+        }
+    }
+    return -1;
+}
+
+const char *lv_typeName(LogLevel level) {
+    return level >= LV_ERROR && level <= LV_DEBUG ? typeNames[level] : "Info";
+}
+
+const char *lv_levelName(LogLevel level) {
+    return level >= LV_ERROR && level <= LV_DEBUG ? levelNames[level] : "info";
+}
+
+bool lv_configure(const char *filter) {
+    char copy[FILTER_LENGTH];
+    if (snprintf(copy, sizeof(copy), "%s", filter) >= (int) sizeof(copy)) {
+        return false;
+    }
+
+    unsigned char levels[LM_COUNT];
+    memcpy(levels, lv_levels, sizeof(levels));
+    char *saved;
+    for (char *part = strtok_r(copy, ", \t\n", &saved); part != NULL; part = strtok_r(NULL, ", \t\n", &saved)) {
+        char *equals = strchr(part, '=');
+        if (equals == NULL) {
+            int level = levelNamed(part);
+            if (level == -1) {
+                return false;
+            }
+            memset(levels, level, sizeof(levels));
+            continue;
+        }
+        *equals = '\0';
+        int module = moduleNamed(part);
+        int level = levelNamed(equals + 1);
+        if (module == -1 || level == -1) {
+            return false;
+        }
+        levels[module] = (unsigned char) level;
+    }
+    memcpy(lv_levels, levels, sizeof(levels));
+    return true;
+}
+
+void lv_describe(char *buffer, size_t size) {
+    size_t used = 0;
+    buffer[0] = '\0';
+    for (int module = 0; module < LM_COUNT && used < size; module++) {
+        int written = snprintf(buffer + used, size - used, "%s%s=%s", module == 0 ? "" : ",",
+                               moduleNames[module], levelNames[lv_levels[module]]);
+        if (written < 0) {
+            break;
+        }
+        used += (size_t) written;
+    }
+}
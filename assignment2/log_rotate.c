@@ -0,0 +1,287 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <limits.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "log_rotate.h"
+#include "memwatch.h"
+
+#define ROTATED_PATH_LENGTH (PATH_MAX + 64)
+
+extern char **environ;
+
+static char logPath[PATH_MAX];
+static LogRotateOptions options;
+static bool running = false;
+static pid_t owner = 0;
+static time_t nextRotation = 0;
+
+// rotated files the background thread has not compressed yet
+static char queue[LOG_ROTATE_QUEUE][ROTATED_PATH_LENGTH];
+static int queueHead = 0;
+static int queueCount = 0;
+static bool stopping = false;
+
+static pthread_t rotateThread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+
+static LogRotateStats stats;
+
+// only touched by the background thread
+static char rotatedNames[LOG_ROTATE_MAX_FILES][NAME_MAX + 1];
+
+static unsigned long long parseBytes(const char *text) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': return value << 10;
+        case 'm': case 'M': return value << 20;
+        case 'g': case 'G': return value << 30;
+        default: return value;
+    }
+}
+
+void lr_optionsFromEnvironment(LogRotateOptions *out) {
+    memset(out, 0, sizeof(*out));
+    out->keep = LOG_ROTATE_DEFAULT_KEEP;
+    out->compress = true;
+
+    char *value = getenv("PROCNANNYROTATEBYTES");
+    if (value != NULL) {
+        out->maxBytes = parseBytes(value);
+    }
+    value = getenv("PROCNANNYROTATESECONDS");
+    if (value != NULL) {
+        sscanf(value, "%u", &out->intervalSeconds);
+    }
+    value = getenv("PROCNANNYROTATEKEEP");
+    if (value != NULL) {
+        sscanf(value, "%u", &out->keep);
+    }
+    value = getenv("PROCNANNYROTATECOMPRESS");
+    if (value != NULL && strcmp(value, "0") == 0) {
+        out->compress = false;
+    }
+}
+
+static void scheduleNextRotation() {
+    if (options.intervalSeconds == 0) {
+        return;
+    }
+    // on interval boundaries, so hourly logs start on the hour
+    time_t now = time(NULL);
+    nextRotation = (now / options.intervalSeconds + 1) * options.intervalSeconds;
+}
+
+static bool compressFile(const char *path) {
+    char *argv[] = {"gzip", "-q", "-f", "--", (char *) path, NULL};
+    pid_t pid;
+    if (posix_spawnp(&pid, "gzip", NULL, NULL, argv, environ) != 0) {
+        return false;
+    }
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static int compareNames(const void *first, const void *second) {
+    return strcmp((const char *) first, (const char *) second);
+}
+
+// deletes the oldest rotated files beyond the number to keep
+static void pruneRotated() {
+    if (options.keep == 0) {
+        return;
+    }
+    char directory[PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s", logPath);
+    char *slash = strrchr(directory, '/');
+    const char *base = logPath;
+    if (slash != NULL) {
+        *slash = '\0';
+        base = logPath + (slash - directory) + 1;
+    }
+    else {
+        strcpy(directory, ".");
+    }
+
+    DIR *entries = opendir(directory);
+    if (entries == NULL) {
+        return;
+    }
+    // rotated names are the log's name, a dot and a timestamp, so they sort by age
+    size_t baseLength = strlen(base);
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(entries)) != NULL && count < LOG_ROTATE_MAX_FILES) {
+        if (strncmp(entry->d_name, base, baseLength) == 0 && entry->d_name[baseLength] == '.'
+            && strspn(entry->d_name + baseLength + 1, "0123456789") == 8
+            && entry->d_name[baseLength + 9] == '-') {
+            snprintf(rotatedNames[count++], NAME_MAX + 1, "%s", entry->d_name);
+        }
+    }
+    closedir(entries);
+    qsort(rotatedNames, (size_t) count, sizeof(rotatedNames[0]), &compareNames);
+
+    char path[PATH_MAX + NAME_MAX + 2];
+    for (int i = 0; i + (int) options.keep < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", directory, rotatedNames[i]);
+        if (unlink(path) == 0) {
+            __atomic_add_fetch(&stats.deleted, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void *rotateMain(void *unused) {
+    char path[ROTATED_PATH_LENGTH];
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (queueCount == 0 && stopping == false) {
+            pthread_cond_wait(&workReady, &lock);
+        }
+        if (queueCount == 0) {
+            break;
+        }
+        snprintf(path, sizeof(path), "%s", queue[queueHead]);
+        queueHead = (queueHead + 1) % LOG_ROTATE_QUEUE;
+        queueCount--;
+        pthread_mutex_unlock(&lock);
+
+        // the slow part, done without holding the lock. Pruning may already
+        // have removed the file if rotations outran compression.
+        if (options.compress && access(path, F_OK) == 0) {
+            if (compressFile(path)) {
+                __atomic_add_fetch(&stats.compressed, 1, __ATOMIC_RELAXED);
+            }
+            else {
+                __atomic_add_fetch(&stats.compressFailures, 1, __ATOMIC_RELAXED);
+            }
+        }
+        pruneRotated();
+
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return unused;
+}
+
+bool lr_start(const char *path, const LogRotateOptions *rotateOptions) {
+    if (running || (rotateOptions->maxBytes == 0 && rotateOptions->intervalSeconds == 0)) {
+        return false;
+    }
+    snprintf(logPath, sizeof(logPath), "%s", path);
+    options = *rotateOptions;
+    memset(&stats, 0, sizeof(stats));
+    queueHead = 0;
+    queueCount = 0;
+    stopping = false;
+    scheduleNextRotation();
+
+    if (pthread_create(&rotateThread, NULL, &rotateMain, NULL) != 0) {
+        return false;
+    }
+    owner = getpid();
+    running = true;
+    return true;
+}
+
+void lr_stop() {
+    // a forked child has the flag but not the thread
+    if (running == false || getpid() != owner) {
+        return;
+    }
+    running = false;
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&workReady);
+    pthread_mutex_unlock(&lock);
+    pthread_join(rotateThread, NULL);
+}
+
+bool lr_due(unsigned long long size) {
+    // forked children keep appending but leave rotation to the process that
+    // owns the background thread
+    if (running == false || size == 0 || getpid() != owner) {
+        return false;
+    }
+    return (options.maxBytes != 0 && size >= options.maxBytes)
+           || (options.intervalSeconds != 0 && time(NULL) >= nextRotation);
+}
+
+bool lr_rotate() {
+    if (running == false) {
+        return false;
+    }
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm timeInfo;
+    localtime_r(&now, &timeInfo);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &timeInfo);
+
+    // a counter for several rotations in one second, always present so the
+    // names still sort by age once compressed
+    char rotated[ROTATED_PATH_LENGTH];
+    char compressed[ROTATED_PATH_LENGTH + 4];
+    struct stat existing;
+    int sequence = 0;
+    do {
+        snprintf(rotated, sizeof(rotated), "%s.%s-%03d", logPath, stamp, sequence);
+        snprintf(compressed, sizeof(compressed), "%s.gz", rotated);
+        sequence++;
+    } while (sequence < 1000 && (stat(rotated, &existing) == 0 || stat(compressed, &existing) == 0));
+    scheduleNextRotation();
+    if (rename(logPath, rotated) == -1) {
+        return false;
+    }
+    __atomic_add_fetch(&stats.rotations, 1, __ATOMIC_RELAXED);
+
+    // a full queue leaves the file as it is rather than making the writer wait
+    pthread_mutex_lock(&lock);
+    if (queueCount < LOG_ROTATE_QUEUE) {
+        snprintf(queue[(queueHead + queueCount) % LOG_ROTATE_QUEUE], ROTATED_PATH_LENGTH, "%s", rotated);
+        queueCount++;
+        pthread_cond_signal(&workReady);
+    }
+    pthread_mutex_unlock(&lock);
+    return true;
+}
+
+void lr_getStats(LogRotateStats *out) {
+    out->rotations = __atomic_load_n(&stats.rotations, __ATOMIC_RELAXED);
+    out->compressed = __atomic_load_n(&stats.compressed, __ATOMIC_RELAXED);
+    out->compressFailures = __atomic_load_n(&stats.compressFailures, __ATOMIC_RELAXED);
+    out->deleted = __atomic_load_n(&stats.deleted, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&lock);
+    out->pending = (size_t) queueCount;
+    pthread_mutex_unlock(&lock);
+}
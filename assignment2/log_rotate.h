@@ -0,0 +1,67 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_ROTATE_H
+#define LOG_ROTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Rolls a log file over by size or age. The writer renames the live file
+// aside and reopens its path, which only takes a rename. Compressing the
+// rotated file with gzip and deleting old ones happen on a background
+// thread, so whoever is writing the log never waits for them.
+
+#define LOG_ROTATE_QUEUE 16         // rotated files waiting for the background thread
+#define LOG_ROTATE_MAX_FILES 256    // rotated files looked at when pruning
+#define LOG_ROTATE_DEFAULT_KEEP 10
+
+typedef struct _LogRotateOptions {
+    unsigned long long maxBytes;    // 0 never rotates by size
+    unsigned int intervalSeconds;   // 0 never rotates by age
+    unsigned int keep;              // rotated files kept, 0 keeps them all
+    bool compress;
+} LogRotateOptions;
+
+typedef struct _LogRotateStats {
+    unsigned long long rotations;
+    unsigned long long compressed;
+    unsigned long long compressFailures;   // left uncompressed
+    unsigned long long deleted;
+    size_t pending;                        // waiting for the background thread
+} LogRotateStats;
+
+// PROCNANNYROTATEBYTES (K, M and G suffixes allowed), PROCNANNYROTATESECONDS,
+// PROCNANNYROTATEKEEP and PROCNANNYROTATECOMPRESS=0 to keep rotated files as text
+void    lr_optionsFromEnvironment(LogRotateOptions *options);
+
+// starts the background thread for the log at path, false when the options
+// never rotate or the thread could not be started
+bool    lr_start(const char *path, const LogRotateOptions *options);
+
+// finishes the queued compression and pruning, then stops the thread
+void    lr_stop();
+
+// whether a log that has grown to size bytes should be rotated now
+bool    lr_due(unsigned long long size);
+
+// renames the log aside and queues it for the background thread, the caller
+// closes its descriptor first and opens the path again afterwards
+bool    lr_rotate();
+
+void    lr_getStats(LogRotateStats *stats);
+
+#endif //LOG_ROTATE_H
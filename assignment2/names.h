@@ -0,0 +1,53 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <stdbool.h>
+
+// One table of program names for the whole program. Each name is stored
+// once, when a configuration is loaded, and records carry its small id
+// instead of a copy, so two names are compared by comparing ids. Names are
+// never dropped, a run only ever sees a few hundred programs.
+//
+// Interning is for one thread at a time. nm_name is safe from any thread
+// while nothing is being interned.
+
+#define NM_INITIAL_CAPACITY 64
+// no name, which is what a zeroed record holds
+#define NM_NONE 0
+
+typedef unsigned int NameId;
+
+// the id of name, adding it if it is new. NM_NONE for an empty name or if
+// the name could not be stored.
+NameId  nm_intern(const char *name);
+
+// NM_NONE if name was never interned
+NameId  nm_find(const char *name);
+
+// "" for NM_NONE
+const char* nm_name(NameId id);
+
+// names interned so far
+int     nm_count();
+
+// forgets every name, ids handed out before are no longer valid
+void    nm_free();
+
+#endif //NAMES_H
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PID_MAP_H
+#define PID_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "linked_list.h"
+
+// Items keyed by pid in one open addressed table, probed linearly. Keys sit
+// apart from the items so a probe only reads pids, and removal shifts the
+// rest of a run back instead of leaving tombstones, so lookups never slow
+// down as processes come and go.
+
+#define PM_INITIAL_CAPACITY 16
+
+typedef struct _PidMap {
+    int length;
+    int capacity;           // a power of two, grown past 3/4 full
+    unsigned int shift;     // turns a 32 bit hash into a slot
+    size_t itemSize;
+    pid_t *keys;            // 0 marks an empty slot
+    char *items;
+} PidMap;
+
+void    pm_init(PidMap *map, size_t itemSize);
+
+void    pm_free(PidMap *map);
+
+// copies the item in unless the pid is already there, returns true if it was
+// added. A pid that is not greater than 0 is never added.
+bool    pm_add(PidMap *map, pid_t pid, void *item);
+
+// NULL if absent or not greater than 0. Pointers stay valid until the next
+// pm_add or pm_remove.
+void*   pm_get(PidMap *map, pid_t pid);
+
+// returns false if the pid was not there or is not greater than 0
+bool    pm_remove(PidMap *map, pid_t pid);
+
+// the operation must not add or remove items
+void    pm_forEach(PidMap *map, NodeOperation operation);
+
+int     pm_size(PidMap *map);
+
+#endif //PID_MAP_H
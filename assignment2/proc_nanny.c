@@ -25,8 +25,19 @@
 #include <ctype.h>
 #include <time.h>
 #include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include "proc_nanny.h"
 #include "linked_list.h"
+#include "pid_map.h"
+#include "vector.h"
+#include "intrusive_list.h"
+#include "thread_pool.h"
+#include "log_rotate.h"
+#include "log_format.h"
+#include "ring_log.h"
+#include "event_log.h"
+#include "log_level.h"
 #include "memwatch.h"
 
 bool receivedSIGHUP = false;
@@ -39,8 +50,9 @@ char logLocation[512];
 char configFileLocation[512];
 
 ProgramConfig configLines[CONFIG_FILE_LINES];
-List monitoredProcesses;
-List childProcesses;
+Vector monitoredProcesses;
+PidMap monitoredPids;       // the VectorHandle of each pid's entry
+WorkerPool workers;
 
 int pnMain(int args, char* argv[]) {
 
@@ -54,6 +66,39 @@ int pnMain(int args, char* argv[]) {
         printf("error with setting Alarm\n");
 
     checkInputs(args, argv);
+
+    LogRotateOptions rotation;
+    lr_optionsFromEnvironment(&rotation);
+    if (lr_start(logLocation, &rotation)) {
+        atexit(&lr_stop);
+    }
+    // registered last so it runs first, before rotation stops. The binary
+    // format needs the flusher to start each file with its preamble.
+    bool binary = el_requested();
+    if (binary) {
+        rl_setPreamble(&el_writePreamble);
+    }
+    if (rl_start(logLocation)) {
+        atexit(&stopLogging);
+        if (binary) {
+            el_enable();
+        }
+    }
+
+    char *procnannyLogLevel = getenv("PROCNANNYLOGLEVEL");
+    if (procnannyLogLevel != NULL && lv_configure(procnannyLogLevel) == false) {
+        LOG_WARNING(LM_CONFIG, true, "Could not read PROCNANNYLOGLEVEL '%s', using the defaults.", procnannyLogLevel);
+    }
+    int threads = 0;
+    char *procnannyThreads = getenv("PROCNANNYTHREADS");
+    if (procnannyThreads != NULL && sscanf(procnannyThreads, "%d", &threads) != 1) {
+        LOG_WARNING(LM_CONFIG, true, "Could not read PROCNANNYTHREADS '%s', using one per CPU.", procnannyThreads);
+        threads = 0;
+    }
+    if (tp_start(threads)) {
+        atexit(&tp_stop);
+    }
+
     killAllProcNannys();
     readConfigurationFile();
     beginProcNanny();
@@ -99,7 +144,7 @@ void readConfigurationFile() {
 
     fp = fopen(configFileLocation, "r");
     if (fp == NULL) {
-        logToFile("Error", "Could not read configuration file.", true);
+        LOG_ERROR(LM_CONFIG, true, "Could not read configuration file.");
         exit(EXIT_FAILURE);
     }
 
@@ -108,50 +153,45 @@ void readConfigurationFile() {
     while ((charsRead = getline(&line, &len, fp)) != -1) {
         char tempBuff[512];
         strncpy(tempBuff, line, (size_t) charsRead);
-        int numMatched = sscanf(tempBuff, "%s %d", configLines[index].programName, &configLines[index].runtime);
+        char program[PROGRAM_NAME_LENGTH];
+        int numMatched = sscanf(tempBuff, "%127s %d", program, &configLines[index].runtime);
         if (numMatched != 2) {
-            LogMessage msg;
-            snprintf(msg.message, LOG_MESSAGE_LENGTH,
-                     "Expected two configuration arguments at line %d of %s.",
-                     index, configFileLocation);
-            logToFile("Error", msg.message, false);
+            LOG_ERROR(LM_CONFIG, false, "Expected two configuration arguments at line %d of %s.",
+                      index, configFileLocation);
             cleanUp();
             exit(EXIT_FAILURE);
         }
-        trimWhitespace(configLines[index].programName);
+        trimWhitespace(program);
+        configLines[index].program = nm_intern(program);
         index++;
     }
     fclose(fp);
 }
 
 void beginProcNanny() {
-    LogMessage parentMsg;
-    snprintf(parentMsg.message, LOG_MESSAGE_LENGTH, "Parent process is PID %d.", getpid());
-    logToFile("Info", parentMsg.message, false);
+    LOG_INFO(LM_GENERAL, false, "Parent process is PID %d.", getpid());
 
-    ll_init(&monitoredProcesses, sizeof(MonitoredProcess), &monitoredProcessComparator);
-    ll_init(&childProcesses, sizeof(ChildProcess), NULL);
+    vc_init(&monitoredProcesses, sizeof(MonitoredProcess));
+    pm_init(&monitoredPids, sizeof(VectorHandle));
+    ll_init(&workers.children, sizeof(ChildProcess), NULL);
+    il_init(&workers.idle);
+    hp_init(&workers.busy, WORKER_HEAP_ARITY, offsetof(ChildProcess, busyIndex));
     firstConfigurationReRead = true;
     checkForNewMonitoredProcesses(firstConfigurationReRead);
     alarm(REFRESH_RATE);
 
     while(true) {
-        ll_forEach(&monitoredProcesses, &monitorNewProcesses);
-        ll_forEach(&childProcesses, &checkChild);
+        vc_forEachWith(&monitoredProcesses, &monitorNewProcesses, &workers);
+        checkBusyWorkers(&workers);
 
         if (receivedSIGHUP) {
             receivedSIGHUP = false;
             for (int i = 0; i < CONFIG_FILE_LINES; i++) {
                 configLines[i].runtime = 0;
-                strcpy(configLines[i].programName, "");
+                configLines[i].program = NM_NONE;
             }
             readConfigurationFile();
-            LogMessage msg;
-            snprintf(msg.message, LOG_MESSAGE_LENGTH,
-                     "Caught SIGHUP. Configuration file '%s' re-read.",
-                     configFileLocation);
-            char type[] = "Info";
-            logToFile(type, msg.message, true);
+            LOG_INFO(LM_CONFIG, true, "Caught SIGHUP. Configuration file '%s' re-read.", configFileLocation);
 
             firstConfigurationReRead = true;
         }
@@ -159,11 +199,7 @@ void beginProcNanny() {
         if (receivedSIGINT) {
             receivedSIGINT = false;
             cleanUp();
-            LogMessage msg;
-            snprintf(msg.message, LOG_MESSAGE_LENGTH,
-                     "Caught SIGINT. Exiting cleanly. %d process(es) killed.",
-                     numProcessesKilled);
-            logToFile("Info", msg.message, true);
+            LOG_INFO(LM_GENERAL, true, "Caught SIGINT. Exiting cleanly. %d process(es) killed.", numProcessesKilled);
             exit(EXIT_SUCCESS);
         }
 
@@ -176,9 +212,13 @@ void beginProcNanny() {
 }
 
 void cleanUp() {
-    ll_forEach(&childProcesses, &killChild);
-    ll_free(&monitoredProcesses);
-    ll_free(&childProcesses);
+    ll_forEach(&workers.children, &killChild);
+    vc_free(&monitoredProcesses);
+    pm_free(&monitoredPids);
+    hp_free(&workers.busy);
+    ll_free(&workers.children);
+    il_init(&workers.idle);
+    nm_free();
 }
 
 void exitError(const char *errorMessage) {
@@ -214,7 +254,7 @@ void getPids(const char *processName, pid_t pids[MAX_PROCESSES]) {
 
     int index = 0;
 
-    while (getline(&line, &len, pgrepOutput) != -1) {
+    while (index < MAX_PROCESSES && getline(&line, &len, pgrepOutput) != -1) {
         pids[index] = (pid_t) atoi(line);
         index++;
     }
@@ -223,12 +263,13 @@ void getPids(const char *processName, pid_t pids[MAX_PROCESSES]) {
 }
 
 void getCurrentTime(char *buffer) {
-    time_t rawTime;
-    struct tm *timeInfo;
-    time (&rawTime);
-    timeInfo = localtime (&rawTime);
-    strftime(buffer,TIME_BUFFER_SIZE,"%a %b %d %H:%M:%S %Z %Y", timeInfo);
-    trimWhitespace(buffer);
+    lf_timestamp(time(NULL), buffer);
+}
+
+long long getMonotonicMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
 }
 
 void checkInputs(int args, char* argv[]) {
@@ -286,70 +327,72 @@ void killPid(pid_t pid) {
     system(buff);
 }
 
-bool monitoredProcessComparator(void *mp1, void *mp2) {
-    MonitoredProcess* first = (MonitoredProcess*) mp1;
-    MonitoredProcess* second = (MonitoredProcess*) mp2;
-
-    if (first->processPid == second->processPid) {
-        return true;
-    }
-
-    return false;
+void lookUpPids(int chunk, void *argument) {
+    PidLookup *lookup = argument;
+    getPids(nm_name(configLines[lookup->lines[chunk]].program), lookup->pids[chunk]);
 }
 
 void checkForNewMonitoredProcesses(bool logNoProcessesFound) {
+    // every pgrep runs at once across the thread pool, the results are then
+    // added here one program at a time
+    // a megabyte of rows, kept between passes rather than allocated each time
+    static PidLookup lookup;
+    lookup.count = 0;
     for (int i = 0; i < CONFIG_FILE_LINES; i++) {
-        if (strlen(configLines[i].programName) != 0) {
-            pid_t pids[MAX_PROCESSES] = {-1};
-            getPids(configLines[i].programName, pids);
-            int numberFound = 0;
-            for (int j = 0; j < MAX_PROCESSES; j++) {
-                if (pids[j] > 0) {
-                    MonitoredProcess temp;
-                    strncpy(temp.processName, configLines[i].programName, PROGRAM_NAME_LENGTH);
-                    temp.processPid = pids[j];
-                    temp.runtime = configLines[i].runtime;
-                    temp.beingMonitored = false;
-                    ll_add_unique(&monitoredProcesses, &temp);
-                    numberFound++;
+        if (configLines[i].program != NM_NONE) {
+            lookup.lines[lookup.count++] = i;
+        }
+    }
+    if (lookup.count == 0) {
+        firstConfigurationReRead = false;
+        return;
+    }
+    memset(lookup.pids, 0, sizeof(lookup.pids[0]) * (size_t) lookup.count);
+    tp_run(&lookUpPids, lookup.count, &lookup);
+
+    for (int k = 0; k < lookup.count; k++) {
+        int i = lookup.lines[k];
+        pid_t *pids = lookup.pids[k];
+        int numberFound = 0;
+        for (int j = 0; j < MAX_PROCESSES; j++) {
+            if (pids[j] > 0) {
+                if (pm_get(&monitoredPids, pids[j]) == NULL) {
+                    VectorHandle handle;
+                    MonitoredProcess* process = vc_emplace(&monitoredProcesses, &handle);
+                    // with no room left the pid is picked up again on a later pass
+                    if (process != NULL) {
+                        process->program = configLines[i].program;
+                        process->processPid = pids[j];
+                        process->runtime = configLines[i].runtime;
+                        pm_add(&monitoredPids, pids[j], &handle);
+                    }
                 }
+                numberFound++;
             }
-            if (logNoProcessesFound && numberFound == 0) {
-                LogMessage msg;
-                snprintf(msg.message, LOG_MESSAGE_LENGTH, "No '%s' processes found."
-                        , configLines[i].programName);
-                logToFile("Info", msg.message, false);
-            }
+        }
+        if (logNoProcessesFound && numberFound == 0) {
+            logEvent(EL_NOT_FOUND, 0, nm_name(configLines[i].program), 0);
         }
     }
-
     firstConfigurationReRead = false;
 }
 
-void monitorNewProcesses(void *monitoredProcess) {
+void monitorNewProcesses(void *monitoredProcess, void *workerPool) {
     MonitoredProcess* process = (MonitoredProcess*) monitoredProcess;
+    WorkerPool* pool = (WorkerPool*) workerPool;
     if (process->beingMonitored == false) {
-        ChildProcess* worker = ll_getIf(&childProcesses, &getChildPredicate);
-        if (worker == NULL) {
-            worker = spawnNewChildWorker();
-        }
-        initializeChild(worker, process);
-        LogMessage msg;
-        snprintf(msg.message, LOG_MESSAGE_LENGTH, "Initializing monitoring of process '%s' (PID %d).",
-                 process->processName, process->processPid);
-        logToFile("Info", msg.message, false);
+        Link* idle = il_popFront(&pool->idle);
+        ChildProcess* worker = idle != NULL ? IL_ENTRY(idle, ChildProcess, state) : spawnNewChildWorker(pool);
+        initializeChild(pool, worker, process);
+        logEvent(EL_MONITOR, process->processPid, nm_name(process->program), 0);
     }
 }
 
-bool getChildPredicate(void *childProcess) {
-    ChildProcess* temp = (ChildProcess*) childProcess;
-    return temp->isAvailable;
-}
-
-void initializeChild(ChildProcess *childWorker, MonitoredProcess *processToBeMonitored) {
-    childWorker->isAvailable = false;
+void initializeChild(WorkerPool *pool, ChildProcess *childWorker, MonitoredProcess *processToBeMonitored) {
+    il_remove(&childWorker->state);
+    hp_push(&pool->busy, childWorker, getMonotonicMs() + processToBeMonitored->runtime * 1000LL);
     processToBeMonitored->beingMonitored = true;
-    strncpy(childWorker->processName, processToBeMonitored->processName, PROGRAM_NAME_LENGTH);
+    childWorker->program = processToBeMonitored->program;
     childWorker->processPid = processToBeMonitored->processPid;
     childWorker->runtime = processToBeMonitored->runtime;
 
@@ -359,11 +402,12 @@ void initializeChild(ChildProcess *childWorker, MonitoredProcess *processToBeMon
     write(childWorker->toChild.readWrite[WRITE_PIPE], buff, strlen(buff));
 }
 
-ChildProcess *spawnNewChildWorker() {
-    ChildProcess worker;
-    worker.isAvailable = true;
-    pipe(worker.toChild.readWrite);
-    pipe(worker.toParent.readWrite);
+ChildProcess *spawnNewChildWorker(WorkerPool *pool) {
+    ChildProcess* worker = ll_emplace(&pool->children);
+    il_init(&worker->state);
+    worker->busyIndex = HP_NOT_QUEUED;
+    pipe(worker->toChild.readWrite);
+    pipe(worker->toParent.readWrite);
     __pid_t forkResult = fork();
 
     switch(forkResult) {
@@ -371,12 +415,17 @@ ChildProcess *spawnNewChildWorker() {
             exitError("ERROR: error in monitoring process");
             break;
         case 0:     //Child
-            close(worker.toChild.readWrite[WRITE_PIPE]);
-            close(worker.toParent.readWrite[READ_PIPE]);
-            ll_free(&monitoredProcesses);
-            ll_free(&childProcesses);
+            close(worker->toChild.readWrite[WRITE_PIPE]);
+            close(worker->toParent.readWrite[READ_PIPE]);
+            vc_free(&monitoredProcesses);
+            pm_free(&monitoredPids);
+            hp_free(&pool->busy);
+            // the worker's node goes with the list
+            ChildProcess self = *worker;
+            ll_free(&pool->children);
+            nm_free();
             while(true) {
-                FILE* fromParent = fdopen(worker.toChild.readWrite[READ_PIPE], "r");
+                FILE* fromParent = fdopen(self.toChild.readWrite[READ_PIPE], "r");
                 char command[255];
                 while(fgets(command, 255, fromParent) != NULL) {
                     // get parameters from parent's command
@@ -395,7 +444,7 @@ ChildProcess *spawnNewChildWorker() {
                     }
                     char buff[5];
                     snprintf(buff, 5, "%d", numKilled);
-                    write(worker.toParent.readWrite[WRITE_PIPE], buff, strlen(buff));
+                    write(self.toParent.readWrite[WRITE_PIPE], buff, strlen(buff));
                 }
                 fclose(fromParent);
                 exit(EXIT_SUCCESS);
@@ -405,61 +454,191 @@ ChildProcess *spawnNewChildWorker() {
             break;
     }
 
-    close(worker.toChild.readWrite[READ_PIPE]);
-    close(worker.toParent.readWrite[WRITE_PIPE]);
+    close(worker->toChild.readWrite[READ_PIPE]);
+    close(worker->toParent.readWrite[WRITE_PIPE]);
 
     // set to non blocking read of writes from child
-    int flags = fcntl(worker.toParent.readWrite[READ_PIPE], F_GETFL, 0);
+    int flags = fcntl(worker->toParent.readWrite[READ_PIPE], F_GETFL, 0);
     flags |= O_NONBLOCK;
-    fcntl(worker.toParent.readWrite[READ_PIPE], F_SETFL, flags);
-
-    worker.childPid = forkResult;
-    ll_add(&childProcesses, &worker);
+    fcntl(worker->toParent.readWrite[READ_PIPE], F_SETFL, flags);
 
-    return (ChildProcess*) ll_getIf(&childProcesses, &getChildPredicate);
+    worker->childPid = forkResult;
+    return worker;
 }
 
-void checkChild(void *childProcess) {
-    ChildProcess* child = (ChildProcess*) childProcess;
-    if (child->isAvailable == false) {
-        char command[255];
-        if (read(child->toParent.readWrite[READ_PIPE], command, 255) == -1) {
-            return;
-        }
-        int numKilled = 0;
-        sscanf(command, "%d\n", &numKilled);
-        if (numKilled != 0) {
-            numProcessesKilled+=numKilled;
-            LogMessage msg;
-            snprintf(msg.message, LOG_MESSAGE_LENGTH, "PID %d (%s) killed after exceeding %d seconds.",
-                     child->processPid, child->processName, child->runtime);
-            logToFile("Action", msg.message, false);
+void checkBusyWorkers(WorkerPool* pool) {
+    // a worker sleeps through the whole runtime before it reports, so only
+    // the ones past that can have anything to read
+    long long now = getMonotonicMs();
+    while (hp_size(&pool->busy) > 0 && hp_topKey(&pool->busy) <= now) {
+        ChildProcess* child = hp_top(&pool->busy);
+        if (checkChild(pool, child) == false) {
+            hp_update(&pool->busy, child, now + WORKER_RETRY_MS);
         }
-        child->isAvailable = true;
-        MonitoredProcess temp;
-        temp.processPid = child->processPid;
-        ll_remove(&monitoredProcesses, &temp);
     }
 }
 
+// returns false if the worker has not reported yet
+bool checkChild(WorkerPool* pool, ChildProcess* child) {
+    char command[255];
+    if (read(child->toParent.readWrite[READ_PIPE], command, 255) == -1) {
+        return false;
+    }
+    int numKilled = 0;
+    sscanf(command, "%d\n", &numKilled);
+    if (numKilled != 0) {
+        numProcessesKilled+=numKilled;
+        logEvent(EL_KILL, child->processPid, nm_name(child->program), child->runtime);
+    }
+    hp_remove(&pool->busy, child);
+    il_pushBack(&pool->idle, &child->state);
+    VectorHandle* handle = pm_get(&monitoredPids, child->processPid);
+    if (handle != NULL) {
+        vc_remove(&monitoredProcesses, *handle);
+        pm_remove(&monitoredPids, child->processPid);
+    }
+    return true;
+}
+
 void killChild(void *childProcess) {
     ChildProcess* child = (ChildProcess*) childProcess;
     killPid(child->childPid);
 }
 
+void logEvent(EventType type, pid_t pid, const char* program, unsigned int runtime) {
+    if (LOG_ENABLED(type == EL_KILL ? LV_ACTION : LV_INFO, LM_MONITOR) == false) {
+        return;
+    }
+    if (el_enabled() && rl_isRunning()) {
+        // room for the event, its program's name and the text it falls back to
+        size_t length = sizeof(EventRecord) * 2 + PROGRAM_NAME_LENGTH + 128;
+        char* record = rl_reserve(length);
+        if (record != NULL) {
+            rl_commit(record, el_event(record, length, type, 0, pid, program, "", runtime));
+        }
+        return;
+    }
+    RingLine line;
+    if (beginRingLine(&line, el_typeName(type))) {
+        endRingLine(&line, el_describe(type, pid, program, "", runtime, line.text + line.length,
+                                       line.room - line.length), false);
+        return;
+    }
+    LogMessage msg;
+    el_describe(type, pid, program, "", runtime, msg.message, LOG_MESSAGE_LENGTH);
+    logWithoutRing(el_typeName(type), msg.message, false);
+}
+
+void logFormatted(LogLevel level, bool echo, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    RingLine line;
+    if (beginRingLine(&line, lv_typeName(level))) {
+        int length = vsnprintf(line.text + line.length, line.room - line.length, format, args);
+        endRingLine(&line, length > 0 ? (size_t) length : 0, echo);
+    }
+    else {
+        LogMessage msg;
+        vsnprintf(msg.message, LOG_MESSAGE_LENGTH, format, args);
+        logWithoutRing(lv_typeName(level), msg.message, echo);
+    }
+    va_end(args);
+}
+
 void logToFile(const char* type, const char* msg, bool logToSTDOUT) {
-    char timebuffer[TIME_BUFFER_SIZE];
-    getCurrentTime(timebuffer);
+    RingLine line;
+    if (beginRingLine(&line, type)) {
+        size_t length = strlen(msg);
+        if (length > line.room - line.length) {
+            length = line.room - line.length;
+        }
+        memcpy(line.text + line.length, msg, length);
+        endRingLine(&line, length, logToSTDOUT);
+        return;
+    }
+    logWithoutRing(type, msg, logToSTDOUT);
+}
+
+bool beginRingLine(RingLine* line, const char* type) {
+    if (rl_isRunning() == false) {
+        return false;
+    }
+    // the whole of the longest line is reserved, as the body's length is not
+    // known until it has been formatted in place
+    bool binary = el_enabled();
+    line->record = rl_reserve((binary ? sizeof(EventRecord) : 0) + LOG_MESSAGE_LENGTH);
+    if (line->record == NULL) {
+        return false;
+    }
+    if (binary) {
+        // "<type>: <message>" behind the record, the time is the record's
+        line->text = el_messageText(line->record);
+        line->room = LOG_MESSAGE_LENGTH;
+        int length = snprintf(line->text, line->room, "%s: ", type);
+        line->length = length > 0 && (size_t) length < line->room ? (size_t) length : 0;
+    }
+    else {
+        // leaves a byte for the newline
+        line->text = line->record;
+        line->room = LOG_MESSAGE_LENGTH - 1;
+        line->length = lf_prefix(type, line->text, line->room);
+    }
+    return true;
+}
+
+void endRingLine(RingLine* line, size_t bodyLength, bool logToSTDOUT) {
+    // formatting stops short of the room, like vsnprintf and its terminator
+    if (bodyLength > line->room - line->length - 1) {
+        bodyLength = line->room - line->length - 1;
+    }
+    line->length += bodyLength;
+
+    if (el_enabled()) {
+        if (logToSTDOUT == true) {
+            char timestamp[LF_TIMESTAMP_LENGTH];
+            lf_timestamp(time(NULL), timestamp);
+            printf("[%s] %.*s\n", timestamp, (int) line->length, line->text);
+        }
+        rl_commit(line->record, el_finishMessage(line->record, sizeof(EventRecord) + LOG_MESSAGE_LENGTH,
+                                                 line->length));
+        return;
+    }
+    line->text[line->length++] = '\n';
+    if (logToSTDOUT == true) {
+        fwrite(line->text, 1, line->length, stdout);
+    }
+    rl_commit(line->record, line->length);
+}
+
+void logWithoutRing(const char* type, const char* msg, bool logToSTDOUT) {
     LogMessage logMsg;
-    snprintf(logMsg.message, LOG_MESSAGE_LENGTH,
-             "[%s] %s: %s\n",
-             timebuffer, type, msg);
+    size_t length = lf_format(type, msg, logMsg.message, LOG_MESSAGE_LENGTH);
 
-    FILE* log = fopen(logLocation, "a");
-    fprintf(log, "%s", logMsg.message);
-    fclose(log);
+    // with the logger running the ring was full, and the line is dropped
+    if (rl_isRunning() == false) {
+        FILE* log = fopen(logLocation, "a");
+        fwrite(logMsg.message, 1, length, log);
+        bool rotate = lr_due((unsigned long long) ftell(log));
+        fclose(log);
+        if (rotate) {
+            lr_rotate();
+        }
+    }
 
     if (logToSTDOUT == true) {
         printf("%s", logMsg.message);
     }
 }
+
+void stopLogging() {
+    // forked workers inherit the handler but never logged through the ring
+    if (rl_isRunning() == false) {
+        return;
+    }
+    rl_stop();
+    RingLogStats stats;
+    rl_getStats(&stats);
+    if (stats.dropped > 0) {
+        LOG_WARNING(LM_STATS, false, "%llu log message(s) dropped while the log ring was full.", stats.dropped);
+    }
+}
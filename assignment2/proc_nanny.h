@@ -22,6 +22,11 @@
 #include <time.h>
 #include <sys/types.h>
 #include <stdbool.h>
+#include "intrusive_list.h"
+#include "heap.h"
+#include "linked_list.h"
+#include "names.h"
+#include "event_log.h"
 
 #define REFRESH_RATE 5
 #define MAX_PROCESSES 1024
@@ -33,6 +38,11 @@
 #define READ_PIPE 0
 #define WRITE_PIPE 1
 
+// busy workers are kept in a 4-ary heap by when they will report back, and a
+// worker found still busy past that is looked at again this much later
+#define WORKER_HEAP_ARITY 4
+#define WORKER_RETRY_MS 5
+
 typedef struct _Pipe {
     int readWrite[2]; // read READ_PIPE, write WRITE_PIPE
 } Pipe;
@@ -41,8 +51,17 @@ typedef struct _LogMessage {
     char message[LOG_MESSAGE_LENGTH];
 } LogMessage;
 
+// a line being written straight into its reserved space in the log ring
+typedef struct _RingLine {
+    char* record;       // the reserved space
+    char* text;         // where the line's text starts in it
+    size_t length;      // of the text written so far
+    size_t room;        // the text may not grow past this
+} RingLine;
+
+// programs are interned names, see names.h
 typedef struct _ProgramConfig {
-    char programName[PROGRAM_NAME_LENGTH];
+    NameId program;     // NM_NONE for an unused line
     unsigned int runtime;
 } ProgramConfig;
 
@@ -50,19 +69,34 @@ typedef struct _ChildProcess {
     pid_t childPid; // may or may not be required... not sure yet
     Pipe toParent;
     Pipe toChild;
-    bool isAvailable;
+    Link state;     // on its pool's idle list while idle
+    int busyIndex;  // position in its pool's busy heap, HP_NOT_QUEUED while idle
     pid_t processPid;
-    char processName[PROGRAM_NAME_LENGTH];
+    NameId program;
     unsigned int runtime;
 } ChildProcess;
 
+// every worker is in children, and on idle or in busy
+typedef struct _WorkerPool {
+    List children;
+    Link idle;
+    Heap busy;          // by the time each worker will report back
+} WorkerPool;
+
 typedef struct _MonitoredProcess {
     pid_t processPid;
-    char processName[PROGRAM_NAME_LENGTH];
+    NameId program;
     unsigned int runtime;
     bool beingMonitored;
 } MonitoredProcess;
 
+// the configured programs being looked up together on the thread pool
+typedef struct _PidLookup {
+    int lines[CONFIG_FILE_LINES];   // indexes into configLines
+    pid_t pids[CONFIG_FILE_LINES][MAX_PROCESSES];   // one row per line
+    int count;
+} PidLookup;
+
 
 int pnMain(int argc, char* argv[]);
 
@@ -71,22 +105,28 @@ void checkInputs(int args, char* argv[]);
 void exitError(const char* errorMessage);
 void cleanUp();
 void checkForNewMonitoredProcesses(bool logNoProcessesFound);
-void checkChild(void *childProcess);
+void checkBusyWorkers(WorkerPool* pool);
+bool checkChild(WorkerPool* pool, ChildProcess* child);
 void getCurrentTime(char* buffer);
+long long getMonotonicMs();
 void getPids(const char* processName, pid_t pids[MAX_PROCESSES]);
-void initializeChild(ChildProcess* childWorker, MonitoredProcess* processToBeMonitored);
+void initializeChild(WorkerPool* pool, ChildProcess* childWorker, MonitoredProcess* processToBeMonitored);
 void killChild(void* childProcess);
 void killPid(pid_t pid);
 void killAllProcNannys();
+void lookUpPids(int chunk, void *argument);
+void logEvent(EventType type, pid_t pid, const char* program, unsigned int runtime);
 void logToFile(const char* type, const char* msg, bool logToSTDOUT);
-void monitorNewProcesses(void *monitoredProcess);
+void logWithoutRing(const char* type, const char* msg, bool logToSTDOUT);
+bool beginRingLine(RingLine* line, const char* type);
+void endRingLine(RingLine* line, size_t bodyLength, bool logToSTDOUT);
+void monitorNewProcesses(void *monitoredProcess, void *workerPool);
 void readConfigurationFile();
 void signalHandler(int signo);
+void stopLogging();
 void trimWhitespace(char* str);
 
-bool monitoredProcessComparator(void *mp1, void *mp2);
-bool getChildPredicate(void* childProcess);
 
-ChildProcess* spawnNewChildWorker();
+ChildProcess* spawnNewChildWorker(WorkerPool* pool);
 
 #endif //PROC_NANNY_H
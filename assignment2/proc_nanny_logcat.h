@@ -0,0 +1,30 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROC_NANNY_LOGCAT_H
+#define PROC_NANNY_LOGCAT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "event_log.h"
+
+#define READ_BUFFER_SIZE (1 << 16)
+
+bool decode(FILE* input, EventReader* reader);
+void usage(const char* program);
+
+#endif //PROC_NANNY_LOGCAT_H
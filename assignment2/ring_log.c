@@ -0,0 +1,273 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "ring_log.h"
+#include "log_rotate.h"
+#include "memwatch.h"
+
+// Every line sits behind an 8 byte header holding the size of its slot and,
+// once committed, its length and the committed bit. Slots are 8 byte aligned
+// so a header never straddles the end of the ring; a line that would is
+// preceded by a padding slot running to the end.
+#define HEADER_BYTES 8
+#define COMMITTED (1ULL << 63)
+#define SLOT_SIZE(header) ((uint32_t) ((header) & 0xffffffffULL))
+#define LINE_LENGTH(header) ((uint32_t) (((header) >> 32) & 0x7fffffffULL))
+#define RING_MASK (RL_RING_BYTES - 1)
+
+static char ring[RL_RING_BYTES] __attribute__((aligned(HEADER_BYTES)));
+static uint64_t head = 0;           // next byte to reserve, shared by producers
+static uint64_t tail = 0;           // next byte to write out, only the flusher moves it
+
+static int logFd = -1;
+static char logPath[512];
+static unsigned long long logSize = 0;
+static LogPreamble preamble = NULL;
+
+static int wakePipe[2] = {-1, -1};
+static int sleeping = 0;            // flusher is waiting on wakePipe
+static int stopping = 0;
+static bool running = false;
+static pid_t owner = 0;
+static pthread_t flusherThread;
+
+static RingLogStats stats;
+
+static uint64_t *headerAt(uint64_t position) {
+    return (uint64_t *) (ring + (position & RING_MASK));
+}
+
+static bool openLog() {
+    logFd = open(logPath, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (logFd == -1) {
+        return false;
+    }
+    if (preamble != NULL) {
+        preamble(logFd);
+    }
+    struct stat info;
+    logSize = fstat(logFd, &info) == 0 ? (unsigned long long) info.st_size : 0;
+    return true;
+}
+
+static void writeFully(struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(logFd, iov, count);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        __atomic_add_fetch(&stats.bytes, (unsigned long long) written, __ATOMIC_RELAXED);
+        logSize += (unsigned long long) written;
+        while (count > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// writes out a run of committed lines, returns how many there were
+static int drain() {
+    struct iovec iov[RL_BATCH_RECORDS];
+    int count = 0;
+    uint64_t end = tail;
+    while (count < RL_BATCH_RECORDS) {
+        uint64_t header = __atomic_load_n(headerAt(end), __ATOMIC_SEQ_CST);
+        if ((header & COMMITTED) == 0) {
+            break;
+        }
+        if (LINE_LENGTH(header) > 0) {
+            iov[count].iov_base = ring + ((end + HEADER_BYTES) & RING_MASK);
+            iov[count].iov_len = LINE_LENGTH(header);
+            count++;
+        }
+        end += SLOT_SIZE(header);
+    }
+    if (end == tail) {
+        return 0;
+    }
+
+    if (count > 0) {
+        writeFully(iov, count);
+        __atomic_add_fetch(&stats.records, (unsigned long long) count, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats.writes, 1, __ATOMIC_RELAXED);
+    }
+
+    // old text could pass for a committed header once the space is reused
+    for (uint64_t position = tail; position != end; ) {
+        size_t offset = position & RING_MASK;
+        size_t length = end - position < RL_RING_BYTES - offset ? end - position : RL_RING_BYTES - offset;
+        memset(ring + offset, 0, length);
+        position += length;
+    }
+    __atomic_store_n(&tail, end, __ATOMIC_RELEASE);
+
+    if (lr_due(logSize)) {
+        close(logFd);
+        lr_rotate();
+        openLog();
+    }
+    return count > 0 ? count : 1;
+}
+
+static bool ringEmpty() {
+    return (__atomic_load_n(headerAt(tail), __ATOMIC_SEQ_CST) & COMMITTED) == 0;
+}
+
+static void *flusherMain(void *unused) {
+    while (true) {
+        if (drain() > 0) {
+            continue;
+        }
+        if (__atomic_load_n(&stopping, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+        __atomic_store_n(&sleeping, 1, __ATOMIC_SEQ_CST);
+        if (ringEmpty()) {
+            struct pollfd wake = {wakePipe[0], POLLIN, 0};
+            poll(&wake, 1, RL_FLUSH_INTERVAL_MS);
+            char discard[64];
+            while (read(wakePipe[0], discard, sizeof(discard)) > 0) {
+            }
+        }
+        __atomic_store_n(&sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+    return unused;
+}
+
+void rl_setPreamble(LogPreamble logPreamble) {
+    preamble = logPreamble;
+}
+
+bool rl_start(const char *path) {
+    snprintf(logPath, sizeof(logPath), "%s", path);
+    if (openLog() == false) {
+        return false;
+    }
+    if (pipe(wakePipe) == -1) {
+        close(logFd);
+        return false;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(wakePipe[i], F_SETFL, fcntl(wakePipe[i], F_GETFL) | O_NONBLOCK);
+    }
+
+    head = tail = 0;
+    memset(ring, 0, sizeof(ring));
+    memset(&stats, 0, sizeof(stats));
+    stopping = 0;
+    if (pthread_create(&flusherThread, NULL, &flusherMain, NULL) != 0) {
+        close(logFd);
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        return false;
+    }
+    owner = getpid();
+    running = true;
+    return true;
+}
+
+void rl_stop() {
+    // forked workers inherit the atexit handler but not the thread
+    if (running == false || getpid() != owner) {
+        return;
+    }
+    running = false;
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+    write(wakePipe[1], "x", 1);
+    pthread_join(flusherThread, NULL);
+    close(logFd);
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    logFd = wakePipe[0] = wakePipe[1] = -1;
+}
+
+bool rl_isRunning() {
+    return running && getpid() == owner;
+}
+
+char *rl_reserve(size_t length) {
+    if (rl_isRunning() == false) {
+        return NULL;
+    }
+    uint64_t size = (HEADER_BYTES + length + HEADER_BYTES - 1) & ~(uint64_t) (HEADER_BYTES - 1);
+    if (size > RL_RING_BYTES / 2) {
+        return NULL;
+    }
+
+    uint64_t claimed = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    uint64_t padding;
+    uint64_t needed;
+    do {
+        uint64_t toEnd = RL_RING_BYTES - (claimed & RING_MASK);
+        padding = size > toEnd ? toEnd : 0;
+        needed = padding + size;
+        if (claimed + needed - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) > RL_RING_BYTES) {
+            __atomic_add_fetch(&stats.dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    } while (__atomic_compare_exchange_n(&head, &claimed, claimed + needed, true,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) == false);
+
+    if (padding > 0) {
+        __atomic_store_n(headerAt(claimed), COMMITTED | padding, __ATOMIC_RELEASE);
+        claimed += padding;
+    }
+    // the size is known now, the line only once it is committed
+    __atomic_store_n(headerAt(claimed), size, __ATOMIC_RELAXED);
+    return ring + ((claimed + HEADER_BYTES) & RING_MASK);
+}
+
+void rl_commit(char *record, size_t length) {
+    uint64_t *header = (uint64_t *) (record - HEADER_BYTES);
+    uint64_t size = *header;
+    if (length > size - HEADER_BYTES) {
+        length = size - HEADER_BYTES;
+    }
+    __atomic_store_n(header, COMMITTED | ((uint64_t) length << 32) | size, __ATOMIC_SEQ_CST);
+
+    // only costs a write when the flusher has gone to sleep
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&sleeping, 0, __ATOMIC_SEQ_CST)) {
+        write(wakePipe[1], "x", 1);
+    }
+}
+
+void rl_getStats(RingLogStats *out) {
+    out->records = __atomic_load_n(&stats.records, __ATOMIC_RELAXED);
+    out->bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+    out->writes = __atomic_load_n(&stats.writes, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RING_LOG_H
+#define RING_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Appends to the log from a background thread so the enforcement loop never
+// waits on the disk. Callers reserve space in a lock free ring, format their
+// line straight into it and commit it, the flusher thread then writes every
+// committed line it finds with one writev. When the ring is full the line is
+// dropped and counted rather than blocking.
+
+#define RL_RING_BYTES (1 << 20)         // power of two
+#define RL_FLUSH_INTERVAL_MS 100        // longest the flusher sleeps when idle
+#define RL_BATCH_RECORDS 256            // lines per writev
+
+typedef struct _RingLogStats {
+    unsigned long long records;
+    unsigned long long bytes;
+    unsigned long long writes;
+    unsigned long long dropped;         // ring was full
+} RingLogStats;
+
+// written at the start of every file the flusher opens, rotations included
+typedef void (*LogPreamble)(int fd);
+
+// set before rl_start, NULL for none
+void    rl_setPreamble(LogPreamble preamble);
+
+// opens the log at path and starts the flusher, which also rotates the log
+// when log_rotate says so. False when the log could not be opened or the
+// thread could not be started
+bool    rl_start(const char *path);
+
+// writes out everything committed so far and stops the flusher
+void    rl_stop();
+
+bool    rl_isRunning();
+
+// space for a line of at most length bytes, NULL when the ring is full or
+// the logger is not running. Must be followed by rl_commit.
+char*   rl_reserve(size_t length);
+
+// hands a reserved line of length bytes to the flusher
+void    rl_commit(char *record, size_t length);
+
+void    rl_getStats(RingLogStats *stats);
+
+#endif //RING_LOG_H
@@ -0,0 +1,267 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "admin.h"
+#include "memwatch.h"
+
+static int listener = -1;
+static char socketPath[108];
+static AdminConnection connections[ADMIN_MAX_CONNECTIONS];
+static unsigned long nextConnectionId = 1;
+
+static void dropConnection(AdminConnection *connection) {
+    close(connection->socket);
+    connection->socket = 0;
+    connection->pendingLength = 0;
+    free(connection->output);
+    connection->output = NULL;
+    connection->outputLength = 0;
+    connection->outputCapacity = 0;
+}
+
+// sends without waiting, returns how much went or -1 if the connection broke
+static ssize_t sendSome(AdminConnection *connection, const char *data, size_t length) {
+    ssize_t sent = send(connection->socket, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return sent;
+}
+
+static bool queueOutput(AdminConnection *connection, const char *data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    size_t needed = connection->outputLength + length;
+    if (needed > ADMIN_MAX_OUTPUT) {
+        return false;
+    }
+    if (needed > connection->outputCapacity) {
+        size_t capacity = connection->outputCapacity > 0 ? connection->outputCapacity * 2 : ADMIN_REQUEST_LENGTH * 4;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        char *output = malloc(capacity);
+        if (output == NULL) {
+            return false;
+        }
+        memcpy(output, connection->output, connection->outputLength);
+        free(connection->output);
+        connection->output = output;
+        connection->outputCapacity = capacity;
+    }
+    memcpy(connection->output + connection->outputLength, data, length);
+    connection->outputLength = needed;
+    return true;
+}
+
+static void flushOutput(AdminConnection *connection) {
+    ssize_t sent = sendSome(connection, connection->output, connection->outputLength);
+    if (sent == -1) {
+        dropConnection(connection);
+        return;
+    }
+    connection->outputLength -= (size_t) sent;
+    memmove(connection->output, connection->output + sent, connection->outputLength);
+}
+
+bool admin_open(const char *path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    snprintf(socketPath, sizeof(socketPath), "%s", path);
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        return false;
+    }
+    // a stale socket from a server that did not exit cleanly
+    unlink(path);
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) < 0
+        || listen(listener, ADMIN_MAX_CONNECTIONS) < 0) {
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    for (int i = 0; i < ADMIN_MAX_CONNECTIONS; i++) {
+        memset(&connections[i], 0, sizeof(connections[i]));
+    }
+    return true;
+}
+
+void admin_close() {
+    if (listener == -1) {
+        return;
+    }
+    for (int i = 0; i < ADMIN_MAX_CONNECTIONS; i++) {
+        if (connections[i].socket > 0) {
+            dropConnection(&connections[i]);
+        }
+    }
+    close(listener);
+    listener = -1;
+    unlink(socketPath);
+}
+
+int admin_addToSet(fd_set *readable, fd_set *writable, int maxFd) {
+    if (listener == -1) {
+        return maxFd;
+    }
+    FD_SET(listener, readable);
+    if (listener > maxFd) {
+        maxFd = listener;
+    }
+    for (int i = 0; i < ADMIN_MAX_CONNECTIONS; i++) {
+        int sd = connections[i].socket;
+        if (sd > 0) {
+            FD_SET(sd, readable);
+            if (connections[i].outputLength > 0) {
+                FD_SET(sd, writable);
+            }
+            if (sd > maxFd) {
+                maxFd = sd;
+            }
+        }
+    }
+    return maxFd;
+}
+
+void admin_handle(fd_set *readable, fd_set *writable, AdminHandler handler) {
+    if (listener == -1) {
+        return;
+    }
+
+    for (int i = 0; i < ADMIN_MAX_CONNECTIONS; i++) {
+        if (connections[i].socket > 0 && connections[i].outputLength > 0
+            && FD_ISSET(connections[i].socket, writable)) {
+            flushOutput(&connections[i]);
+        }
+    }
+
+    if (FD_ISSET(listener, readable)) {
+        int sd = accept(listener, NULL, NULL);
+        if (sd >= 0) {
+            int slot = -1;
+            for (int i = 0; i < ADMIN_MAX_CONNECTIONS && slot == -1; i++) {
+                if (connections[i].socket == 0) {
+                    slot = i;
+                }
+            }
+            if (slot == -1) {
+                char busy[] = "ERR too many admin connections\n" ADMIN_END "\n";
+                send(sd, busy, strlen(busy), MSG_NOSIGNAL | MSG_DONTWAIT);
+                close(sd);
+            } else {
+                connections[slot].socket = sd;
+                connections[slot].id = nextConnectionId++;
+                connections[slot].pendingLength = 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < ADMIN_MAX_CONNECTIONS; i++) {
+        AdminConnection *connection = &connections[i];
+        if (connection->socket <= 0 || FD_ISSET(connection->socket, readable) == 0) {
+            continue;
+        }
+        ssize_t valread = read(connection->socket, connection->pending + connection->pendingLength,
+                               ADMIN_REQUEST_LENGTH - 1 - connection->pendingLength);
+        if (valread <= 0) {
+            dropConnection(connection);
+            continue;
+        }
+        connection->pendingLength += valread;
+        connection->pending[connection->pendingLength] = '\0';
+
+        // requests may be pipelined, answer each complete line in order
+        char *line = connection->pending;
+        char *newline;
+        while (connection->socket > 0 && (newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+            if (newline > line && *(newline - 1) == '\r') {
+                *(newline - 1) = '\0';
+            }
+            handler(connection, line);
+            line = newline + 1;
+        }
+        if (connection->socket <= 0) {
+            continue;
+        }
+
+        size_t remaining = connection->pending + connection->pendingLength - line;
+        if (remaining == ADMIN_REQUEST_LENGTH - 1) {
+            admin_reply(connection, "ERR request too long");
+            admin_end(connection);
+            remaining = 0;
+        }
+        memmove(connection->pending, line, remaining);
+        connection->pendingLength = remaining;
+    }
+}
+
+void admin_reply(AdminConnection *connection, const char *format, ...) {
+    if (connection->socket <= 0) {
+        return;
+    }
+    char line[ADMIN_REQUEST_LENGTH * 2];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t) length > sizeof(line) - 2) {
+        length = sizeof(line) - 2;
+    }
+    line[length++] = '\n';
+
+    // behind earlier replies, or whatever the socket would not take now
+    ssize_t sent = 0;
+    if (connection->outputLength == 0) {
+        sent = sendSome(connection, line, (size_t) length);
+    }
+    if (sent == -1 || queueOutput(connection, line + sent, (size_t) (length - sent)) == false) {
+        dropConnection(connection);
+    }
+}
+
+void admin_end(AdminConnection *connection) {
+    admin_reply(connection, ADMIN_END);
+}
+
+AdminConnection *admin_find(unsigned long id) {
+    for (int i = 0; i < ADMIN_MAX_CONNECTIONS; i++) {
+        if (connections[i].socket > 0 && connections[i].id == id) {
+            return &connections[i];
+        }
+    }
+    return NULL;
+}
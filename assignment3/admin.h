@@ -0,0 +1,68 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/select.h>
+
+// The admin socket is a UNIX domain stream socket. Each request is one
+// line, each response is any number of lines followed by ADMIN_END, or a
+// single "ERR <reason>" line followed by ADMIN_END.
+
+#define ADMIN_MAX_CONNECTIONS 8
+#define ADMIN_REQUEST_LENGTH 512
+#define ADMIN_END "END"
+#define ADMIN_DEFAULT_PATH "./procnannyserver.sock"
+// replies a reader has not taken yet, past this it is dropped
+#define ADMIN_MAX_OUTPUT (1024 * 1024)
+
+typedef struct _AdminConnection {
+    int socket;
+    unsigned long id;           // tells a reused slot apart from the one a reply was meant for
+    char pending[ADMIN_REQUEST_LENGTH];
+    size_t pendingLength;
+    char *output;               // replies waiting for the socket to be writable
+    size_t outputLength;
+    size_t outputCapacity;
+} AdminConnection;
+
+typedef void (*AdminHandler)(AdminConnection *connection, char *request);
+
+bool    admin_open(const char *path);
+
+// closes every connection and removes the socket file
+void    admin_close();
+
+// adds the listening socket and every connection to readable, and those
+// with replies still to send to writable, returns the new max fd
+int     admin_addToSet(fd_set *readable, fd_set *writable, int maxFd);
+
+// sends what it can of the waiting replies, accepts new connections and
+// passes every complete request to handler
+void    admin_handle(fd_set *readable, fd_set *writable, AdminHandler handler);
+
+// never blocks, whatever the socket does not take now is sent once it is writable
+void    admin_reply(AdminConnection *connection, const char *format, ...);
+
+void    admin_end(AdminConnection *connection);
+
+// the connection with that id, or NULL once it has gone away
+AdminConnection *admin_find(unsigned long id);
+
+#endif //ADMIN_H
@@ -0,0 +1,381 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Times the containers the programs keep their records in: List, PidMap and
+// Vector, at sizes given on the command line or 1k, 100k and 1M items shaped
+// like a MonitoredProcess. Each container runs the same mixes: inserting
+// every item, looking items up by pid or handle, churn that removes one item
+// and adds another, and walking every item. The List also times the predicate
+// based calls the programs used before the other containers, the Vector its
+// walk with a context.
+//
+// Every row reports ns, allocations and, where perf counters are available,
+// cache misses per operation. Linked with -Wl,--wrap=malloc so allocations
+// are counted whether or not memwatch is built in.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "linked_list.h"
+#include "pid_map.h"
+#include "vector.h"
+#include "memwatch.h"
+
+// List operations that walk the list are only timed on a sample
+#define LIST_SAMPLES 200
+#define LIST_BUDGET 20000000
+// items visited by the iterate mix, whatever the size
+#define ITERATE_VISITS 20000000
+
+// shaped like a MonitoredProcess
+typedef struct _Entry {
+    pid_t pid;
+    unsigned int program;   // an interned name
+    unsigned int runtime;
+    bool monitored;
+} Entry;
+
+// what the context passing walk adds up, checked against vc_forEach
+typedef struct _Tally {
+    unsigned long long runtimes;
+} Tally;
+
+static const int defaultSizes[] = {1000, 100000, 1000000};
+
+static unsigned long long allocations = 0;
+static int cacheMissFd = -1;
+
+static unsigned long long startNs;
+static unsigned long long startAllocations;
+
+// used by the callbacks, visited keeps the walks from being optimised away
+static pid_t wantedPid;
+static unsigned long long visited = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static unsigned int nextRandom(unsigned int *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// distinct odd pids from offset on, in random order
+static pid_t *shuffledPids(int count, int offset) {
+    pid_t *pids = malloc(sizeof(pid_t) * (size_t) count);
+    unsigned int state = 2463534242u;
+    for (int i = 0; i < count; i++) {
+        pids[i] = (pid_t) (i * 2 + 1 + offset);
+    }
+    for (int i = count - 1; i > 0; i--) {
+        int j = (int) (nextRandom(&state) % (unsigned int) (i + 1));
+        pid_t temp = pids[i];
+        pids[i] = pids[j];
+        pids[j] = temp;
+    }
+    return pids;
+}
+
+static void openCacheMisses() {
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    cacheMissFd = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    if (cacheMissFd == -1) {
+        printf("Cache misses are not counted, perf counters are not available here.\n");
+    }
+}
+
+static void begin() {
+    if (cacheMissFd != -1) {
+        ioctl(cacheMissFd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cacheMissFd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    startAllocations = allocations;
+    startNs = nowNs();
+}
+
+static void end(const char *container, const char *operation, long operations) {
+    unsigned long long elapsed = nowNs() - startNs;
+    unsigned long long allocated = allocations - startAllocations;
+    char misses[32] = "-";
+    if (cacheMissFd != -1) {
+        ioctl(cacheMissFd, PERF_EVENT_IOC_DISABLE, 0);
+        unsigned long long count = 0;
+        if (read(cacheMissFd, &count, sizeof(count)) == sizeof(count)) {
+            snprintf(misses, sizeof(misses), "%.2f", (double) count / operations);
+        }
+    }
+    printf("%-8s %-12s %10.1f ns/op %8.3f allocs/op %8s misses/op\n", container, operation,
+           (double) elapsed / operations, (double) allocated / operations, misses);
+}
+
+static int listSamples(int count) {
+    int samples = LIST_BUDGET / count;
+    if (samples > LIST_SAMPLES) {
+        samples = LIST_SAMPLES;
+    }
+    return samples < 1 ? 1 : samples;
+}
+
+static bool samePid(void *first, void *second) {
+    return ((Entry *) first)->pid == ((Entry *) second)->pid;
+}
+
+static bool isWanted(void *item) {
+    return ((Entry *) item)->pid == wantedPid;
+}
+
+// half of the pids
+static bool isRemovable(void *item) {
+    return ((Entry *) item)->pid % 4 == 1;
+}
+
+static void visit(void *item) {
+    visited += ((Entry *) item)->runtime;
+}
+
+static void addRuntime(void *item, void *context) {
+    ((Tally *) context)->runtimes += ((Entry *) item)->runtime;
+}
+
+static unsigned int runtimeOf(pid_t pid) {
+    return (unsigned int) pid % 60 + 1;
+}
+
+static void runList(int count) {
+    pid_t *pids = shuffledPids(count, 0);
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    int samples = listSamples(count);
+
+    List list;
+    ll_init(&list, sizeof(Entry), &samePid);
+    begin();
+    for (int i = 0; i < count; i++) {
+        entry.pid = pids[i];
+        entry.runtime = runtimeOf(entry.pid);
+        ll_add(&list, &entry);
+    }
+    end("list", "add", count);
+
+    // spread over the list, so on average half of it is walked
+    begin();
+    for (int i = 0; i < samples; i++) {
+        entry.pid = pids[(long) i * count / samples];
+        entry.runtime = runtimeOf(entry.pid);
+        ll_add_unique(&list, &entry);
+    }
+    end("list", "add existing", samples);
+
+    begin();
+    for (int i = 0; i < samples; i++) {
+        wantedPid = pids[(long) i * count / samples];
+        ll_getIf(&list, &isWanted);
+    }
+    end("list", "getIf", samples);
+
+    // the removed item goes back at the tail
+    begin();
+    for (int i = 0; i < samples; i++) {
+        entry.pid = pids[(long) i * count / samples];
+        entry.runtime = runtimeOf(entry.pid);
+        ll_remove(&list, &entry);
+        ll_add(&list, &entry);
+    }
+    end("list", "churn", samples);
+
+    int passes = ITERATE_VISITS / count > 0 ? ITERATE_VISITS / count : 1;
+    begin();
+    for (int i = 0; i < passes; i++) {
+        ll_forEach(&list, &visit);
+    }
+    end("list", "forEach", (long) passes * count);
+
+    begin();
+    ll_removeIf(&list, &isRemovable);
+    end("list", "removeIf", count);
+
+    ll_free(&list);
+    free(pids);
+}
+
+static void runPidMap(int count) {
+    pid_t *pids = shuffledPids(count, 0);
+    pid_t *replacements = shuffledPids(count, count * 2);
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+
+    PidMap map;
+    pm_init(&map, sizeof(Entry));
+    begin();
+    for (int i = 0; i < count; i++) {
+        entry.pid = pids[i];
+        entry.runtime = runtimeOf(entry.pid);
+        pm_add(&map, pids[i], &entry);
+    }
+    end("pid map", "add", count);
+
+    unsigned long found = 0;
+    begin();
+    for (int i = count - 1; i >= 0; i--) {
+        found += pm_get(&map, pids[i]) != NULL;
+    }
+    end("pid map", "get", count);
+
+    begin();
+    for (int i = 0; i < count; i++) {
+        pm_remove(&map, pids[i]);
+        entry.pid = replacements[i];
+        entry.runtime = runtimeOf(entry.pid);
+        pm_add(&map, replacements[i], &entry);
+    }
+    end("pid map", "churn", count);
+
+    int passes = ITERATE_VISITS / count > 0 ? ITERATE_VISITS / count : 1;
+    begin();
+    for (int i = 0; i < passes; i++) {
+        pm_forEach(&map, &visit);
+    }
+    end("pid map", "forEach", (long) passes * count);
+
+    if (found != (unsigned long) count || pm_size(&map) != count) {
+        printf("Error: the pid map lost track of its entries.\n");
+        exit(EXIT_FAILURE);
+    }
+    pm_free(&map);
+    free(pids);
+    free(replacements);
+}
+
+static void runVector(int count) {
+    VectorHandle *handles = malloc(sizeof(VectorHandle) * (size_t) count);
+    unsigned int state = 88172645u;
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+
+    Vector vector;
+    vc_init(&vector, sizeof(Entry));
+    begin();
+    for (int i = 0; i < count; i++) {
+        entry.pid = (pid_t) (i + 1);
+        entry.runtime = runtimeOf(entry.pid);
+        handles[i] = vc_add(&vector, &entry);
+    }
+    end("vector", "add", count);
+
+    unsigned long found = 0;
+    begin();
+    for (int i = 0; i < count; i++) {
+        found += vc_get(&vector, handles[nextRandom(&state) % (unsigned int) count]) != NULL;
+    }
+    end("vector", "get", count);
+
+    begin();
+    for (int i = 0; i < count; i++) {
+        int victim = (int) (nextRandom(&state) % (unsigned int) count);
+        vc_remove(&vector, handles[victim]);
+        entry.pid = (pid_t) (count + i + 1);
+        entry.runtime = runtimeOf(entry.pid);
+        handles[victim] = vc_add(&vector, &entry);
+    }
+    end("vector", "churn", count);
+
+    int passes = ITERATE_VISITS / count > 0 ? ITERATE_VISITS / count : 1;
+    unsigned long long before = visited;
+    begin();
+    for (int i = 0; i < passes; i++) {
+        vc_forEach(&vector, &visit);
+    }
+    end("vector", "forEach", (long) passes * count);
+
+    // the same passes with a context have to add up to what forEach did
+    Tally tally;
+    memset(&tally, 0, sizeof(tally));
+    begin();
+    for (int i = 0; i < passes; i++) {
+        vc_forEachWith(&vector, &addRuntime, &tally);
+    }
+    end("vector", "forEachWith", (long) passes * count);
+    if (tally.runtimes != visited - before) {
+        printf("Error: the vector forEachWith visited %llu, forEach %llu.\n", tally.runtimes, visited - before);
+        exit(EXIT_FAILURE);
+    }
+
+    if (found != (unsigned long) count || vc_size(&vector) != count) {
+        printf("Error: the vector lost track of its entries.\n");
+        exit(EXIT_FAILURE);
+    }
+    vc_free(&vector);
+    free(handles);
+}
+
+int main(int args, char *argv[]) {
+    openCacheMisses();
+#ifdef MEMWATCH
+    printf("Built with memwatch.\n");
+#else
+    printf("Built without memwatch.\n");
+#endif
+
+    int sizeCount = args > 1 ? args - 1 : (int) (sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+    for (int i = 0; i < sizeCount; i++) {
+        int count = args > 1 ? atoi(argv[i + 1]) : defaultSizes[i];
+        if (count <= 0) {
+            printf("Error: '%s' is not a number of items.\n", argv[i + 1]);
+            return EXIT_FAILURE;
+        }
+        printf("%d items\n", count);
+        runList(count);
+        runPidMap(count);
+        runVector(count);
+    }
+    if (cacheMissFd != -1) {
+        close(cacheMissFd);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Compares 2, 4 and 8-ary layouts of Heap on what the client does with its
+// busy workers and what other deadline queues would: pushing items, moving
+// them to earlier keys, building a heap from an array at once and popping
+// everything in order.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "heap.h"
+#include "memwatch.h"
+
+// a deadline, with the position the heap keeps up to date
+typedef struct _Timer {
+    int position;
+    long long deadline;
+} Timer;
+
+static const int sizes[] = {1000, 100000, 1000000};
+static const int arities[] = {2, 4, 8};
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static unsigned int nextRandom(unsigned int *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void report(int arity, const char *operation, int count, unsigned long long ns) {
+    printf("%d-ary  %-10s %10.1f ns/op\n", arity, operation, (double) ns / count);
+}
+
+// pops everything, failing if the keys do not come out in order
+static void popAll(Heap *heap, int arity, int count) {
+    long long previous = -1;
+    unsigned long long start = nowNs();
+    for (int i = 0; i < count; i++) {
+        Timer *timer = hp_pop(heap);
+        if (timer == NULL || timer->deadline < previous || timer->position != HP_NOT_QUEUED) {
+            printf("Error: the %d-ary heap popped out of order.\n", arity);
+            exit(EXIT_FAILURE);
+        }
+        previous = timer->deadline;
+    }
+    report(arity, "pop", count, nowNs() - start);
+}
+
+static void run(int arity, int count) {
+    Timer *timers = malloc(sizeof(Timer) * (size_t) count);
+    void **items = malloc(sizeof(void *) * (size_t) count);
+    long long *keys = malloc(sizeof(long long) * (size_t) count);
+    unsigned int state = 2463534242u;
+    for (int i = 0; i < count; i++) {
+        timers[i].position = HP_NOT_QUEUED;
+        timers[i].deadline = (long long) (nextRandom(&state) % 1000000000u);
+        items[i] = &timers[i];
+        keys[i] = timers[i].deadline;
+    }
+
+    Heap heap;
+    hp_init(&heap, arity, offsetof(Timer, position));
+    unsigned long long start = nowNs();
+    for (int i = 0; i < count; i++) {
+        hp_push(&heap, &timers[i], timers[i].deadline);
+    }
+    report(arity, "push", count, nowNs() - start);
+
+    start = nowNs();
+    for (int i = 0; i < count; i++) {
+        Timer *timer = &timers[nextRandom(&state) % (unsigned int) count];
+        timer->deadline /= 2;
+        hp_update(&heap, timer, timer->deadline);
+    }
+    report(arity, "decrease", count, nowNs() - start);
+    popAll(&heap, arity, count);
+
+    for (int i = 0; i < count; i++) {
+        keys[i] = timers[i].deadline;
+    }
+    start = nowNs();
+    hp_heapify(&heap, items, keys, count);
+    report(arity, "heapify", count, nowNs() - start);
+    popAll(&heap, arity, count);
+
+    hp_free(&heap);
+    free(timers);
+    free(items);
+    free(keys);
+}
+
+int main(int args, char *argv[]) {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        printf("%d timers\n", sizes[i]);
+        for (size_t j = 0; j < sizeof(arities) / sizeof(arities[0]); j++) {
+            run(arities[j], sizes[i]);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,639 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Synthetic clients for measuring how much procnanny.server can take in.
+// Opens many connections from one process, sends the same kind of records
+// procnanny.client does at a chosen rate and burst shape, and reports
+//  - records per second the server's log writer got through,
+//  - how long records took to reach the log file, found by tailing it,
+//  - how long a SIGHUP takes to push configuration to every connection,
+//  - with -z, what compressing each burst saves and costs on both ends.
+// Everything runs over loopback against an already running server.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "protocol.h"
+#include "admin.h"
+#include "compress.h"
+#include "memwatch.h"
+
+#define OUT_BUFFER_SIZE 8192
+#define RECORD_LENGTH 512
+#define LINE_BUFFER_SIZE 128
+#define TAIL_BUFFER_SIZE 65536
+#define MAX_SAMPLES 1000000
+#define DRAIN_TIMEOUT_MS 3000
+#define FANOUT_TIMEOUT_MS 5000
+#define BENCH_TAG "#bench "
+
+typedef struct _BenchConnection {
+    int socket;                       // -1 once the server closed it
+    char out[OUT_BUFFER_SIZE];        // records the socket has not taken yet
+    size_t outLength;
+    char line[LINE_BUFFER_SIZE];      // start of the line being read from the server
+    size_t lineLength;
+    unsigned long long nextBurstNs;
+    unsigned long long configNs;      // when configuration last arrived
+    unsigned long sequence;
+} BenchConnection;
+
+typedef struct _BenchOptions {
+    char host[NODE_NAME_LENGTH];
+    int port;
+    int connections;
+    double rate;                      // records per second over all connections, 0 floods
+    int burst;                        // records one connection sends back to back
+    bool storm;                       // every connection bursts at the same moment
+    bool compress;                    // each burst goes as one dictionary compressed batch
+    int duration;
+    char logPath[512];
+    char infoPath[512];
+    char adminPath[108];
+} BenchOptions;
+
+static BenchOptions options;
+static BenchConnection *connections;
+static struct pollfd *polls;
+static int openConnections = 0;
+
+static unsigned long long *latencies;
+static size_t latencyCount = 0;
+
+static int logFd = -1;
+static char tail[TAIL_BUFFER_SIZE];
+static size_t tailLength = 0;
+
+static char timestamp[64];
+static unsigned long long recordsSent = 0;
+static unsigned long long recordsDropped = 0;
+
+static char compressed[OUT_BUFFER_SIZE + OUT_BUFFER_SIZE / 255 + 16];
+static unsigned long long batchesCompressed = 0;
+static unsigned long long rawBytes = 0;
+static unsigned long long compressedBytes = 0;
+static unsigned long long compressNs = 0;
+
+// what the admin socket's QUEUES reply says, -1 where it could not be read
+typedef struct _ServerCounters {
+    long long records;
+    long long batches;
+    long long rawBytes;
+    long long compressedBytes;
+    long long decompressUs;
+} ServerCounters;
+
+static const char *programs[] = {"a.out", "test5", "test15", "sshd", "cron", "backup.sh", "python3", "java"};
+#define PROGRAM_COUNT (sizeof(programs) / sizeof(programs[0]))
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static unsigned long long cpuNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void usage(const char *program) {
+    printf("Usage: %s [-h host] [-p port] [-c connections] [-r records/s] [-b burst] [-S] [-z]\n"
+           "       [-d seconds] [-l server log] [-i server info] [-a admin socket]\n"
+           "  -r 0 sends as fast as the server takes it, -S makes every connection burst together,\n"
+           "  -z compresses each burst the way a client does once the server offers it\n", program);
+    exit(EXIT_FAILURE);
+}
+
+static void readOptions(int args, char *argv[]) {
+    snprintf(options.host, sizeof(options.host), "127.0.0.1");
+    options.port = 8888;
+    options.connections = 100;
+    options.rate = 10000;
+    options.burst = 1;
+    options.storm = false;
+    options.duration = 10;
+
+    const char *log = getenv("PROCNANNYLOGS");
+    snprintf(options.logPath, sizeof(options.logPath), "%s", log != NULL ? log : "./procnannyserver.log");
+    const char *info = getenv("PROCNANNYSERVERINFO");
+    snprintf(options.infoPath, sizeof(options.infoPath), "%s", info != NULL ? info : "./procnannyserver.info");
+    const char *admin = getenv("PROCNANNYADMIN");
+    snprintf(options.adminPath, sizeof(options.adminPath), "%s", admin != NULL ? admin : ADMIN_DEFAULT_PATH);
+
+    int option;
+    while ((option = getopt(args, argv, "h:p:c:r:b:Szd:l:i:a:")) != -1) {
+        switch (option) {
+            case 'h': snprintf(options.host, sizeof(options.host), "%s", optarg); break;
+            case 'p': options.port = atoi(optarg); break;
+            case 'c': options.connections = atoi(optarg); break;
+            case 'r': options.rate = atof(optarg); break;
+            case 'b': options.burst = atoi(optarg); break;
+            case 'S': options.storm = true; break;
+            case 'z': options.compress = true; break;
+            case 'd': options.duration = atoi(optarg); break;
+            case 'l': snprintf(options.logPath, sizeof(options.logPath), "%s", optarg); break;
+            case 'i': snprintf(options.infoPath, sizeof(options.infoPath), "%s", optarg); break;
+            case 'a': snprintf(options.adminPath, sizeof(options.adminPath), "%s", optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (options.connections <= 0 || options.burst <= 0 || options.duration <= 0 || options.rate < 0) {
+        usage(argv[0]);
+    }
+}
+
+// false when the socket is that far behind, a real client would block here
+static bool queueRecord(BenchConnection *connection, const char *format, ...) {
+    char record[RECORD_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record, sizeof(record), format, args);
+    va_end(args);
+    if (length < 0 || (size_t) length >= sizeof(record)
+        || connection->outLength + (size_t) length > OUT_BUFFER_SIZE) {
+        return false;
+    }
+    memcpy(connection->out + connection->outLength, record, (size_t) length);
+    connection->outLength += length;
+    return true;
+}
+
+// replaces out[start, outLength) with a compressed batch when that is smaller
+static void compressBurst(BenchConnection *connection, size_t start) {
+    size_t length = connection->outLength - start;
+    if (length == 0) {
+        return;
+    }
+    unsigned long long before = cpuNs();
+    size_t compressedLength = lz_compressWithDictionary(connection->out + start, length, compressed,
+                                                        sizeof(compressed));
+    compressNs += cpuNs() - before;
+
+    char header[64];
+    int headerLength = snprintf(header, sizeof(header), "%s %zu %zu %d\n", PROTOCOL_BATCH, length,
+                                compressedLength, LZ_DICTIONARY_VERSION);
+    batchesCompressed++;
+    rawBytes += length;
+    if (compressedLength == 0 || compressedLength + headerLength >= length) {
+        compressedBytes += length;
+        return;
+    }
+    memcpy(connection->out + start, header, (size_t) headerLength);
+    memcpy(connection->out + start + headerLength, compressed, compressedLength);
+    connection->outLength = start + headerLength + compressedLength;
+    compressedBytes += headerLength + compressedLength;
+}
+
+// the mix procnanny.client produces: mostly monitoring notices, some misses and kills
+static void sendBurst(BenchConnection *connection) {
+    size_t start = connection->outLength;
+    for (int i = 0; i < options.burst; i++) {
+        unsigned long sequence = connection->sequence++;
+        const char *program = programs[sequence % PROGRAM_COUNT];
+        int pid = (int) (1000 + sequence % 30000);
+        bool queued;
+        switch (sequence % 10) {
+            case 0:
+                queued = queueRecord(connection, "%s %ld %d %u %s\n", PROTOCOL_KILLED, (long) time(NULL),
+                                     pid, 5u, program);
+                break;
+            case 1:
+            case 2:
+                queued = queueRecord(connection, "[%s] Info: No '%s' processes found on " PROTOCOL_NODE_MARKER
+                                     " " BENCH_TAG "%llu\n", timestamp, program, nowNs());
+                break;
+            default:
+                queued = queueRecord(connection, "[%s] Info: Initializing monitoring of process '%s' (PID %d) "
+                                     "on node " PROTOCOL_NODE_MARKER ". " BENCH_TAG "%llu\n",
+                                     timestamp, program, pid, nowNs());
+        }
+        if (queued) {
+            recordsSent++;
+        }
+        else {
+            recordsDropped++;
+        }
+    }
+    if (options.compress) {
+        compressBurst(connection, start);
+    }
+}
+
+static void connectAll() {
+    // one fd per connection plus a few of our own
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (rlim_t) options.connections + 64) {
+        limit.rlim_cur = limit.rlim_max < (rlim_t) options.connections + 64
+                         ? limit.rlim_max : (rlim_t) options.connections + 64;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) options.port);
+    if (inet_pton(AF_INET, options.host, &address.sin_addr) != 1) {
+        printf("Error: %s is not an IPv4 address.\n", options.host);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < options.connections; i++) {
+        BenchConnection *connection = &connections[i];
+        connection->socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (connection->socket < 0) {
+            printf("Error: only %d connections could be opened.\n", i);
+            exit(EXIT_FAILURE);
+        }
+        if (connect(connection->socket, (struct sockaddr *) &address, sizeof(address)) < 0
+            && errno != EINPROGRESS) {
+            close(connection->socket);
+            connection->socket = -1;
+            continue;
+        }
+        openConnections++;
+        char node[NODE_NAME_LENGTH];
+        snprintf(node, sizeof(node), "bench-%d", i);
+        queueRecord(connection, "%s %s\n", PROTOCOL_NODE, node);
+    }
+}
+
+static void dropConnection(BenchConnection *connection) {
+    close(connection->socket);
+    connection->socket = -1;
+    connection->outLength = 0;
+    openConnections--;
+}
+
+static void readFromServer(BenchConnection *connection) {
+    char buffer[4096];
+    ssize_t received = read(connection->socket, buffer, sizeof(buffer));
+    if (received == 0 || (received < 0 && errno != EAGAIN)) {
+        dropConnection(connection);
+        return;
+    }
+    // only the start of each line matters, enough to spot a configuration
+    for (ssize_t i = 0; i < received; i++) {
+        if (buffer[i] == '\n') {
+            connection->line[connection->lineLength] = '\0';
+            if (strncmp(connection->line, PROTOCOL_CONFIG, strlen(PROTOCOL_CONFIG)) == 0
+                && connection->configNs == 0) {
+                connection->configNs = nowNs();
+            }
+            connection->lineLength = 0;
+        }
+        else if (connection->lineLength < LINE_BUFFER_SIZE - 1) {
+            connection->line[connection->lineLength++] = buffer[i];
+        }
+    }
+}
+
+static void writeToServer(BenchConnection *connection) {
+    ssize_t written = write(connection->socket, connection->out, connection->outLength);
+    if (written < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            dropConnection(connection);
+        }
+        return;
+    }
+    memmove(connection->out, connection->out + written, connection->outLength - written);
+    connection->outLength -= written;
+}
+
+// every tagged record that reached the log since the last look
+static void tailLog() {
+    if (logFd == -1) {
+        return;
+    }
+    ssize_t received;
+    while ((received = read(logFd, tail + tailLength, sizeof(tail) - 1 - tailLength)) > 0) {
+        unsigned long long now = nowNs();
+        tailLength += received;
+        tail[tailLength] = '\0';
+
+        char *line = tail;
+        char *newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+            char *tag = strstr(line, BENCH_TAG);
+            unsigned long long sent;
+            if (tag != NULL && latencyCount < MAX_SAMPLES
+                && sscanf(tag + strlen(BENCH_TAG), "%llu", &sent) == 1 && sent <= now) {
+                latencies[latencyCount++] = now - sent;
+            }
+            line = newline + 1;
+        }
+        tailLength = tail + tailLength - line;
+        memmove(tail, line, tailLength);
+        if (tailLength == sizeof(tail) - 1) {
+            tailLength = 0;
+        }
+    }
+
+    // follow the log across a rotation, the new file is read from the start
+    struct stat opened, current;
+    if (fstat(logFd, &opened) == 0 && stat(options.logPath, &current) == 0 && opened.st_ino != current.st_ino) {
+        int reopened = open(options.logPath, O_RDONLY);
+        if (reopened != -1) {
+            close(logFd);
+            logFd = reopened;
+            tailLength = 0;
+        }
+    }
+}
+
+// one round of poll over every connection, sends and reads whatever is ready
+static void pollConnections(int timeoutMs) {
+    for (int i = 0; i < options.connections; i++) {
+        polls[i].fd = connections[i].socket;
+        polls[i].events = POLLIN | (connections[i].outLength > 0 ? POLLOUT : 0);
+        polls[i].revents = 0;
+    }
+    if (poll(polls, (nfds_t) options.connections, timeoutMs) <= 0) {
+        return;
+    }
+    for (int i = 0; i < options.connections; i++) {
+        BenchConnection *connection = &connections[i];
+        if (connection->socket < 0 || polls[i].revents == 0) {
+            continue;
+        }
+        if (polls[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+            readFromServer(connection);
+        }
+        if (connection->socket >= 0 && (polls[i].revents & POLLOUT)) {
+            writeToServer(connection);
+        }
+    }
+}
+
+static void formatTimestamp() {
+    time_t rawTime = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%a %b %d %H:%M:%S %Z %Y", localtime(&rawTime));
+}
+
+static void runLoad() {
+    unsigned long long start = nowNs();
+    unsigned long long end = start + (unsigned long long) options.duration * 1000000000ULL;
+    unsigned long long interval = options.rate > 0
+                                  ? (unsigned long long) (1e9 * options.burst * options.connections / options.rate) : 0;
+    for (int i = 0; i < options.connections; i++) {
+        connections[i].nextBurstNs = start + (options.storm ? 0 : interval * i / options.connections);
+    }
+
+    unsigned long long now;
+    while ((now = nowNs()) < end && openConnections > 0) {
+        formatTimestamp();
+        for (int i = 0; i < options.connections; i++) {
+            BenchConnection *connection = &connections[i];
+            if (connection->socket < 0) {
+                continue;
+            }
+            if (interval == 0) {
+                // flooding, keep each socket's buffer topped up
+                if (connection->outLength < OUT_BUFFER_SIZE / 2) {
+                    sendBurst(connection);
+                }
+            }
+            else if (now >= connection->nextBurstNs) {
+                sendBurst(connection);
+                connection->nextBurstNs += interval;
+            }
+        }
+        pollConnections(interval == 0 ? 0 : 1);
+        tailLog();
+    }
+
+    // let the server catch up with what was sent before measuring it
+    unsigned long long drainEnd = nowNs() + DRAIN_TIMEOUT_MS * 1000000ULL;
+    size_t seen = latencyCount;
+    unsigned long long quietSince = nowNs();
+    while ((now = nowNs()) < drainEnd && now - quietSince < 200000000ULL) {
+        pollConnections(1);
+        tailLog();
+        bool pending = false;
+        for (int i = 0; i < options.connections; i++) {
+            if (connections[i].socket >= 0 && connections[i].outLength > 0) {
+                pending = true;
+            }
+        }
+        if (pending || latencyCount != seen) {
+            quietSince = now;
+            seen = latencyCount;
+        }
+    }
+}
+
+// the log writer and compression counters from the admin socket
+static void readServerCounters(ServerCounters *counters) {
+    counters->records = counters->batches = counters->rawBytes = -1;
+    counters->compressedBytes = counters->decompressUs = -1;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", options.adminPath);
+
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0 || connect(sd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        if (sd >= 0) {
+            close(sd);
+        }
+        return;
+    }
+    char request[] = "QUEUES\n";
+    write(sd, request, strlen(request));
+
+    char response[4096];
+    size_t length = 0;
+    ssize_t received;
+    while (length < sizeof(response) - 1
+           && (received = read(sd, response + length, sizeof(response) - 1 - length)) > 0) {
+        length += received;
+        response[length] = '\0';
+        if (strstr(response, "\n" ADMIN_END "\n") != NULL) {
+            break;
+        }
+    }
+    close(sd);
+    response[length] = '\0';
+
+    char *field = strstr(response, "records=");
+    if (field != NULL) {
+        sscanf(field, "records=%lld", &counters->records);
+    }
+    field = strstr(response, "compression batches=");
+    if (field != NULL) {
+        sscanf(field, "compression batches=%lld raw_bytes=%lld compressed_bytes=%lld decompress_us=%lld",
+               &counters->batches, &counters->rawBytes, &counters->compressedBytes, &counters->decompressUs);
+    }
+}
+
+static int compareTimes(const void *first, const void *second) {
+    unsigned long long a = *(const unsigned long long *) first;
+    unsigned long long b = *(const unsigned long long *) second;
+    return a < b ? -1 : a > b;
+}
+
+static void printPercentiles(const char *label, unsigned long long *samples, size_t count) {
+    if (count == 0) {
+        printf("%-20s no samples\n", label);
+        return;
+    }
+    qsort(samples, count, sizeof(unsigned long long), &compareTimes);
+    printf("%-20s p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  max %8.1f us  (%zu samples)\n", label,
+           samples[count / 2] / 1e3, samples[count * 99 / 100] / 1e3, samples[count * 999 / 1000] / 1e3,
+           samples[count - 1] / 1e3, count);
+}
+
+// SIGHUP the server and time how long until every connection has the new configuration
+static void runFanout() {
+    FILE *info = fopen(options.infoPath, "r");
+    int pid = 0;
+    if (info == NULL || fscanf(info, "NODE %*s PID %d", &pid) != 1 || pid <= 0) {
+        printf("%-20s skipped, no server pid in %s\n", "config fan-out", options.infoPath);
+        if (info != NULL) {
+            fclose(info);
+        }
+        return;
+    }
+    fclose(info);
+
+    for (int i = 0; i < options.connections; i++) {
+        connections[i].configNs = 0;
+    }
+    unsigned long long start = nowNs();
+    if (kill(pid, SIGHUP) == -1) {
+        printf("%-20s skipped, could not signal PID %d\n", "config fan-out", pid);
+        return;
+    }
+
+    int waiting = openConnections;
+    while (waiting > 0 && nowNs() - start < FANOUT_TIMEOUT_MS * 1000000ULL) {
+        pollConnections(1);
+        waiting = 0;
+        for (int i = 0; i < options.connections; i++) {
+            if (connections[i].socket >= 0 && connections[i].configNs == 0) {
+                waiting++;
+            }
+        }
+    }
+
+    unsigned long long *times = malloc(sizeof(unsigned long long) * options.connections);
+    size_t count = 0;
+    for (int i = 0; i < options.connections; i++) {
+        if (connections[i].socket >= 0 && connections[i].configNs != 0) {
+            times[count++] = connections[i].configNs - start;
+        }
+    }
+    printPercentiles("config fan-out", times, count);
+    if (waiting > 0) {
+        printf("%-20s %d connection(s) did not get the configuration within %d ms\n", "", waiting,
+               FANOUT_TIMEOUT_MS);
+    }
+    free(times);
+}
+
+int main(int args, char *argv[]) {
+    signal(SIGPIPE, SIG_IGN);
+    readOptions(args, argv);
+
+    connections = calloc((size_t) options.connections, sizeof(BenchConnection));
+    polls = calloc((size_t) options.connections, sizeof(struct pollfd));
+    latencies = malloc(sizeof(unsigned long long) * MAX_SAMPLES);
+
+    logFd = open(options.logPath, O_RDONLY);
+    if (logFd == -1) {
+        printf("Warning: could not open %s, no log latency.\n", options.logPath);
+    }
+    else {
+        lseek(logFd, 0, SEEK_END);
+    }
+
+    connectAll();
+    // give the server a moment to accept everyone and send configuration
+    unsigned long long settle = nowNs() + 500000000ULL;
+    while (nowNs() < settle) {
+        pollConnections(10);
+    }
+    int accepted = openConnections;
+    ServerCounters before;
+    readServerCounters(&before);
+    unsigned long long start = nowNs();
+
+    runLoad();
+
+    double elapsed = (nowNs() - start) / 1e9;
+    ServerCounters after;
+    readServerCounters(&after);
+
+    printf("%d connection(s) requested, %d accepted, %d still open\n", options.connections, accepted,
+           openConnections);
+    printf("%-20s %llu records in %.1f s, %.0f records/s, %llu dropped on full buffers\n", "sent",
+           recordsSent, elapsed, recordsSent / elapsed, recordsDropped);
+    if (before.records >= 0 && after.records >= 0) {
+        printf("%-20s %lld records, %.0f records/s\n", "server log writer", after.records - before.records,
+               (after.records - before.records) / elapsed);
+    }
+    else {
+        printf("%-20s unknown, admin socket %s not reachable\n", "server log writer", options.adminPath);
+    }
+    if (options.compress && batchesCompressed > 0) {
+        printf("%-20s %llu bytes to %llu, ratio %.2f, %.2f us CPU per batch, %.0f MB/s\n", "client compression",
+               rawBytes, compressedBytes, (double) rawBytes / compressedBytes,
+               compressNs / 1e3 / batchesCompressed, compressNs > 0 ? rawBytes * 1e3 / compressNs : 0.0);
+        long long batches = after.batches - before.batches;
+        if (before.batches >= 0 && after.batches >= 0 && batches > 0) {
+            long long decompressUs = after.decompressUs - before.decompressUs;
+            printf("%-20s %lld batches, %.2f us CPU per batch, %.0f MB/s\n", "server decompression",
+                   batches, (double) decompressUs / batches,
+                   decompressUs > 0 ? (after.rawBytes - before.rawBytes) / (double) decompressUs : 0.0);
+        }
+    }
+    printPercentiles("log latency", latencies, latencyCount);
+    runFanout();
+
+    for (int i = 0; i < options.connections; i++) {
+        if (connections[i].socket >= 0) {
+            close(connections[i].socket);
+        }
+    }
+    if (logFd != -1) {
+        close(logFd);
+    }
+    free(connections);
+    free(polls);
+    free(latencies);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Compares PidMap with the List it replaced for the client's monitored
+// processes: adding pids found on a refresh, looking them up, and removing
+// them once their worker reports back. The List side only times a sample of
+// operations at each size, each one walks the whole list.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pid_map.h"
+#include "linked_list.h"
+#include "memwatch.h"
+
+// List operations timed per size, fewer once each takes milliseconds
+#define LIST_SAMPLES 200
+#define LIST_BUDGET 20000000
+
+// shaped like a MonitoredProcess
+typedef struct _Entry {
+    pid_t pid;
+    unsigned int program;   // an interned name
+    unsigned int runtime;
+    bool monitored;
+} Entry;
+
+static const int sizes[] = {1000, 100000, 1000000};
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static unsigned int nextRandom(unsigned int *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// odd pids are present, even ones never are
+static pid_t *shuffledPids(int count, int offset) {
+    pid_t *pids = malloc(sizeof(pid_t) * (size_t) count);
+    unsigned int state = 2463534242u;
+    for (int i = 0; i < count; i++) {
+        pids[i] = (pid_t) (i * 2 + 1 + offset);
+    }
+    for (int i = count - 1; i > 0; i--) {
+        int j = (int) (nextRandom(&state) % (unsigned int) (i + 1));
+        pid_t temp = pids[i];
+        pids[i] = pids[j];
+        pids[j] = temp;
+    }
+    return pids;
+}
+
+static bool samePid(void *first, void *second) {
+    return ((Entry *) first)->pid == ((Entry *) second)->pid;
+}
+
+static void report(const char *name, const char *operation, int count, unsigned long long ns) {
+    printf("%-8s %-12s %12.1f ns/op\n", name, operation, (double) ns / count);
+}
+
+static void runMap(int count) {
+    pid_t *present = shuffledPids(count, 0);
+    pid_t *absent = shuffledPids(count, 1);
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+
+    PidMap map;
+    pm_init(&map, sizeof(Entry));
+    unsigned long long start = nowNs();
+    for (int i = 0; i < count; i++) {
+        entry.pid = present[i];
+        pm_add(&map, present[i], &entry);
+    }
+    // includes growing the table, mostly the page faults of touching new memory
+    report("pid map", "add", count, nowNs() - start);
+
+    // what every refresh does for pids already being monitored
+    start = nowNs();
+    for (int i = 0; i < count; i++) {
+        pm_add(&map, present[i], &entry);
+    }
+    report("pid map", "add existing", count, nowNs() - start);
+
+    unsigned long found = 0;
+    start = nowNs();
+    for (int i = 0; i < count; i++) {
+        found += pm_get(&map, absent[i]) != NULL;
+    }
+    report("pid map", "miss", count, nowNs() - start);
+
+    start = nowNs();
+    for (int i = 0; i < count; i++) {
+        found += pm_remove(&map, present[i]);
+    }
+    report("pid map", "remove", count, nowNs() - start);
+
+    if (found != (unsigned long) count || pm_size(&map) != 0) {
+        printf("Error: the pid map lost track of its entries.\n");
+        exit(EXIT_FAILURE);
+    }
+    pm_free(&map);
+    free(present);
+    free(absent);
+}
+
+static void runList(int count) {
+    pid_t *present = shuffledPids(count, 0);
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+
+    List list;
+    ll_init(&list, sizeof(Entry), &samePid);
+    for (int i = 0; i < count; i++) {
+        entry.pid = present[i];
+        ll_add(&list, &entry);
+    }
+
+    int samples = LIST_BUDGET / count;
+    if (samples > LIST_SAMPLES) {
+        samples = LIST_SAMPLES;
+    }
+    if (samples < 1) {
+        samples = 1;
+    }
+
+    // spread over the list, so on average half of it is walked
+    unsigned long long start = nowNs();
+    for (int i = 0; i < samples; i++) {
+        entry.pid = present[(long) i * count / samples];
+        ll_add_unique(&list, &entry);
+    }
+    report("list", "add existing", samples, nowNs() - start);
+
+    // a new pid is checked against every entry, then found again at the tail
+    start = nowNs();
+    for (int i = 0; i < samples; i++) {
+        entry.pid = present[(long) i * count / samples] + 1;
+        ll_add_unique(&list, &entry);
+        ll_remove(&list, &entry);
+    }
+    report("list", "add+remove", samples, nowNs() - start);
+
+    ll_free(&list);
+    free(present);
+}
+
+int main(int args, char *argv[]) {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        printf("%d monitored processes\n", sizes[i]);
+        runMap(sizes[i]);
+        runList(sizes[i]);
+    }
+    return EXIT_SUCCESS;
+}
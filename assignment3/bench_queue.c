@@ -0,0 +1,238 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Hands events from a growing number of producer threads to one consumer
+// through MpscQueue, one at a time and in batches, against a ring behind a
+// mutex like the resolver's request queue. SpscQueue is timed on its own for
+// a single producer. The consumer checks every producer's events arrive in
+// the order they were pushed.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "queue.h"
+#include "memwatch.h"
+
+#define EVENTS (1 << 21)        // per run, split between the producers
+#define CAPACITY 4096
+#define BATCH 32
+#define MAX_PRODUCERS 64
+
+// shaped like a kill reported by a worker
+typedef struct _Event {
+    int producer;
+    unsigned int sequence;
+    int pid;
+    unsigned int runtime;
+    const char *program;
+    unsigned long long when;
+} Event;
+
+typedef enum _Kind {
+    MPSC,
+    MPSC_BATCH,
+    LOCKED,
+    SPSC,
+    SPSC_BATCH
+} Kind;
+
+static const char *kindNames[] = {"mpsc", "mpsc batch", "mutex", "spsc", "spsc batch"};
+
+static const int producerCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+// the baseline, a plain ring guarded by one lock
+typedef struct _LockedRing {
+    pthread_mutex_t lock;
+    Event events[CAPACITY];
+    size_t head;
+    size_t tail;
+} LockedRing;
+
+static MpscQueue mpsc;
+static SpscQueue spsc;
+static LockedRing locked = {PTHREAD_MUTEX_INITIALIZER, {{0}}, 0, 0};
+
+static Kind kind;
+static int producers;
+static int started = 0;
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static size_t lockedPush(const Event *events, size_t count) {
+    pthread_mutex_lock(&locked.lock);
+    size_t room = CAPACITY - (locked.head - locked.tail);
+    if (count > room) {
+        count = room;
+    }
+    for (size_t i = 0; i < count; i++) {
+        locked.events[(locked.head + i) % CAPACITY] = events[i];
+    }
+    locked.head += count;
+    pthread_mutex_unlock(&locked.lock);
+    return count;
+}
+
+static size_t lockedPop(Event *events, size_t max) {
+    pthread_mutex_lock(&locked.lock);
+    size_t count = locked.head - locked.tail;
+    if (count > max) {
+        count = max;
+    }
+    for (size_t i = 0; i < count; i++) {
+        events[i] = locked.events[(locked.tail + i) % CAPACITY];
+    }
+    locked.tail += count;
+    pthread_mutex_unlock(&locked.lock);
+    return count;
+}
+
+static size_t push(const Event *events, size_t count) {
+    switch (kind) {
+        case MPSC:
+            return mq_push(&mpsc, events) ? 1 : 0;
+        case MPSC_BATCH:
+            return mq_pushBatch(&mpsc, events, count);
+        case SPSC:
+            return sq_push(&spsc, events) ? 1 : 0;
+        case SPSC_BATCH:
+            return sq_pushBatch(&spsc, events, count);
+        default:
+            return lockedPush(events, 1);
+    }
+}
+
+static size_t pop(Event *events) {
+    switch (kind) {
+        case MPSC:
+            return mq_pop(&mpsc, events) ? 1 : 0;
+        case MPSC_BATCH:
+            return mq_popBatch(&mpsc, events, BATCH);
+        case SPSC:
+            return sq_pop(&spsc, events) ? 1 : 0;
+        case SPSC_BATCH:
+            return sq_popBatch(&spsc, events, BATCH);
+        default:
+            return lockedPop(events, 1);
+    }
+}
+
+static void *producerMain(void *argument) {
+    int producer = (int) (long) argument;
+    unsigned int count = EVENTS / producers;
+    Event events[BATCH];
+    memset(events, 0, sizeof(events));
+    for (int i = 0; i < BATCH; i++) {
+        events[i].producer = producer;
+        events[i].program = "test5";
+    }
+
+    while (__atomic_load_n(&started, __ATOMIC_ACQUIRE) == 0) {
+        sched_yield();
+    }
+
+    unsigned int sent = 0;
+    while (sent < count) {
+        size_t wanted = count - sent < BATCH ? count - sent : BATCH;
+        for (size_t i = 0; i < wanted; i++) {
+            events[i].sequence = sent + (unsigned int) i;
+            events[i].pid = (int) (sent + i);
+        }
+        size_t pushed = push(events, wanted);
+        if (pushed == 0) {
+            sched_yield();
+        }
+        // anything not taken is filled in again from sent next time round
+        sent += (unsigned int) pushed;
+    }
+    return argument;
+}
+
+static void run(Kind runKind, int runProducers) {
+    kind = runKind;
+    producers = runProducers;
+    __atomic_store_n(&started, 0, __ATOMIC_RELEASE);
+
+    pthread_t threads[MAX_PRODUCERS];
+    for (int i = 0; i < producers; i++) {
+        pthread_create(&threads[i], NULL, &producerMain, (void *) (long) i);
+    }
+
+    unsigned int expected[MAX_PRODUCERS];
+    memset(expected, 0, sizeof(expected));
+    unsigned long total = (unsigned long) (EVENTS / producers) * producers;
+    unsigned long received = 0;
+    unsigned long emptyPolls = 0;
+    bool ordered = true;
+    Event events[BATCH];
+
+    unsigned long long start = nowNs();
+    __atomic_store_n(&started, 1, __ATOMIC_RELEASE);
+    while (received < total) {
+        size_t count = pop(events);
+        if (count == 0) {
+            emptyPolls++;
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (events[i].sequence != expected[events[i].producer]++) {
+                ordered = false;
+            }
+        }
+        received += count;
+    }
+    unsigned long long elapsed = nowNs() - start;
+
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (ordered == false) {
+        printf("Error: %s delivered events out of order.\n", kindNames[kind]);
+        exit(EXIT_FAILURE);
+    }
+    printf("%-10s %3d producer(s) %8.1f ns/event %8.2f M events/s %10lu empty polls\n",
+           kindNames[kind], producers, (double) elapsed / received,
+           received * 1000.0 / elapsed, emptyPolls);
+}
+
+int main(int args, char *argv[]) {
+    if (mq_init(&mpsc, sizeof(Event), CAPACITY) == false || sq_init(&spsc, sizeof(Event), CAPACITY) == false) {
+        printf("Error: Could not allocate the queues.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sizeof(producerCounts) / sizeof(producerCounts[0]); i++) {
+        run(MPSC, producerCounts[i]);
+        run(MPSC_BATCH, producerCounts[i]);
+        run(LOCKED, producerCounts[i]);
+    }
+    run(SPSC, 1);
+    run(SPSC_BATCH, 1);
+
+    mq_free(&mpsc);
+    sq_free(&spsc);
+    return EXIT_SUCCESS;
+}
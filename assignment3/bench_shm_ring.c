@@ -0,0 +1,208 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the shared memory ring with loopback TCP for the traffic a local
+// procnanny.client sends: a stream of short log lines one way, and
+// request/acknowledgement round trips for the latency numbers.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "shm_ring.h"
+#include "memwatch.h"
+
+#define MESSAGES 1000000
+#define MESSAGE_SIZE 64
+#define PINGS 100000
+
+typedef struct _Transport {
+    const char *name;
+    // the parent uses the first end, the forked child the second
+    int sockets[2];
+    ShmRing rings[2];       // rings[0] parent -> child, rings[1] child -> parent
+    bool useRings;
+} Transport;
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool tcpPair(int sockets[2]) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *) &address, length) < 0 || listen(listener, 1) < 0
+        || getsockname(listener, (struct sockaddr *) &address, &length) < 0) {
+        return false;
+    }
+    sockets[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sockets[0], (struct sockaddr *) &address, length) < 0) {
+        return false;
+    }
+    sockets[1] = accept(listener, NULL, NULL);
+    close(listener);
+
+    // as the client does, each line is its own send
+    int one = 1;
+    setsockopt(sockets[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(sockets[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sockets[1] >= 0;
+}
+
+static void sendMessage(Transport *transport, int end, const char *data, size_t length) {
+    if (transport->useRings) {
+        sr_writeAll(&transport->rings[end], data, length);
+    }
+    else {
+        write(transport->sockets[end], data, length);
+    }
+}
+
+// blocks until something arrives, the way the server and client wait in select
+static size_t receive(Transport *transport, int end, char *buffer, size_t capacity) {
+    if (transport->useRings) {
+        ShmRing *ring = &transport->rings[1 - end];
+        size_t received;
+        while ((received = sr_read(ring, buffer, capacity)) == 0) {
+            struct pollfd wait = {sr_notifyFd(ring), POLLIN, 0};
+            poll(&wait, 1, -1);
+        }
+        return received;
+    }
+    ssize_t received = read(transport->sockets[end], buffer, capacity);
+    return received > 0 ? (size_t) received : 0;
+}
+
+static void receiveExactly(Transport *transport, int end, char *buffer, size_t length) {
+    size_t got = 0;
+    while (got < length) {
+        got += receive(transport, end, buffer + got, length - got);
+    }
+}
+
+static int compareLatency(const void *first, const void *second) {
+    unsigned long long a = *(const unsigned long long *) first;
+    unsigned long long b = *(const unsigned long long *) second;
+    return a < b ? -1 : a > b;
+}
+
+static void runThroughput(Transport *transport) {
+    char message[MESSAGE_SIZE];
+    memset(message, 'x', sizeof(message));
+    message[MESSAGE_SIZE - 1] = '\n';
+
+    pid_t child = fork();
+    if (child == 0) {
+        static char buffer[1 << 16];
+        size_t total = 0;
+        while (total < (size_t) MESSAGES * MESSAGE_SIZE) {
+            total += receive(transport, 1, buffer, sizeof(buffer));
+        }
+        sendMessage(transport, 1, "k", 1);
+        _exit(EXIT_SUCCESS);
+    }
+
+    unsigned long long start = nowNs();
+    for (int i = 0; i < MESSAGES; i++) {
+        sendMessage(transport, 0, message, sizeof(message));
+    }
+    char done;
+    receiveExactly(transport, 0, &done, 1);
+    unsigned long long elapsed = nowNs() - start;
+    waitpid(child, NULL, 0);
+
+    printf("%-14s throughput  %10.0f msg/s  %8.1f MB/s\n", transport->name,
+           MESSAGES / (elapsed / 1e9), (double) MESSAGES * MESSAGE_SIZE / (elapsed / 1e9) / 1e6);
+}
+
+static void runLatency(Transport *transport) {
+    char message[MESSAGE_SIZE];
+    memset(message, 'p', sizeof(message));
+
+    pid_t child = fork();
+    if (child == 0) {
+        char buffer[MESSAGE_SIZE];
+        for (int i = 0; i < PINGS; i++) {
+            receiveExactly(transport, 1, buffer, sizeof(buffer));
+            sendMessage(transport, 1, buffer, sizeof(buffer));
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    unsigned long long *latencies = malloc(sizeof(unsigned long long) * PINGS);
+    char buffer[MESSAGE_SIZE];
+    for (int i = 0; i < PINGS; i++) {
+        unsigned long long start = nowNs();
+        sendMessage(transport, 0, message, sizeof(message));
+        receiveExactly(transport, 0, buffer, sizeof(buffer));
+        latencies[i] = nowNs() - start;
+    }
+    waitpid(child, NULL, 0);
+
+    qsort(latencies, PINGS, sizeof(unsigned long long), &compareLatency);
+    printf("%-14s round trip  p50 %6.1f us  p99 %6.1f us  p99.9 %6.1f us\n", transport->name,
+           latencies[PINGS / 2] / 1e3, latencies[PINGS * 99 / 100] / 1e3, latencies[PINGS * 999 / 1000] / 1e3);
+    free(latencies);
+}
+
+int main(int args, char *argv[]) {
+    Transport tcp;
+    memset(&tcp, 0, sizeof(tcp));
+    tcp.name = "loopback tcp";
+    if (tcpPair(tcp.sockets) == false) {
+        printf("Error: could not open a loopback connection.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // created before forking, so both processes share the mappings
+    Transport ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.name = "shm ring";
+    ring.useRings = true;
+    if (sr_create(&ring.rings[0], SHM_RING_SIZE) == false || sr_create(&ring.rings[1], SHM_RING_SIZE) == false) {
+        printf("Error: could not create the shared memory rings.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%d messages of %d bytes, %d round trips\n", MESSAGES, MESSAGE_SIZE, PINGS);
+    runThroughput(&tcp);
+    runThroughput(&ring);
+    runLatency(&tcp);
+    runLatency(&ring);
+
+    close(tcp.sockets[0]);
+    close(tcp.sockets[1]);
+    sr_close(&ring.rings[0]);
+    sr_close(&ring.rings[1]);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress.h"
+#include "memwatch.h"
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+#define NIBBLE_MAX 15
+
+// what procnanny.client sends most, the node name is already a one byte
+// marker. Later phrases are found first when hashes collide, so the most
+// common ones go last.
+static const char dictionary[] =
+    "Mon Tue Wed Thu Fri Sat Sun Jan Feb Mar Apr May Jun Jul Aug Sep Oct Nov Dec UTC 20"
+    "] Warning: ] Error: ] Action: "
+    "___ACK___ ___MONITORING___ 0\n___MONITORING___ 1\n"
+    "] Info: Runtime of '' set to 5 seconds on \x01.\n"
+    "___KILLED___ 1 0 5 a.out\n"
+    "] Info: No 'a.out' processes found on \x01\n"
+    "] Info: Initializing monitoring of process 'a.out' (PID 1) on node \x01.\n";
+#define DICTIONARY_LENGTH (sizeof(dictionary) - 1)
+
+// Block layout, repeated until the input ends:
+//   token       high nibble literal count, low nibble match length - MIN_MATCH
+//   [255...]    extra length bytes when a nibble is 15
+//   literals
+//   offset      2 bytes little endian, absent after the final literals
+//   [255...]    extra match length bytes
+
+static uint32_t read32(const char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static unsigned int hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// returns the new output position, or 0 if out is full
+static size_t writeExtraLength(char *out, size_t op, size_t capacity, size_t length) {
+    while (length >= 255) {
+        if (op >= capacity) {
+            return 0;
+        }
+        out[op++] = (char) 255;
+        length -= 255;
+    }
+    if (op >= capacity) {
+        return 0;
+    }
+    out[op++] = (char) length;
+    return op;
+}
+
+static size_t emitSequence(char *out, size_t op, size_t capacity, const char *literals, size_t literalLength,
+                           size_t offset, size_t matchLength, int isLast) {
+    if (op >= capacity) {
+        return 0;
+    }
+    size_t tokenPos = op++;
+    unsigned char token = (unsigned char) ((literalLength < NIBBLE_MAX ? literalLength : NIBBLE_MAX) << 4);
+    if (literalLength >= NIBBLE_MAX && (op = writeExtraLength(out, op, capacity, literalLength - NIBBLE_MAX)) == 0) {
+        return 0;
+    }
+    if (op + literalLength > capacity) {
+        return 0;
+    }
+    memcpy(out + op, literals, literalLength);
+    op += literalLength;
+
+    if (isLast == 0) {
+        size_t extra = matchLength - MIN_MATCH;
+        token |= (unsigned char) (extra < NIBBLE_MAX ? extra : NIBBLE_MAX);
+        if (op + 2 > capacity) {
+            return 0;
+        }
+        out[op++] = (char) (offset & 0xFF);
+        out[op++] = (char) (offset >> 8);
+        if (extra >= NIBBLE_MAX && (op = writeExtraLength(out, op, capacity, extra - NIBBLE_MAX)) == 0) {
+            return 0;
+        }
+    }
+    out[tokenPos] = (char) token;
+    return op;
+}
+
+// compresses base[start, end), matches may reach back into base[0, start)
+static size_t lz_compressWithHistory(const char *base, size_t start, size_t end, char *out, size_t capacity) {
+    int32_t table[1 << HASH_BITS];
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+        table[i] = -1;
+    }
+    for (size_t i = 0; i + MIN_MATCH <= start; i++) {
+        table[hash32(read32(base + i))] = (int32_t) i;
+    }
+
+    size_t ip = start;
+    size_t anchor = start;
+    size_t op = 0;
+    while (ip + MIN_MATCH <= end) {
+        uint32_t sequence = read32(base + ip);
+        unsigned int h = hash32(sequence);
+        int32_t ref = table[h];
+        table[h] = (int32_t) ip;
+
+        if (ref >= 0 && ip - ref <= MAX_OFFSET && read32(base + ref) == sequence) {
+            size_t matchLength = MIN_MATCH;
+            while (ip + matchLength < end && base[ref + matchLength] == base[ip + matchLength]) {
+                matchLength++;
+            }
+            op = emitSequence(out, op, capacity, base + anchor, ip - anchor, ip - ref, matchLength, 0);
+            if (op == 0) {
+                return 0;
+            }
+            ip += matchLength;
+            anchor = ip;
+        }
+        else {
+            ip++;
+        }
+    }
+
+    return emitSequence(out, op, capacity, base + anchor, end - anchor, 0, 0, 1);
+}
+
+// decompresses into out[start, capacity), matches may reach back into out[0, start)
+static ssize_t lz_decompressWithHistory(const char *in, size_t length, char *out, size_t start, size_t capacity) {
+    const unsigned char *ip = (const unsigned char *) in;
+    const unsigned char *inEnd = ip + length;
+    size_t op = start;
+
+    while (ip < inEnd) {
+        unsigned int token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == NIBBLE_MAX) {
+            unsigned char extra;
+            do {
+                if (ip >= inEnd) {
+                    return -1;
+                }
+                extra = *ip++;
+                literalLength += extra;
+            } while (extra == 255);
+        }
+        if (literalLength > (size_t) (inEnd - ip) || op + literalLength > capacity) {
+            return -1;
+        }
+        memcpy(out + op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == inEnd) {
+            break;
+        }
+
+        if (inEnd - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t matchLength = (token & NIBBLE_MAX);
+        if (matchLength == NIBBLE_MAX) {
+            unsigned char extra;
+            do {
+                if (ip >= inEnd) {
+                    return -1;
+                }
+                extra = *ip++;
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += MIN_MATCH;
+
+        if (offset == 0 || offset > op || op + matchLength > capacity) {
+            return -1;
+        }
+        // byte at a time, the match may overlap what it is producing
+        for (size_t i = 0; i < matchLength; i++) {
+            out[op + i] = out[op - offset + i];
+        }
+        op += matchLength;
+    }
+
+    return (ssize_t) (op - start);
+}
+
+size_t lz_compressBound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+size_t lz_compress(const char *in, size_t length, char *out, size_t capacity) {
+    return lz_compressWithHistory(in, 0, length, out, capacity);
+}
+
+ssize_t lz_decompress(const char *in, size_t length, char *out, size_t capacity) {
+    return lz_decompressWithHistory(in, length, out, 0, capacity);
+}
+
+size_t lz_compressWithDictionary(const char *in, size_t length, char *out, size_t capacity) {
+    char *base = malloc(DICTIONARY_LENGTH + length);
+    if (base == NULL) {
+        return 0;
+    }
+    memcpy(base, dictionary, DICTIONARY_LENGTH);
+    memcpy(base + DICTIONARY_LENGTH, in, length);
+    size_t compressedLength = lz_compressWithHistory(base, DICTIONARY_LENGTH, DICTIONARY_LENGTH + length,
+                                                     out, capacity);
+    free(base);
+    return compressedLength;
+}
+
+ssize_t lz_decompressWithDictionary(const char *in, size_t length, char *out, size_t capacity) {
+    char *base = malloc(DICTIONARY_LENGTH + capacity);
+    if (base == NULL) {
+        return -1;
+    }
+    memcpy(base, dictionary, DICTIONARY_LENGTH);
+    ssize_t rawLength = lz_decompressWithHistory(in, length, base, DICTIONARY_LENGTH, DICTIONARY_LENGTH + capacity);
+    if (rawLength > 0) {
+        memcpy(out, base + DICTIONARY_LENGTH, (size_t) rawLength);
+    }
+    free(base);
+    return rawLength;
+}
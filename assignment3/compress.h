@@ -0,0 +1,45 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// A small LZ77 block codec in the spirit of LZ4: sequences of literals
+// followed by a 16 bit back reference. Fast enough to run on the network
+// thread for every batch.
+
+// worst case size of compressing length bytes
+size_t  lz_compressBound(size_t length);
+
+// returns the compressed size, or 0 if out is too small
+size_t  lz_compress(const char *in, size_t length, char *out, size_t capacity);
+
+// returns the decompressed size, or -1 if the input is corrupt or out is too small
+ssize_t lz_decompress(const char *in, size_t length, char *out, size_t capacity);
+
+// The same codec primed with a built-in dictionary of the phrases clients
+// log, so even a batch of a few records has something to match against.
+// Both ends must use the same dictionary, change the version with it.
+#define LZ_DICTIONARY_VERSION 1
+
+size_t  lz_compressWithDictionary(const char *in, size_t length, char *out, size_t capacity);
+
+ssize_t lz_decompressWithDictionary(const char *in, size_t length, char *out, size_t capacity);
+
+#endif //COMPRESS_H
@@ -0,0 +1,108 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// A binary form of the log. Every record is a fixed 24 byte EventRecord,
+// followed by length bytes of text for the few kinds that carry any. Program
+// and node names are interned: a DEFINE record names an id once and events
+// refer to it. Each time a log file is opened it starts with a preamble, a
+// CLOCK record tying the monotonic record times to the wall clock followed by
+// every name defined so far, so rotated files decode on their own.
+// procnanny.logcat turns records back into the usual text lines.
+
+#define EL_MAGIC "PNEVT001"
+#define EL_MAX_NAMES 4096           // per process, program and node names together
+#define EL_NAME_LENGTH 256
+#define EL_MAX_TEXT 4096            // longest text a record carries
+#define EL_NO_NAME 0
+
+typedef enum _EventType {
+    EL_CLOCK = 1,       // text is EL_MAGIC and the CLOCK_REALTIME ns matching time
+    EL_PROGRAM,         // defines program id as the text
+    EL_NODE,            // defines node id as the text
+    EL_MESSAGE,         // text is "<type>: <message>"
+    EL_LINE,            // text is a whole line already formatted elsewhere
+    EL_MONITOR,         // monitoring of pid started
+    EL_KILL,            // pid killed after value seconds, 0 when on request
+    EL_NOT_FOUND,       // no processes of program found
+    EL_TYPES
+} EventType;
+
+typedef struct _EventRecord {
+    int64_t time;       // CLOCK_MONOTONIC ns
+    int32_t pid;
+    uint32_t value;
+    uint16_t program;
+    uint16_t node;      // EL_NO_NAME for this host
+    uint16_t length;    // of the text that follows
+    uint8_t type;
+    uint8_t reserved;
+} EventRecord;
+
+typedef struct _EventReader {
+    char *names[EL_MAX_NAMES];
+    bool clocked;
+    int64_t clockMonotonic;
+    int64_t clockRealtime;
+} EventReader;
+
+// PROCNANNYLOGFORMAT=binary
+bool    el_requested();
+
+void    el_enable();
+
+bool    el_enabled();
+
+// writes the CLOCK record and every defined name to fd, for log writers to
+// call whenever they open the log
+void    el_writePreamble(int fd);
+
+// each of these fills buffer, which must hold LOG_MESSAGE_LENGTH plus two
+// names, with the records for one log line and returns their length.
+// when is the wall clock time of the event, 0 for now.
+size_t  el_event(char *buffer, size_t size, EventType type, time_t when, int pid, const char *program,
+                 const char *node, unsigned int value);
+size_t  el_message(char *buffer, size_t size, const char *type, const char *msg);
+
+// where the "<type>: <message>" text of a message record in buffer goes, so
+// it can be written in place and the record finished with el_finishMessage
+char*   el_messageText(char *buffer);
+size_t  el_finishMessage(char *buffer, size_t size, size_t length);
+size_t  el_line(char *buffer, size_t size, const char *line, size_t length);
+
+// the message text of an event, as it would be logged under el_typeName
+size_t  el_describe(EventType type, int pid, const char *program, const char *node, unsigned int value,
+                    char *out, size_t size);
+
+const char *el_typeName(EventType type);
+
+void    el_readerInit(EventReader *reader);
+
+void    el_readerFree(EventReader *reader);
+
+// renders one record as its text line into out, returns the length, 0 for
+// records that only update the reader
+size_t  el_render(EventReader *reader, const EventRecord *record, const char *text, char *out, size_t size);
+
+#endif //EVENT_LOG_H
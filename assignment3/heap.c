@@ -0,0 +1,188 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "heap.h"
+#include "memwatch.h"
+
+static int *positionOf(Heap *heap, void *item) {
+    return (int *) ((char *) item + heap->indexOffset);
+}
+
+static void place(Heap *heap, int position, HeapEntry entry) {
+    heap->entries[position] = entry;
+    *positionOf(heap, entry.item) = position;
+}
+
+static void siftUp(Heap *heap, int position) {
+    HeapEntry entry = heap->entries[position];
+    while (position > 0) {
+        int parent = (position - 1) / heap->arity;
+        if (heap->entries[parent].key <= entry.key) {
+            break;
+        }
+        place(heap, position, heap->entries[parent]);
+        position = parent;
+    }
+    place(heap, position, entry);
+}
+
+static void siftDown(Heap *heap, int position) {
+    HeapEntry entry = heap->entries[position];
+    while (true) {
+        int first = position * heap->arity + 1;
+        if (first >= heap->length) {
+            break;
+        }
+        int last = first + heap->arity < heap->length ? first + heap->arity : heap->length;
+        int smallest = first;
+        for (int child = first + 1; child < last; child++) {
+            if (heap->entries[child].key < heap->entries[smallest].key) {
+                smallest = child;
+            }
+        }
+        if (heap->entries[smallest].key >= entry.key) {
+            break;
+        }
+        place(heap, position, heap->entries[smallest]);
+        position = smallest;
+    }
+    place(heap, position, entry);
+}
+
+static void reserve(Heap *heap, int needed) {
+    if (needed <= heap->capacity) {
+        return;
+    }
+    int capacity = heap->capacity > 0 ? heap->capacity : HP_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    HeapEntry *entries = malloc(sizeof(HeapEntry) * (size_t) capacity);
+    if (heap->entries != NULL) {
+        memcpy(entries, heap->entries, sizeof(HeapEntry) * (size_t) heap->length);
+        free(heap->entries);
+    }
+    heap->entries = entries;
+    heap->capacity = capacity;
+}
+
+void hp_init(Heap *heap, int arity, size_t indexOffset) {
+    heap->length = 0;
+    heap->capacity = 0;
+    heap->arity = arity < 2 ? 2 : arity;
+    heap->indexOffset = indexOffset;
+    heap->entries = NULL;
+}
+
+void hp_free(Heap *heap) {
+    for (int i = 0; i < heap->length; i++) {
+        *positionOf(heap, heap->entries[i].item) = HP_NOT_QUEUED;
+    }
+    if (heap->entries != NULL) {
+        free(heap->entries);
+        heap->entries = NULL;
+    }
+    heap->length = 0;
+    heap->capacity = 0;
+}
+
+void hp_push(Heap *heap, void *item, long long key) {
+    reserve(heap, heap->length + 1);
+    heap->entries[heap->length].key = key;
+    heap->entries[heap->length].item = item;
+    heap->length++;
+    siftUp(heap, heap->length - 1);
+}
+
+void hp_heapify(Heap *heap, void **items, const long long *keys, int count) {
+    for (int i = 0; i < heap->length; i++) {
+        *positionOf(heap, heap->entries[i].item) = HP_NOT_QUEUED;
+    }
+    heap->length = 0;
+    reserve(heap, count);
+    for (int i = 0; i < count; i++) {
+        HeapEntry entry = {keys[i], items[i]};
+        place(heap, i, entry);
+    }
+    heap->length = count;
+    // every entry past the last parent is already a heap of one
+    if (count > 1) {
+        for (int i = (count - 2) / heap->arity; i >= 0; i--) {
+            siftDown(heap, i);
+        }
+    }
+}
+
+void *hp_top(Heap *heap) {
+    return heap->length > 0 ? heap->entries[0].item : NULL;
+}
+
+long long hp_topKey(Heap *heap) {
+    return heap->entries[0].key;
+}
+
+void *hp_pop(Heap *heap) {
+    void *top = hp_top(heap);
+    if (top != NULL) {
+        hp_remove(heap, top);
+    }
+    return top;
+}
+
+void hp_update(Heap *heap, void *item, long long key) {
+    int position = *positionOf(heap, item);
+    long long old = heap->entries[position].key;
+    heap->entries[position].key = key;
+    if (key < old) {
+        siftUp(heap, position);
+    }
+    else {
+        siftDown(heap, position);
+    }
+}
+
+void hp_remove(Heap *heap, void *item) {
+    int position = *positionOf(heap, item);
+    if (position == HP_NOT_QUEUED) {
+        return;
+    }
+    *positionOf(heap, item) = HP_NOT_QUEUED;
+    heap->length--;
+    if (position == heap->length) {
+        return;
+    }
+    // the last entry fills the gap and may belong above or below it
+    long long removed = heap->entries[position].key;
+    place(heap, position, heap->entries[heap->length]);
+    if (heap->entries[position].key < removed) {
+        siftUp(heap, position);
+    }
+    else {
+        siftDown(heap, position);
+    }
+}
+
+bool hp_contains(Heap *heap, void *item) {
+    int position = *positionOf(heap, item);
+    return position >= 0 && position < heap->length && heap->entries[position].item == item;
+}
+
+int hp_size(Heap *heap) {
+    return heap->length;
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A d-ary min heap of items the caller owns, ordered by a key kept beside
+// each item pointer so sifting never touches the items. Every item holds an
+// int the heap keeps set to its position, found through the offset given to
+// hp_init, so an item can be re-keyed or removed in O(log n) without a
+// search.
+
+#define HP_INITIAL_CAPACITY 16
+// the position of an item on no heap, items must start out with it
+#define HP_NOT_QUEUED -1
+
+typedef struct _HeapEntry {
+    long long key;
+    void *item;
+} HeapEntry;
+
+typedef struct _Heap {
+    int length;
+    int capacity;
+    int arity;              // children per entry, 2 or more
+    size_t indexOffset;     // of the item's int position
+    HeapEntry *entries;
+} Heap;
+
+// indexOffset is offsetof the int position field in the items
+void    hp_init(Heap *heap, int arity, size_t indexOffset);
+
+// leaves every item that was on the heap at HP_NOT_QUEUED
+void    hp_free(Heap *heap);
+
+// item must not be on the heap already
+void    hp_push(Heap *heap, void *item, long long key);
+
+// replaces whatever the heap held with count items at once, in O(count)
+void    hp_heapify(Heap *heap, void **items, const long long *keys, int count);
+
+// the item with the smallest key, NULL when empty
+void*   hp_top(Heap *heap);
+
+// the smallest key, only meaningful when the heap is not empty
+long long hp_topKey(Heap *heap);
+
+// removes and returns the top item, NULL when empty
+void*   hp_pop(Heap *heap);
+
+// moves an item on the heap to its new key, up or down
+void    hp_update(Heap *heap, void *item, long long key);
+
+// does nothing if the item is on no heap
+void    hp_remove(Heap *heap, void *item);
+
+bool    hp_contains(Heap *heap, void *item);
+
+int     hp_size(Heap *heap);
+
+#endif //HEAP_H
@@ -0,0 +1,73 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "intrusive_list.h"
+
+static void insertBetween(Link *link, Link *prev, Link *next) {
+    link->prev = prev;
+    link->next = next;
+    prev->next = link;
+    next->prev = link;
+}
+
+void il_init(Link *list) {
+    list->prev = list->next = list;
+}
+
+bool il_isEmpty(Link *list) {
+    return list->next == list;
+}
+
+bool il_isLinked(Link *link) {
+    return link->next != link;
+}
+
+void il_pushFront(Link *list, Link *link) {
+    insertBetween(link, list, list->next);
+}
+
+void il_pushBack(Link *list, Link *link) {
+    insertBetween(link, list->prev, list);
+}
+
+void il_remove(Link *link) {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    il_init(link);
+}
+
+void il_moveBack(Link *list, Link *link) {
+    il_remove(link);
+    il_pushBack(list, link);
+}
+
+Link* il_popFront(Link *list) {
+    if (il_isEmpty(list)) {
+        return NULL;
+    }
+    Link *link = list->next;
+    il_remove(link);
+    return link;
+}
+
+int il_size(Link *list) {
+    int size = 0;
+    for (Link *link = list->next; link != list; link = link->next) {
+        size++;
+    }
+    return size;
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kill_stats.h"
+#include "memwatch.h"
+
+// open addressing with linear probing, the table only ever grows
+static KillCounter **slots = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+static unsigned long long totalKills = 0;
+
+static size_t hashKey(const char *node, const char *program) {
+    // FNV-1a over both strings
+    size_t hash = 2166136261u;
+    for (const char *c = node; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+    hash = (hash ^ 0xFF) * 16777619u;
+    for (const char *c = program; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t findSlot(KillCounter **table, size_t size, const char *node, const char *program) {
+    size_t index = hashKey(node, program) & (size - 1);
+    while (table[index] != NULL) {
+        if (strcmp(table[index]->node, node) == 0 && strcmp(table[index]->program, program) == 0) {
+            break;
+        }
+        index = (index + 1) & (size - 1);
+    }
+    return index;
+}
+
+static void grow() {
+    size_t newCapacity = capacity == 0 ? KILL_STATS_INITIAL_SLOTS : capacity * 2;
+    KillCounter **table = calloc(newCapacity, sizeof(KillCounter *));
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL) {
+            table[findSlot(table, newCapacity, slots[i]->node, slots[i]->program)] = slots[i];
+        }
+    }
+    if (slots != NULL) {
+        free(slots);
+    }
+    slots = table;
+    capacity = newCapacity;
+}
+
+void ks_init() {
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    totalKills = 0;
+    grow();
+}
+
+void ks_free() {
+    // memwatch warns about freeing NULL, so only the slots in use
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL) {
+            free(slots[i]);
+        }
+    }
+    free(slots);
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+}
+
+void ks_recordKill(const char *node, const char *program, time_t when) {
+    if ((count + 1) * 10 > capacity * 7) {
+        grow();
+    }
+
+    size_t index = findSlot(slots, capacity, node, program);
+    KillCounter *counter = slots[index];
+    if (counter == NULL) {
+        counter = calloc(1, sizeof(KillCounter));
+        snprintf(counter->node, NODE_NAME_LENGTH, "%s", node);
+        snprintf(counter->program, KILL_STATS_PROGRAM_LENGTH, "%s", program);
+        slots[index] = counter;
+        count++;
+    }
+
+    // kept in range for times before the epoch too
+    time_t minute = when / 60;
+    int bucket = (int) (((minute % KILL_STATS_MINUTES) + KILL_STATS_MINUTES) % KILL_STATS_MINUTES);
+    if (counter->minute[bucket] != minute) {
+        counter->minute[bucket] = minute;
+        counter->perMinute[bucket] = 0;
+    }
+    counter->perMinute[bucket]++;
+    counter->total++;
+    counter->lastKill = when;
+    totalKills++;
+}
+
+const KillCounter *ks_get(const char *node, const char *program) {
+    if (capacity == 0) {
+        return NULL;
+    }
+    return slots[findSlot(slots, capacity, node, program)];
+}
+
+void ks_forEach(KillCounterOperation operation, void *context) {
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL) {
+            operation(slots[i], context);
+        }
+    }
+}
+
+unsigned int ks_killsSince(const KillCounter *counter, time_t now, int minutes) {
+    if (minutes > KILL_STATS_MINUTES) {
+        minutes = KILL_STATS_MINUTES;
+    }
+    time_t currentMinute = now / 60;
+    unsigned int kills = 0;
+    for (int i = 0; i < KILL_STATS_MINUTES; i++) {
+        if (counter->minute[i] > currentMinute - minutes && counter->minute[i] <= currentMinute) {
+            kills += counter->perMinute[i];
+        }
+    }
+    return kills;
+}
+
+unsigned long long ks_total() {
+    return totalKills;
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KILL_STATS_H
+#define KILL_STATS_H
+
+#include <time.h>
+#include "protocol.h"
+
+#define KILL_STATS_PROGRAM_LENGTH 128
+#define KILL_STATS_MINUTES 60      // how far back per minute rates go
+#define KILL_STATS_INITIAL_SLOTS 64
+
+typedef struct _KillCounter {
+    char node[NODE_NAME_LENGTH];
+    char program[KILL_STATS_PROGRAM_LENGTH];
+    unsigned long long total;
+    time_t lastKill;
+    // kills per minute, slot minute % KILL_STATS_MINUTES holds minute
+    unsigned int perMinute[KILL_STATS_MINUTES];
+    time_t minute[KILL_STATS_MINUTES];
+} KillCounter;
+
+typedef void (*KillCounterOperation)(const KillCounter *counter, void *context);
+
+void                ks_init();
+
+void                ks_free();
+
+void                ks_recordKill(const char *node, const char *program, time_t when);
+
+// NULL when nothing has been killed for that node and program
+const KillCounter*  ks_get(const char *node, const char *program);
+
+void                ks_forEach(KillCounterOperation operation, void *context);
+
+// kills in the last minutes minutes, at most KILL_STATS_MINUTES
+unsigned int        ks_killsSince(const KillCounter *counter, time_t now, int minutes);
+
+unsigned long long  ks_total();
+
+#endif //KILL_STATS_H
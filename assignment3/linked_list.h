@@ -18,26 +18,47 @@
 #define LINKED_LIST_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef void (*NodeOperation)(void *);
 
+// for callbacks that need more than the item, context is passed through
+typedef void (*ContextOperation)(void *item, void *context);
+
 // returns true if the predicate is fulfilled
 typedef bool (*Predicate)(void *);
 
 // returns true if the two items are equal in value
 typedef bool (*Comparator)(void *, void *);
 
+// a list's first slab holds this many nodes, each new one twice as many as
+// the last up to LL_SLAB_MAX_NODES
+#define LL_SLAB_MIN_NODES 8
+#define LL_SLAB_MAX_NODES 1024
+
+// the item is stored inline, right after the link
 typedef struct _Node {
-    void *data;
     struct _Node *next;
+    char data[];
 } Node;
 
+// nodes are carved from slabs owned by the list and reused once removed,
+// the slabs are only released by ll_free
+typedef struct _Slab {
+    struct _Slab *next;
+    char nodes[];
+} Slab;
+
 typedef struct _List {
     int length;
     size_t nodeSize;
+    size_t nodeStride;      // a Node and its item, padded to keep items aligned
     Node *head;
     Node *tail;
     Comparator comparator;
+    Node *freeNodes;
+    Slab *slabs;
+    int slabNodes;          // nodes in the next slab
 } List;
 
 void    ll_init(List *list, size_t nodeSize, Comparator comparator);
@@ -46,6 +67,9 @@ void    ll_free(List *list);
 
 void    ll_add(List *list, void *data);
 
+// appends a zeroed item and returns it, so it can be filled in place
+void*   ll_emplace(List *list);
+
 // if no comparator is supplied in ll_init, an ll_add will be performed
 void    ll_add_unique(List *list, void *data);
 
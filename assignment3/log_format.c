@@ -0,0 +1,111 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include "log_format.h"
+#include "memwatch.h"
+
+#define TYPE_LENGTH 32
+#define PREFIX_LENGTH (LF_TIMESTAMP_LENGTH + TYPE_LENGTH + 8)
+
+typedef struct _CachedPrefix {
+    char type[TYPE_LENGTH];
+    char prefix[PREFIX_LENGTH];
+    size_t length;
+    time_t second;              // of the timestamp inside prefix
+} CachedPrefix;
+
+// per thread, so the log writer, helper threads and the main loop never share
+static __thread time_t cachedSecond = -1;
+static __thread char cachedTimestamp[LF_TIMESTAMP_LENGTH];
+static __thread size_t cachedTimestampLength = 0;
+static __thread CachedPrefix prefixes[LF_PREFIX_SLOTS];
+static __thread int nextSlot = 0;
+
+size_t lf_timestamp(time_t when, char *buffer) {
+    if (when != cachedSecond) {
+        struct tm timeInfo;
+        localtime_r(&when, &timeInfo);
+        cachedTimestampLength = strftime(cachedTimestamp, LF_TIMESTAMP_LENGTH, "%a %b %d %H:%M:%S %Z %Y",
+                                         &timeInfo);
+        cachedSecond = when;
+    }
+    memcpy(buffer, cachedTimestamp, cachedTimestampLength + 1);
+    return cachedTimestampLength;
+}
+
+size_t lf_prefix(const char *type, char *buffer, size_t size) {
+    time_t now = time(NULL);
+    size_t typeLength = strlen(type);
+    if (typeLength >= TYPE_LENGTH) {
+        // too long to cache, only the timestamp is reused
+        char timestamp[LF_TIMESTAMP_LENGTH];
+        lf_timestamp(now, timestamp);
+        int length = snprintf(buffer, size, "[%s] %s: ", timestamp, type);
+        return (size_t) length < size ? (size_t) length : size - 1;
+    }
+
+    CachedPrefix *slot = NULL;
+    for (int i = 0; i < LF_PREFIX_SLOTS && slot == NULL; i++) {
+        if (prefixes[i].length != 0 && strcmp(prefixes[i].type, type) == 0) {
+            slot = &prefixes[i];
+        }
+    }
+    if (slot == NULL) {
+        // types are a handful of literals, so round robin is enough
+        slot = &prefixes[nextSlot];
+        nextSlot = (nextSlot + 1) % LF_PREFIX_SLOTS;
+        memcpy(slot->type, type, typeLength + 1);
+        slot->second = -1;
+    }
+
+    if (slot->second != now) {
+        char timestamp[LF_TIMESTAMP_LENGTH];
+        size_t timestampLength = lf_timestamp(now, timestamp);
+        char *end = slot->prefix;
+        *end++ = '[';
+        memcpy(end, timestamp, timestampLength);
+        end += timestampLength;
+        memcpy(end, "] ", 2);
+        end += 2;
+        memcpy(end, type, typeLength);
+        end += typeLength;
+        memcpy(end, ": ", 3);
+        slot->length = (size_t) (end + 2 - slot->prefix);
+        slot->second = now;
+    }
+
+    size_t length = slot->length < size ? slot->length : size - 1;
+    memcpy(buffer, slot->prefix, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+size_t lf_format(const char *type, const char *msg, char *buffer, size_t size) {
+    size_t used = lf_prefix(type, buffer, size - 1);
+    size_t msgLength = strlen(msg);
+    if (msgLength > size - 2 - used) {
+        msgLength = size - 2 - used;
+    }
+    memcpy(buffer + used, msg, msgLength);
+    used += msgLength;
+    buffer[used++] = '\n';
+    buffer[used] = '\0';
+    return used;
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LOG_LEVEL_H
+#define LOG_LEVEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Levels and per module filters for log messages. A message is only
+// formatted once it has passed both the build's ceiling, PROCNANNY_LOG_LEVEL,
+// and its module's level at runtime. Levels above the ceiling compile to
+// nothing, their arguments are never evaluated, and the rest cost a single
+// branch when filtered out.
+
+typedef enum _LogLevel {
+    LV_ERROR = 1,
+    LV_WARNING,
+    LV_ACTION,
+    LV_INFO,
+    LV_DEBUG
+} LogLevel;
+
+typedef enum _LogModule {
+    LM_GENERAL,         // start up, signals and shutdown
+    LM_CONFIG,          // configuration files and rules
+    LM_CLIENTS,         // connections, protocol and relays
+    LM_MONITOR,         // processes being watched and killed
+    LM_STATS,           // periodic and exit summaries
+    LM_COUNT
+} LogModule;
+
+// the most detailed level built in, set with make LOG_LEVEL=LV_WARNING
+#ifndef PROCNANNY_LOG_LEVEL
+#define PROCNANNY_LOG_LEVEL LV_INFO
+#endif
+
+#define LV_DEFAULT_LEVEL LV_INFO
+
+extern unsigned char lv_levels[LM_COUNT];
+
+#define LOG_ENABLED(level, module) ((level) <= PROCNANNY_LOG_LEVEL && (level) <= lv_levels[module])
+
+// echo also prints the message to stdout
+#define LOG_AT(level, module, echo, ...) \
+    do { \
+        if (LOG_ENABLED(level, module)) { \
+            logFormatted(level, echo, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(module, echo, ...)    LOG_AT(LV_ERROR, module, echo, __VA_ARGS__)
+#define LOG_WARNING(module, echo, ...)  LOG_AT(LV_WARNING, module, echo, __VA_ARGS__)
+#define LOG_ACTION(module, echo, ...)   LOG_AT(LV_ACTION, module, echo, __VA_ARGS__)
+#define LOG_INFO(module, echo, ...)     LOG_AT(LV_INFO, module, echo, __VA_ARGS__)
+#define LOG_DEBUG(module, echo, ...)    LOG_AT(LV_DEBUG, module, echo, __VA_ARGS__)
+
+// provided by each program, formats the message and logs it under
+// lv_typeName(level)
+void    logFormatted(LogLevel level, bool echo, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+// "Info", "Warning" and so on, as the log shows them
+const char *lv_typeName(LogLevel level);
+
+// "info", "warning" and so on, as filters spell them
+const char *lv_levelName(LogLevel level);
+
+// applies a filter such as "warning" or "info,monitor=warning,clients=debug",
+// a bare level sets every module. Returns false, changing nothing, when the
+// filter cannot be read.
+bool    lv_configure(const char *filter);
+
+// the current filter, in the form lv_configure reads
+void    lv_describe(char *buffer, size_t size);
+
+#endif //LOG_LEVEL_H
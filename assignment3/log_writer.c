@@ -0,0 +1,297 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include "log_writer.h"
+#include "log_rotate.h"
+#include "queue.h"
+#include "memwatch.h"
+
+// Producers format straight into a claimed queue slot, so they only contend
+// on the enqueue position and the single writer thread never takes a lock
+// unless it has nothing to do.
+typedef struct _LogSlot {
+    size_t length;
+    char data[LOG_WRITER_RECORD_SIZE];
+} LogSlot;
+
+static MpscQueue queue;
+
+static char logPath[512];
+static int logFd = -1;
+static unsigned long long logSize = 0;     // only used by the writer thread once it runs
+static bool running = false;
+static int stopping = 0;
+static int writerSleeping = 0;
+static unsigned int fsyncInterval = 0;
+static LogPreamble preamble = NULL;
+
+static pthread_t writerThread;
+static pthread_mutex_t wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;
+
+static LogWriterStats stats;
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void writeFully(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        while (count > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+static void wakeWriter() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writerSleeping, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&wakeLock);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&wakeLock);
+    }
+}
+
+static void openLog() {
+    logFd = open(logPath, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (logFd != -1 && preamble != NULL) {
+        preamble(logFd);
+    }
+    struct stat details;
+    logSize = logFd != -1 && fstat(logFd, &details) == 0 ? (unsigned long long) details.st_size : 0;
+}
+
+// the rename is all that happens here, compression is left to log_rotate's thread
+static void rotateLog(bool unsynced) {
+    if (unsynced && fsyncInterval > 0) {
+        fdatasync(logFd);
+        __atomic_add_fetch(&stats.fsyncs, 1, __ATOMIC_RELAXED);
+    }
+    close(logFd);
+    lr_rotate();
+    openLog();
+}
+
+static void *writerMain(void *unused) {
+    struct iovec iov[LOG_WRITER_BATCH];
+    unsigned long long lastFsync = nowNs();
+    bool unsynced = false;
+
+    while (true) {
+        int count = 0;
+        LogSlot *slot;
+        while (count < LOG_WRITER_BATCH && (slot = mq_peek(&queue, (size_t) count)) != NULL) {
+            iov[count].iov_base = slot->data;
+            iov[count].iov_len = slot->length;
+            count++;
+        }
+
+        if (count > 0) {
+            size_t depth = mq_size(&queue);
+            if (depth > stats.peakQueueDepth) {
+                __atomic_store_n(&stats.peakQueueDepth, depth, __ATOMIC_RELAXED);
+            }
+
+            if (lr_due(logSize)) {
+                rotateLog(unsynced);
+                unsynced = false;
+            }
+
+            unsigned long long start = nowNs();
+            for (int i = 0; i < count; i++) {
+                logSize += iov[i].iov_len;
+            }
+            writeFully(logFd, iov, count);
+            unsynced = true;
+
+            // group commit, one fsync covers every batch since the last one
+            if (fsyncInterval > 0 && start - lastFsync >= fsyncInterval * 1000000ULL) {
+                fdatasync(logFd);
+                lastFsync = nowNs();
+                unsynced = false;
+                __atomic_add_fetch(&stats.fsyncs, 1, __ATOMIC_RELAXED);
+            }
+            unsigned long long elapsed = nowNs() - start;
+
+            mq_release(&queue, (size_t) count);
+
+            __atomic_add_fetch(&stats.recordsWritten, count, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&stats.batchesWritten, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&stats.totalFlushNs, elapsed, __ATOMIC_RELAXED);
+            __atomic_store_n(&stats.lastFlushNs, elapsed, __ATOMIC_RELAXED);
+            if (elapsed > stats.maxFlushNs) {
+                __atomic_store_n(&stats.maxFlushNs, elapsed, __ATOMIC_RELAXED);
+            }
+            continue;
+        }
+
+        if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        if (unsynced && fsyncInterval > 0 && nowNs() - lastFsync >= fsyncInterval * 1000000ULL) {
+            fdatasync(logFd);
+            lastFsync = nowNs();
+            unsynced = false;
+            __atomic_add_fetch(&stats.fsyncs, 1, __ATOMIC_RELAXED);
+        }
+
+        // nothing queued, sleep until a producer wakes us. The timeout bounds
+        // how late a pending fsync can be.
+        pthread_mutex_lock(&wakeLock);
+        __atomic_store_n(&writerSleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (mq_peek(&queue, 0) == NULL && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 10 * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&wakeCond, &wakeLock, &deadline);
+        }
+        __atomic_store_n(&writerSleeping, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&wakeLock);
+    }
+
+    if (unsynced && fsyncInterval > 0) {
+        fdatasync(logFd);
+        __atomic_add_fetch(&stats.fsyncs, 1, __ATOMIC_RELAXED);
+    }
+    return unused;
+}
+
+void lw_setPreamble(LogPreamble logPreamble) {
+    preamble = logPreamble;
+}
+
+bool lw_start(const char *path, unsigned int fsyncIntervalMs, const LogRotateOptions *rotation) {
+    snprintf(logPath, sizeof(logPath), "%s", path);
+    fsyncInterval = fsyncIntervalMs;
+
+    openLog();
+    if (logFd == -1) {
+        return false;
+    }
+
+    if (mq_init(&queue, sizeof(LogSlot), LOG_WRITER_SLOTS) == false) {
+        close(logFd);
+        logFd = -1;
+        return false;
+    }
+    memset(&stats, 0, sizeof(stats));
+    stopping = 0;
+
+    if (rotation != NULL) {
+        lr_start(logPath, rotation);
+    }
+    if (pthread_create(&writerThread, NULL, &writerMain, NULL) != 0) {
+        lr_stop();
+        mq_free(&queue);
+        close(logFd);
+        logFd = -1;
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void lw_stop() {
+    if (running == false) {
+        return;
+    }
+    running = false;
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&wakeLock);
+    pthread_cond_signal(&wakeCond);
+    pthread_mutex_unlock(&wakeLock);
+    pthread_join(writerThread, NULL);
+
+    close(logFd);
+    logFd = -1;
+    mq_free(&queue);
+    lr_stop();
+}
+
+void lw_write(const char *record, size_t length) {
+    if (length > LOG_WRITER_RECORD_SIZE) {
+        length = LOG_WRITER_RECORD_SIZE;
+    }
+
+    if (running == false) {
+        // no writer thread, fall back to writing synchronously
+        int fd = open(logPath, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd != -1) {
+            write(fd, record, length);
+            close(fd);
+        }
+        return;
+    }
+
+    LogSlot *slot;
+    while ((slot = mq_claim(&queue)) == NULL) {
+        // full, the writer is behind the disk so wait for it
+        __atomic_add_fetch(&stats.producerStalls, 1, __ATOMIC_RELAXED);
+        wakeWriter();
+        sched_yield();
+    }
+
+    memcpy(slot->data, record, length);
+    slot->length = length;
+    mq_publish(&queue, slot);
+    wakeWriter();
+}
+
+void lw_getStats(LogWriterStats *out) {
+    out->queueDepth = mq_size(&queue);
+    out->peakQueueDepth = __atomic_load_n(&stats.peakQueueDepth, __ATOMIC_RELAXED);
+    out->recordsWritten = __atomic_load_n(&stats.recordsWritten, __ATOMIC_RELAXED);
+    out->batchesWritten = __atomic_load_n(&stats.batchesWritten, __ATOMIC_RELAXED);
+    out->fsyncs = __atomic_load_n(&stats.fsyncs, __ATOMIC_RELAXED);
+    out->producerStalls = __atomic_load_n(&stats.producerStalls, __ATOMIC_RELAXED);
+    out->lastFlushNs = __atomic_load_n(&stats.lastFlushNs, __ATOMIC_RELAXED);
+    out->maxFlushNs = __atomic_load_n(&stats.maxFlushNs, __ATOMIC_RELAXED);
+    out->totalFlushNs = __atomic_load_n(&stats.totalFlushNs, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "log_rotate.h"
+
+#define LOG_WRITER_SLOTS 4096      // must be a power of two
+#define LOG_WRITER_RECORD_SIZE 1024
+#define LOG_WRITER_BATCH 512       // records per writev
+
+typedef struct _LogWriterStats {
+    size_t queueDepth;
+    size_t peakQueueDepth;
+    unsigned long long recordsWritten;
+    unsigned long long batchesWritten;
+    unsigned long long fsyncs;
+    unsigned long long producerStalls; // times a producer found the queue full
+    unsigned long long lastFlushNs;
+    unsigned long long maxFlushNs;
+    unsigned long long totalFlushNs;
+} LogWriterStats;
+
+// written at the start of every file the writer opens, rotations included
+typedef void (*LogPreamble)(int fd);
+
+// opens path with O_APPEND and starts the writer thread, a fsyncInterval of
+// 0 never calls fsync, otherwise fsync runs at most once per interval. The
+// writer thread rotates the log as rotation says, NULL never rotates.
+bool    lw_start(const char *path, unsigned int fsyncIntervalMs, const LogRotateOptions *rotation);
+
+// set before lw_start, NULL for none
+void    lw_setPreamble(LogPreamble preamble);
+
+// drains every queued record and stops the writer thread
+void    lw_stop();
+
+// copies the record into the queue, safe to call from any thread
+void    lw_write(const char *record, size_t length);
+
+void    lw_getStats(LogWriterStats *stats);
+
+#endif //LOG_WRITER_H
@@ -0,0 +1,135 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "names.h"
+#include "memwatch.h"
+
+// names[id], with names[NM_NONE] left NULL
+static char **names = NULL;
+static int length = 1;
+static int capacity = 0;
+
+// open addressed, probed linearly, kept at most half full. Holds ids,
+// NM_NONE marks an empty bucket.
+static NameId *buckets = NULL;
+static unsigned int bucketMask = 0;
+
+// FNV-1a
+static unsigned int hashOf(const char *name) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *) name; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static unsigned int bucketOf(const char *name) {
+    unsigned int bucket = hashOf(name) & bucketMask;
+    while (buckets[bucket] != NM_NONE && strcmp(names[buckets[bucket]], name) != 0) {
+        bucket = (bucket + 1) & bucketMask;
+    }
+    return bucket;
+}
+
+static bool grow() {
+    int newCapacity = capacity > 0 ? capacity * 2 : NM_INITIAL_CAPACITY;
+    char **newNames = malloc(sizeof(char *) * (size_t) newCapacity);
+    NameId *newBuckets = calloc((size_t) newCapacity * 2, sizeof(NameId));
+    if (newNames == NULL || newBuckets == NULL) {
+        free(newNames);
+        free(newBuckets);
+        return false;
+    }
+    newNames[NM_NONE] = NULL;
+    if (names != NULL) {
+        memcpy(newNames, names, sizeof(char *) * (size_t) length);
+        free(names);
+        free(buckets);
+    }
+    names = newNames;
+    buckets = newBuckets;
+    capacity = newCapacity;
+    bucketMask = (unsigned int) newCapacity * 2 - 1;
+
+    for (NameId id = 1; id < (NameId) length; id++) {
+        buckets[bucketOf(names[id])] = id;
+    }
+    return true;
+}
+
+NameId nm_intern(const char *name) {
+    if (name[0] == '\0') {
+        return NM_NONE;
+    }
+    if (buckets != NULL) {
+        unsigned int bucket = bucketOf(name);
+        if (buckets[bucket] != NM_NONE) {
+            return buckets[bucket];
+        }
+    }
+    if (length == capacity || buckets == NULL) {
+        if (grow() == false) {
+            return NM_NONE;
+        }
+    }
+
+    size_t size = strlen(name) + 1;
+    char *copy = malloc(size);
+    if (copy == NULL) {
+        return NM_NONE;
+    }
+    memcpy(copy, name, size);
+    NameId id = (NameId) length++;
+    names[id] = copy;
+    buckets[bucketOf(copy)] = id;
+    return id;
+}
+
+NameId nm_find(const char *name) {
+    if (buckets == NULL || name[0] == '\0') {
+        return NM_NONE;
+    }
+    return buckets[bucketOf(name)];
+}
+
+const char *nm_name(NameId id) {
+    if (id == NM_NONE || id >= (NameId) length) {
+        return "";
+    }
+    return names[id];
+}
+
+int nm_count() {
+    return length - 1;
+}
+
+void nm_free() {
+    for (int id = 1; id < length; id++) {
+        free(names[id]);
+    }
+    if (names != NULL) {
+        free(names);
+        free(buckets);
+        names = NULL;
+        buckets = NULL;
+    }
+    length = 1;
+    capacity = 0;
+    bucketMask = 0;
+}
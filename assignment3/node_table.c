@@ -0,0 +1,141 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "node_table.h"
+#include "memwatch.h"
+
+// open addressing with linear probing, nodes are never removed so a
+// reconnecting client finds its old entry
+static NodeState **slots = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+static size_t hashNode(const char *node) {
+    size_t hash = 2166136261u;
+    for (const char *c = node; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t findSlot(NodeState **table, size_t size, const char *node) {
+    size_t index = hashNode(node) & (size - 1);
+    while (table[index] != NULL && strcmp(table[index]->node, node) != 0) {
+        index = (index + 1) & (size - 1);
+    }
+    return index;
+}
+
+static void grow() {
+    size_t newCapacity = capacity == 0 ? NODE_TABLE_INITIAL_SLOTS : capacity * 2;
+    NodeState **table = calloc(newCapacity, sizeof(NodeState *));
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL) {
+            table[findSlot(table, newCapacity, slots[i]->node)] = slots[i];
+        }
+    }
+    if (slots != NULL) {
+        free(slots);
+    }
+    slots = table;
+    capacity = newCapacity;
+}
+
+static NodeState *lookup(const char *node) {
+    if ((count + 1) * 10 > capacity * 7) {
+        grow();
+    }
+    size_t index = findSlot(slots, capacity, node);
+    if (slots[index] == NULL) {
+        slots[index] = calloc(1, sizeof(NodeState));
+        snprintf(slots[index]->node, NODE_NAME_LENGTH, "%s", node);
+        count++;
+    }
+    return slots[index];
+}
+
+void nt_init() {
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    grow();
+}
+
+void nt_free() {
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL) {
+            free(slots[i]);
+        }
+    }
+    free(slots);
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+}
+
+void nt_connected(const char *node, const char *via) {
+    NodeState *state = lookup(node);
+    snprintf(state->via, NODE_NAME_LENGTH, "%s", via);
+    state->connected = true;
+    state->monitored = 0;
+    state->lastSeen = time(NULL);
+}
+
+void nt_disconnected(const char *node) {
+    NodeState *state = lookup(node);
+    state->connected = false;
+    state->monitored = 0;
+    state->lastSeen = time(NULL);
+}
+
+void nt_relayDisconnected(const char *via) {
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL && slots[i]->connected && strcmp(slots[i]->via, via) == 0) {
+            slots[i]->connected = false;
+            slots[i]->monitored = 0;
+            slots[i]->lastSeen = time(NULL);
+        }
+    }
+}
+
+void nt_setMonitored(const char *node, const char *via, int monitored) {
+    NodeState *state = lookup(node);
+    snprintf(state->via, NODE_NAME_LENGTH, "%s", via);
+    state->connected = true;
+    state->monitored = monitored;
+    state->lastSeen = time(NULL);
+}
+
+void nt_forEach(NodeStateOperation operation, void *context) {
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL) {
+            operation(slots[i], context);
+        }
+    }
+}
+
+int nt_connectedCount() {
+    int connected = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] != NULL && slots[i]->connected) {
+            connected++;
+        }
+    }
+    return connected;
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "protocol.h"
+
+#define NODE_TABLE_INITIAL_SLOTS 64
+
+// what the server knows about one procnanny.client, directly connected or
+// behind a relay
+typedef struct _NodeState {
+    char node[NODE_NAME_LENGTH];
+    char via[NODE_NAME_LENGTH];    // relay the node is behind, empty if direct
+    int monitored;                 // processes the client is monitoring
+    bool connected;
+    time_t lastSeen;
+} NodeState;
+
+typedef void (*NodeStateOperation)(const NodeState *state, void *context);
+
+void    nt_init();
+
+void    nt_free();
+
+void    nt_connected(const char *node, const char *via);
+
+void    nt_disconnected(const char *node);
+
+// marks every node behind the relay as disconnected
+void    nt_relayDisconnected(const char *via);
+
+void    nt_setMonitored(const char *node, const char *via, int monitored);
+
+void    nt_forEach(NodeStateOperation operation, void *context);
+
+int     nt_connectedCount();
+
+#endif //NODE_TABLE_H
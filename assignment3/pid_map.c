@@ -0,0 +1,142 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "pid_map.h"
+#include "memwatch.h"
+
+static unsigned int slotOf(PidMap *map, pid_t pid) {
+    return ((unsigned int) pid * 2654435761u) >> map->shift;
+}
+
+static void allocate(PidMap *map, int capacity) {
+    map->capacity = capacity;
+    map->shift = 32;
+    while ((1 << (32 - map->shift)) < capacity) {
+        map->shift--;
+    }
+    map->keys = calloc((size_t) capacity, sizeof(pid_t));
+    map->items = malloc((size_t) capacity * map->itemSize);
+}
+
+// the slot holding pid, or the empty slot ending its run
+static unsigned int find(PidMap *map, pid_t pid) {
+    unsigned int mask = (unsigned int) map->capacity - 1;
+    unsigned int slot = slotOf(map, pid);
+    while (map->keys[slot] != 0 && map->keys[slot] != pid) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void grow(PidMap *map) {
+    pid_t *oldKeys = map->keys;
+    char *oldItems = map->items;
+    int oldCapacity = map->capacity;
+
+    allocate(map, oldCapacity * 2);
+    for (int i = 0; i < oldCapacity; i++) {
+        if (oldKeys[i] != 0) {
+            unsigned int slot = find(map, oldKeys[i]);
+            map->keys[slot] = oldKeys[i];
+            memcpy(map->items + slot * map->itemSize, oldItems + i * map->itemSize, map->itemSize);
+        }
+    }
+    free(oldKeys);
+    free(oldItems);
+}
+
+void pm_init(PidMap *map, size_t itemSize) {
+    map->length = 0;
+    map->itemSize = itemSize;
+    allocate(map, PM_INITIAL_CAPACITY);
+}
+
+void pm_free(PidMap *map) {
+    free(map->keys);
+    free(map->items);
+    map->keys = NULL;
+    map->items = NULL;
+    map->length = 0;
+    map->capacity = 0;
+}
+
+bool pm_add(PidMap *map, pid_t pid, void *item) {
+    if (pid <= 0) {
+        return false;
+    }
+    if ((map->length + 1) * 4 > map->capacity * 3) {
+        grow(map);
+    }
+    unsigned int slot = find(map, pid);
+    if (map->keys[slot] == pid) {
+        return false;
+    }
+    map->keys[slot] = pid;
+    memcpy(map->items + slot * map->itemSize, item, map->itemSize);
+    map->length++;
+    return true;
+}
+
+void* pm_get(PidMap *map, pid_t pid) {
+    // 0 marks an empty slot, so it must never be found
+    if (pid <= 0) {
+        return NULL;
+    }
+    unsigned int slot = find(map, pid);
+    return map->keys[slot] == pid ? map->items + slot * map->itemSize : NULL;
+}
+
+bool pm_remove(PidMap *map, pid_t pid) {
+    if (pid <= 0) {
+        return false;
+    }
+    unsigned int mask = (unsigned int) map->capacity - 1;
+    unsigned int hole = find(map, pid);
+    if (map->keys[hole] != pid) {
+        return false;
+    }
+
+    // pull back every later item in the run whose probe passed over the hole
+    for (unsigned int next = (hole + 1) & mask; map->keys[next] != 0; next = (next + 1) & mask) {
+        unsigned int home = slotOf(map, map->keys[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->keys[hole] = map->keys[next];
+            memcpy(map->items + hole * map->itemSize, map->items + next * map->itemSize, map->itemSize);
+            hole = next;
+        }
+    }
+    map->keys[hole] = 0;
+    map->length--;
+    return true;
+}
+
+void pm_forEach(PidMap *map, NodeOperation operation) {
+    if (operation == NULL) {
+        return;
+    }
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->keys[i] != 0) {
+            operation(map->items + i * map->itemSize);
+        }
+    }
+}
+
+int pm_size(PidMap *map) {
+    return map->length;
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "proc_nanny_admin.h"
+#include "admin.h"
+#include "memwatch.h"
+
+int main(int args, char* argv[]) {
+    const char* path = getenv("PROCNANNYADMIN");
+    if (path == NULL) {
+        path = ADMIN_DEFAULT_PATH;
+    }
+
+    int option;
+    while ((option = getopt(args, argv, "s:")) != -1) {
+        switch (option) {
+            case 's':
+                path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind >= args) {
+        usage(argv[0]);
+    }
+
+    // the remaining arguments make up a single request line
+    char request[ADMIN_REQUEST_LENGTH];
+    size_t used = 0;
+    for (int i = optind; i < args; i++) {
+        int written = snprintf(request + used, sizeof(request) - used, "%s%s",
+                               argv[i], i + 1 < args ? " " : "\n");
+        if (written < 0 || (size_t) written >= sizeof(request) - used) {
+            printf("Error: request too long.\n");
+            exit(EXIT_FAILURE);
+        }
+        used += written;
+    }
+
+    int sd = connectToAdminSocket(path);
+    if (sd < 0) {
+        printf("Error: could not connect to admin socket %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (write(sd, request, used) != (ssize_t) used) {
+        printf("Error: could not send request.\n");
+        close(sd);
+        exit(EXIT_FAILURE);
+    }
+
+    int status = printResponse(sd);
+    close(sd);
+    exit(status);
+}
+
+void usage(const char* program) {
+    printf("Usage: %s [-s admin socket] COMMAND [arguments]\n", program);
+    printf("Run '%s HELP' for the list of commands.\n", program);
+    exit(EXIT_FAILURE);
+}
+
+int connectToAdminSocket(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0) {
+        return -1;
+    }
+    if (connect(sd, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+int printResponse(int sd) {
+    // print every line up to the terminator, fail if the server reported an error
+    char buffer[RESPONSE_BUFFER_SIZE];
+    size_t length = 0;
+    int status = EXIT_SUCCESS;
+    while (1) {
+        ssize_t valread = read(sd, buffer + length, sizeof(buffer) - 1 - length);
+        if (valread <= 0) {
+            printf("Error: connection closed before the response ended.\n");
+            return EXIT_FAILURE;
+        }
+        length += valread;
+        buffer[length] = '\0';
+
+        char* line = buffer;
+        char* newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+            if (strcmp(line, ADMIN_END) == 0) {
+                return status;
+            }
+            if (strncmp(line, "ERR", 3) == 0) {
+                status = EXIT_FAILURE;
+            }
+            printf("%s\n", line);
+            line = newline + 1;
+        }
+
+        length = buffer + length - line;
+        memmove(buffer, line, length);
+        if (length == sizeof(buffer) - 1) {
+            // a line longer than the buffer, print what we have
+            buffer[length] = '\0';
+            printf("%s", buffer);
+            length = 0;
+        }
+    }
+}
@@ -28,27 +28,77 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/un.h>
 #include "proc_nanny_client.h"
+#include "protocol.h"
 #include "linked_list.h"
+#include "pid_map.h"
+#include "vector.h"
+#include "intrusive_list.h"
+#include "thread_pool.h"
+#include "shm_ring.h"
+#include "compress.h"
+#include "log_format.h"
+#include "log_level.h"
 #include "memwatch.h"
 
 bool firstConfigurationReRead = false;
 
 int numProcessesKilled = 0;
+int reportedMonitoring = -1;
+
+// lines from the server that have not been handled yet
+char serverPending[SERVER_BUFFER_SIZE];
+size_t serverPendingLength = 0;
+int configRemaining = 0;
+int configIndex = 0;
+bool configurationReceived = false;
+
+// used instead of the socket once the server's shared memory offer is taken
+ShmRing toServer;
+ShmRing toClient;
+char ringPending[SERVER_BUFFER_SIZE];
+size_t ringPendingLength = 0;
 
 int server = 0;
 int port;
 char hostname[64];
+char nodeName[NODE_NAME_LENGTH];
+
+LogBatch logBatch;
+// dictionary version the server offered, batches go compressed once set
+int compressDictionary = 0;
+char compressRaw[LOG_BATCH_BYTES + LOG_MESSAGE_LENGTH];
+char compressOut[LOG_BATCH_BYTES + LOG_MESSAGE_LENGTH + (LOG_BATCH_BYTES + LOG_MESSAGE_LENGTH) / 255 + 16];
 
 ProgramConfig configLines[CONFIG_FILE_LINES];
-List monitoredProcesses;
-List childProcesses;
+Vector monitoredProcesses;
+PidMap monitoredPids;       // the VectorHandle of each pid's entry
+WorkerPool workers;
 
 int main(int args, char* argv[]) {
     checkInputs(args, argv);
+    char *procnannyLogLevel = getenv("PROCNANNYLOGLEVEL");
+    if (procnannyLogLevel != NULL && lv_configure(procnannyLogLevel) == false) {
+        printf("Warning: Could not read PROCNANNYLOGLEVEL '%s', using the defaults.\n", procnannyLogLevel);
+    }
+    int threads = 0;
+    char *procnannyThreads = getenv("PROCNANNYTHREADS");
+    if (procnannyThreads != NULL && sscanf(procnannyThreads, "%d", &threads) != 1) {
+        printf("Warning: Could not read PROCNANNYTHREADS '%s', using one per CPU.\n", procnannyThreads);
+        threads = 0;
+    }
+    if (tp_start(threads)) {
+        atexit(&tp_stop);
+    }
     killAllProcNannys();
     connectToServer();
-    readConfigurationFromServer(NULL);
+    while (configurationReceived == false) {
+        readConfigurationFromServer(NULL);
+    }
     beginProcNanny();
     cleanUp();
     exit(EXIT_SUCCESS);
@@ -108,6 +158,12 @@ void connectToServer() {
         printf("Error: failed to connect to server.");
         exit(EXIT_FAILURE);
     }
+
+    // the hostname is announced once here instead of in every log record
+    gethostname(nodeName, NODE_NAME_LENGTH);
+    char buffer[NODE_NAME_LENGTH + 32];
+    snprintf(buffer, sizeof(buffer), "%s %s\n", PROTOCOL_NODE, nodeName);
+    send(server, buffer, strlen(buffer), 0);
 }
 
 void readConfigurationFromServer(struct timeval * tv) {
@@ -116,43 +172,213 @@ void readConfigurationFromServer(struct timeval * tv) {
     FD_SET(server, &readable);
     int max_sd = server;
 
+    if (sr_isOpen(&toClient)) {
+        int ringFd = sr_notifyFd(&toClient);
+        FD_SET(ringFd, &readable);
+        if (ringFd > max_sd) {
+            max_sd = ringFd;
+        }
+    }
+
     int activity = select( max_sd + 1 , &readable , NULL , NULL , tv);
 
     if (activity == -1) {
         return;
     }
 
-    if (FD_ISSET(server, &readable)) {
+    if (sr_isOpen(&toClient)) {
+        size_t valread;
+        while ((valread = sr_read(&toClient, ringPending + ringPendingLength,
+                                  SERVER_BUFFER_SIZE - 1 - ringPendingLength)) > 0) {
+            ringPendingLength = consumeServerInput(ringPending, ringPendingLength + valread);
+        }
+    }
+
+    if (FD_ISSET(server, &readable) == 0) {
+        return;
+    }
+
+    // take whatever has arrived, a configuration may span several reads
+    ssize_t received = read(server, serverPending + serverPendingLength,
+                            SERVER_BUFFER_SIZE - 1 - serverPendingLength);
+    if (received <= 0) {
+        // the server went away without telling us to exit
+        cleanUp();
+        exit(EXIT_SUCCESS);
+    }
+    serverPendingLength = consumeServerInput(serverPending, serverPendingLength + received);
+}
+
+size_t consumeServerInput(char* pending, size_t length) {
+    pending[length] = '\0';
+
+    char* line = pending;
+    char* newline;
+    while ((newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        handleServerLine(line);
+        line = newline + 1;
+    }
+
+    size_t remaining = pending + length - line;
+    if (remaining == SERVER_BUFFER_SIZE - 1) {
+        remaining = 0;
+    }
+    memmove(pending, line, remaining);
+    return remaining;
+}
+
+void handleServerLine(char* line) {
+    if (strncmp(line, PROTOCOL_KILL, strlen(PROTOCOL_KILL)) == 0) {
+        cleanUp();
+        exit(EXIT_SUCCESS);
+    }
+
+    if (strncmp(line, PROTOCOL_ACTION, strlen(PROTOCOL_ACTION)) == 0) {
+        handleAction(line + strlen(PROTOCOL_ACTION));
+        return;
+    }
+
+    if (strncmp(line, PROTOCOL_SHM, strlen(PROTOCOL_SHM)) == 0) {
+        switchToSharedMemory(line + strlen(PROTOCOL_SHM));
+        return;
+    }
+
+    if (strncmp(line, PROTOCOL_COMPRESS, strlen(PROTOCOL_COMPRESS)) == 0) {
+        char *procnannyCompress = getenv("PROCNANNYCOMPRESS");
+        int version = 0;
+        sscanf(line + strlen(PROTOCOL_COMPRESS), "%d", &version);
+        if (version == LZ_DICTIONARY_VERSION && (procnannyCompress == NULL || strcmp(procnannyCompress, "0") != 0)) {
+            compressDictionary = version;
+        }
+        return;
+    }
+
+    // "___CONFIG___ <n>" frames the lines that follow it
+    if (strncmp(line, PROTOCOL_CONFIG, strlen(PROTOCOL_CONFIG)) == 0) {
         for (int i = 0; i < CONFIG_FILE_LINES; i++) {
             configLines[i].runtime = 0;
-            strcpy(configLines[i].programName, "");
+            configLines[i].program = NM_NONE;
         }
+        configRemaining = 0;
+        configIndex = 0;
+        sscanf(line + strlen(PROTOCOL_CONFIG), "%d", &configRemaining);
+        if (configRemaining == 0) {
+            configurationReceived = true;
+            firstConfigurationReRead = true;
+        }
+        return;
+    }
 
-        char buff[2048];
-        sleep(2);
-        read(server, buff, 2048);
-        int charsRead = 0;
-        char program[64];
-        unsigned int runtime;
-        int extra;
-        int i =0;
-        while(0 < sscanf(buff + charsRead, "%s %d\n%n", program, &runtime, &extra)) {
-            if (strcmp(program, "___KILL___") == 0) {
-                cleanUp();
-                exit(EXIT_SUCCESS);
+    if (configRemaining > 0) {
+        char program[PROGRAM_NAME_LENGTH];
+        if (configIndex < CONFIG_FILE_LINES
+            && sscanf(line, "%127s %u", program, &configLines[configIndex].runtime) == 2) {
+            configLines[configIndex].program = nm_intern(program);
+            configIndex++;
+        }
+        configRemaining--;
+        if (configRemaining == 0) {
+            configurationReceived = true;
+            firstConfigurationReRead = true;
+        }
+    }
+}
+
+void switchToSharedMemory(const char* fields) {
+    char name[108];
+    char token[PROTOCOL_SHM_TOKEN_LENGTH];
+    if (sr_isOpen(&toServer) || sscanf(fields, "%100s %63s", name, token) != 2) {
+        return;
+    }
+    if (sr_create(&toServer, SHM_RING_SIZE) == false) {
+        return;
+    }
+    if (sr_create(&toClient, SHM_RING_SIZE) == false) {
+        sr_close(&toServer);
+        return;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path + 1, name, strlen(name));
+    socklen_t length = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + 1 + strlen(name));
+
+    // everything already batched goes over the socket, so nothing overtakes it
+    flushLogBatch();
+
+    int fds[SHM_RING_FDS] = {toServer.memfd, toServer.eventfd, toClient.memfd, toClient.eventfd};
+    int sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sd < 0 || connect(sd, (struct sockaddr*) &address, length) < 0 || sr_sendFds(sd, token, fds) == false) {
+        sr_close(&toServer);
+        sr_close(&toClient);
+    }
+    if (sd >= 0) {
+        close(sd);
+    }
+}
+
+void handleAction(const char* fields) {
+    unsigned long id = 0;
+    char targets[SERVER_BUFFER_SIZE];
+    char verb[16];
+    char program[PROGRAM_NAME_LENGTH];
+    unsigned int runtime = 0;
+    int matched = sscanf(fields, "%lu %4095s %15s %127s %u", &id, targets, verb, program, &runtime);
+    if (matched < 4) {
+        return;
+    }
+
+    int count = 0;
+    if (strcmp(verb, "KILL") == 0) {
+        // straight away, rather than waiting for a worker's timer
+        pid_t pids[MAX_PROCESSES] = {-1};
+        getPids(program, pids);
+        for (int i = 0; i < MAX_PROCESSES; i++) {
+            if (pids[i] > 0 && pids[i] != getpid() && kill(pids[i], SIGKILL) == 0) {
+                count++;
+                queueRecord("%s %ld %d %u %s\n", PROTOCOL_KILLED, (long) time(NULL),
+                            (int) pids[i], 0, program);
             }
-            strcpy(configLines[i].programName, program);
-            configLines[i].runtime = runtime;
-            i++;
-            charsRead += extra;
         }
-        firstConfigurationReRead = true;
+        numProcessesKilled += count;
     }
+    else if (strcmp(verb, "RULE") == 0 && matched == 5) {
+        // overrides the runtime until the next configuration arrives
+        NameId name = nm_intern(program);
+        int slot = -1;
+        for (int i = 0; i < CONFIG_FILE_LINES && slot == -1; i++) {
+            if (configLines[i].program == name) {
+                slot = i;
+            }
+        }
+        for (int i = 0; i < CONFIG_FILE_LINES && slot == -1; i++) {
+            if (configLines[i].program == NM_NONE) {
+                slot = i;
+            }
+        }
+        if (slot != -1) {
+            configLines[slot].program = name;
+            configLines[slot].runtime = runtime;
+            count = 1;
+
+            LOG_INFO(LM_CONFIG, false, "Runtime of '%s' set to %u seconds on " PROTOCOL_NODE_MARKER ".",
+                     program, runtime);
+        }
+    }
+
+    // the server is timing this, do not wait for the batch to fill
+    queueRecord("%s %lu %d\n", PROTOCOL_ACK, id, count);
+    flushLogBatch();
 }
 
 void beginProcNanny() {
-    ll_init(&monitoredProcesses, sizeof(MonitoredProcess), &monitoredProcessComparator);
-    ll_init(&childProcesses, sizeof(ChildProcess), NULL);
+    vc_init(&monitoredProcesses, sizeof(MonitoredProcess));
+    pm_init(&monitoredPids, sizeof(VectorHandle));
+    ll_init(&workers.children, sizeof(ChildProcess), NULL);
+    il_init(&workers.idle);
+    hp_init(&workers.busy, WORKER_HEAP_ARITY, offsetof(ChildProcess, busyIndex));
     firstConfigurationReRead = true;
     checkForNewMonitoredProcesses(firstConfigurationReRead);
 
@@ -161,17 +387,26 @@ void beginProcNanny() {
     tv.tv_usec = 0;
 
     while(true) {
-        ll_forEach(&monitoredProcesses, &monitorNewProcesses);
-        ll_forEach(&childProcesses, &checkChild);
+        vc_forEachWith(&monitoredProcesses, &monitorNewProcesses, &workers);
+        checkBusyWorkers(&workers);
         readConfigurationFromServer(&tv);
         checkForNewMonitoredProcesses(firstConfigurationReRead);
+        reportMonitoring();
+        flushLogBatchIfStale();
     }
 }
 
 void cleanUp() {
-    ll_forEach(&childProcesses, &killChild);
-    ll_free(&monitoredProcesses);
-    ll_free(&childProcesses);
+    flushLogBatch();
+    sr_close(&toServer);
+    sr_close(&toClient);
+    ll_forEach(&workers.children, &killChild);
+    vc_free(&monitoredProcesses);
+    pm_free(&monitoredPids);
+    hp_free(&workers.busy);
+    ll_free(&workers.children);
+    il_init(&workers.idle);
+    nm_free();
     close(server);
 }
 
@@ -206,12 +441,14 @@ void getPids(const char *processName, pid_t pids[MAX_PROCESSES]) {
     if (pgrepOutput == NULL)
         return;
 
+    // runs on the pool threads, so strtok_r rather than strtok
     int index = 0;
+    char *save = NULL;
     if (getline(&line, &len, pgrepOutput) != -1) {
-        char *pch = strtok(line, " ,.-");
-        while (pch != NULL) {
+        char *pch = strtok_r(line, " ,.-", &save);
+        while (pch != NULL && index < MAX_PROCESSES) {
             pids[index] = (pid_t) atoi(pch);
-            pch = strtok(NULL, " ");
+            pch = strtok_r(NULL, " ", &save);
             index += 1;
         }
     }
@@ -219,12 +456,13 @@ void getPids(const char *processName, pid_t pids[MAX_PROCESSES]) {
 }
 
 void getCurrentTime(char *buffer) {
-    time_t rawTime;
-    struct tm *timeInfo;
-    time (&rawTime);
-    timeInfo = localtime (&rawTime);
-    strftime(buffer,TIME_BUFFER_SIZE,"%a %b %d %H:%M:%S %Z %Y", timeInfo);
-    trimWhitespace(buffer);
+    lf_timestamp(time(NULL), buffer);
+}
+
+long long getMonotonicMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
 }
 
 void killPid(pid_t pid) {
@@ -233,74 +471,83 @@ void killPid(pid_t pid) {
     system(buff);
 }
 
-bool monitoredProcessComparator(void *mp1, void *mp2) {
-    MonitoredProcess* first = (MonitoredProcess*) mp1;
-    MonitoredProcess* second = (MonitoredProcess*) mp2;
-
-    if (first->processPid == second->processPid) {
-        return true;
-    }
-
-    return false;
+void lookUpPids(int chunk, void *argument) {
+    PidLookup *lookup = argument;
+    getPids(nm_name(configLines[lookup->lines[chunk]].program), lookup->pids[chunk]);
 }
 
 void checkForNewMonitoredProcesses(bool logNoProcessesFound) {
+    // every pidof runs at once across the thread pool, the results are then
+    // added here one program at a time
+    // a megabyte of rows, kept between passes rather than allocated each time
+    static PidLookup lookup;
+    lookup.count = 0;
     for (int i = 0; i < CONFIG_FILE_LINES; i++) {
-        if (strlen(configLines[i].programName) != 0) {
-            pid_t pids[MAX_PROCESSES] = {-1};
-            getPids(configLines[i].programName, pids);
-            int numberFound = 0;
-            for (int j = 0; j < MAX_PROCESSES; j++) {
-                if (pids[j] > 0) {
-                    MonitoredProcess temp;
-                    strncpy(temp.processName, configLines[i].programName, PROGRAM_NAME_LENGTH);
-                    temp.processPid = pids[j];
-                    temp.runtime = configLines[i].runtime;
-                    temp.beingMonitored = false;
-                    ll_add_unique(&monitoredProcesses, &temp);
-                    numberFound++;
+        if (configLines[i].program != NM_NONE) {
+            lookup.lines[lookup.count++] = i;
+        }
+    }
+    if (lookup.count == 0) {
+        firstConfigurationReRead = false;
+        return;
+    }
+    memset(lookup.pids, 0, sizeof(lookup.pids[0]) * (size_t) lookup.count);
+    tp_run(&lookUpPids, lookup.count, &lookup);
+
+    for (int k = 0; k < lookup.count; k++) {
+        int i = lookup.lines[k];
+        pid_t *pids = lookup.pids[k];
+        int numberFound = 0;
+        for (int j = 0; j < MAX_PROCESSES; j++) {
+            if (pids[j] > 0) {
+                if (pm_get(&monitoredPids, pids[j]) == NULL) {
+                    VectorHandle handle;
+                    MonitoredProcess* process = vc_emplace(&monitoredProcesses, &handle);
+                    // with no room left the pid is picked up again on a later pass
+                    if (process != NULL) {
+                        process->program = configLines[i].program;
+                        process->processPid = pids[j];
+                        process->runtime = configLines[i].runtime;
+                        pm_add(&monitoredPids, pids[j], &handle);
+                    }
                 }
+                numberFound++;
             }
-            if (logNoProcessesFound && numberFound == 0) {
-                LogMessage msg;
-                char hostname[64];
-                gethostname(hostname,64);
-                snprintf(msg.message, LOG_MESSAGE_LENGTH, "No '%s' processes found on %s"
-                        , configLines[i].programName, hostname);
-                logToServer("Info", msg.message);
-            }
+        }
+        if (logNoProcessesFound && numberFound == 0) {
+            LOG_INFO(LM_MONITOR, false, "No '%s' processes found on " PROTOCOL_NODE_MARKER,
+                     nm_name(configLines[i].program));
         }
     }
-
     firstConfigurationReRead = false;
 }
 
-void monitorNewProcesses(void *monitoredProcess) {
-    MonitoredProcess* process = (MonitoredProcess*) monitoredProcess;
-    if (process->beingMonitored == false) {
-        ChildProcess* worker = ll_getIf(&childProcesses, &getChildPredicate);
-        if (worker == NULL) {
-            worker = spawnNewChildWorker();
-        }
-        initializeChild(worker, process);
-        LogMessage msg;
-        char hostname[256];
-        gethostname(hostname, 256);
-        snprintf(msg.message, LOG_MESSAGE_LENGTH, "Initializing monitoring of process '%s' (PID %d) on node %s.",
-                 process->processName, (int) process->processPid, hostname);
-        logToServer("Info", msg.message);
+void reportMonitoring() {
+    // only changes go to the server, it keeps the count for admin queries
+    int monitoring = vc_size(&monitoredProcesses);
+    if (monitoring != reportedMonitoring) {
+        reportedMonitoring = monitoring;
+        queueRecord("%s %d\n", PROTOCOL_MONITORING, monitoring);
     }
 }
 
-bool getChildPredicate(void *childProcess) {
-    ChildProcess* temp = (ChildProcess*) childProcess;
-    return temp->isAvailable;
+void monitorNewProcesses(void *monitoredProcess, void *workerPool) {
+    MonitoredProcess* process = (MonitoredProcess*) monitoredProcess;
+    WorkerPool* pool = (WorkerPool*) workerPool;
+    if (process->beingMonitored == false) {
+        Link* idle = il_popFront(&pool->idle);
+        ChildProcess* worker = idle != NULL ? IL_ENTRY(idle, ChildProcess, state) : spawnNewChildWorker(pool);
+        initializeChild(pool, worker, process);
+        LOG_INFO(LM_MONITOR, false, "Initializing monitoring of process '%s' (PID %d) on node " PROTOCOL_NODE_MARKER ".",
+                 nm_name(process->program), (int) process->processPid);
+    }
 }
 
-void initializeChild(ChildProcess *childWorker, MonitoredProcess *processToBeMonitored) {
-    childWorker->isAvailable = false;
+void initializeChild(WorkerPool *pool, ChildProcess *childWorker, MonitoredProcess *processToBeMonitored) {
+    il_remove(&childWorker->state);
+    hp_push(&pool->busy, childWorker, getMonotonicMs() + processToBeMonitored->runtime * 1000LL);
     processToBeMonitored->beingMonitored = true;
-    strncpy(childWorker->processName, processToBeMonitored->processName, PROGRAM_NAME_LENGTH);
+    childWorker->program = processToBeMonitored->program;
     childWorker->processPid = processToBeMonitored->processPid;
     childWorker->runtime = processToBeMonitored->runtime;
 
@@ -310,11 +557,12 @@ void initializeChild(ChildProcess *childWorker, MonitoredProcess *processToBeMon
     write(childWorker->toChild.readWrite[WRITE_PIPE], buff, strlen(buff));
 }
 
-ChildProcess *spawnNewChildWorker() {
-    ChildProcess worker;
-    worker.isAvailable = true;
-    pipe(worker.toChild.readWrite);
-    pipe(worker.toParent.readWrite);
+ChildProcess *spawnNewChildWorker(WorkerPool *pool) {
+    ChildProcess* worker = ll_emplace(&pool->children);
+    il_init(&worker->state);
+    worker->busyIndex = HP_NOT_QUEUED;
+    pipe(worker->toChild.readWrite);
+    pipe(worker->toParent.readWrite);
     __pid_t forkResult = fork();
 
     switch(forkResult) {
@@ -322,13 +570,18 @@ ChildProcess *spawnNewChildWorker() {
             exitError("ERROR: error in monitoring process");
             break;
         case 0:     //Child
-            close(worker.toChild.readWrite[WRITE_PIPE]);
-            close(worker.toParent.readWrite[READ_PIPE]);
-            ll_free(&monitoredProcesses);
-            ll_free(&childProcesses);
+            close(worker->toChild.readWrite[WRITE_PIPE]);
+            close(worker->toParent.readWrite[READ_PIPE]);
+            vc_free(&monitoredProcesses);
+            pm_free(&monitoredPids);
+            hp_free(&pool->busy);
+            // the worker's node goes with the list
+            ChildProcess self = *worker;
+            ll_free(&pool->children);
+            nm_free();
             close(server);
             while(true) {
-                FILE* fromParent = fdopen(worker.toChild.readWrite[READ_PIPE], "r");
+                FILE* fromParent = fdopen(self.toChild.readWrite[READ_PIPE], "r");
                 char command[255];
                 while(fgets(command, 255, fromParent) != NULL) {
                     // get parameters from parent's command
@@ -347,7 +600,7 @@ ChildProcess *spawnNewChildWorker() {
                     }
                     char buff[5];
                     snprintf(buff, 5, "%d", numKilled);
-                    write(worker.toParent.readWrite[WRITE_PIPE], buff, strlen(buff));
+                    write(self.toParent.readWrite[WRITE_PIPE], buff, strlen(buff));
                 }
                 fclose(fromParent);
                 exit(EXIT_SUCCESS);
@@ -356,58 +609,175 @@ ChildProcess *spawnNewChildWorker() {
             break;
     }
 
-    close(worker.toChild.readWrite[READ_PIPE]);
-    close(worker.toParent.readWrite[WRITE_PIPE]);
+    close(worker->toChild.readWrite[READ_PIPE]);
+    close(worker->toParent.readWrite[WRITE_PIPE]);
 
     // set to non blocking read of writes from child
-    int flags = fcntl(worker.toParent.readWrite[READ_PIPE], F_GETFL, 0);
+    int flags = fcntl(worker->toParent.readWrite[READ_PIPE], F_GETFL, 0);
     flags |= O_NONBLOCK;
-    fcntl(worker.toParent.readWrite[READ_PIPE], F_SETFL, flags);
-
-    worker.childPid = forkResult;
-    ll_add(&childProcesses, &worker);
+    fcntl(worker->toParent.readWrite[READ_PIPE], F_SETFL, flags);
 
-    return (ChildProcess*) ll_getIf(&childProcesses, &getChildPredicate);
+    worker->childPid = forkResult;
+    return worker;
 }
 
-void checkChild(void *childProcess) {
-    ChildProcess* child = (ChildProcess*) childProcess;
-    if (child->isAvailable == false) {
-        char command[255];
-        if (read(child->toParent.readWrite[READ_PIPE], command, 255) == -1) {
-            return;
-        }
-        int numKilled = 0;
-        sscanf(command, "%d\n", &numKilled);
-        if (numKilled != 0) {
-            numProcessesKilled+=numKilled;
-            LogMessage msg;
-            char hostname[256];
-            gethostname(hostname, 256);
-            snprintf(msg.message, LOG_MESSAGE_LENGTH, "PID %d (%s) on %s killed after exceeding %d seconds.",
-                     child->processPid, child->processName, hostname, child->runtime);
-            logToServer("Action", msg.message);
+void checkBusyWorkers(WorkerPool* pool) {
+    // a worker sleeps through the whole runtime before it reports, so only
+    // the ones past that can have anything to read
+    long long now = getMonotonicMs();
+    while (hp_size(&pool->busy) > 0 && hp_topKey(&pool->busy) <= now) {
+        ChildProcess* child = hp_top(&pool->busy);
+        if (checkChild(pool, child) == false) {
+            hp_update(&pool->busy, child, now + WORKER_RETRY_MS);
         }
-        child->isAvailable = true;
-        MonitoredProcess temp;
-        temp.processPid = child->processPid;
-        ll_remove(&monitoredProcesses, &temp);
     }
 }
 
+// returns false if the worker has not reported yet
+bool checkChild(WorkerPool* pool, ChildProcess* child) {
+    char command[255];
+    if (read(child->toParent.readWrite[READ_PIPE], command, 255) == -1) {
+        return false;
+    }
+    int numKilled = 0;
+    sscanf(command, "%d\n", &numKilled);
+    if (numKilled != 0) {
+        numProcessesKilled+=numKilled;
+        // the server writes the log line for this and counts it
+        queueRecord("%s %ld %d %u %s\n", PROTOCOL_KILLED, (long) time(NULL),
+                    (int) child->processPid, child->runtime, nm_name(child->program));
+    }
+    hp_remove(&pool->busy, child);
+    il_pushBack(&pool->idle, &child->state);
+    VectorHandle* handle = pm_get(&monitoredPids, child->processPid);
+    if (handle != NULL) {
+        vc_remove(&monitoredProcesses, *handle);
+        pm_remove(&monitoredPids, child->processPid);
+    }
+    return true;
+}
+
 void killChild(void *childProcess) {
     ChildProcess* child = (ChildProcess*) childProcess;
     killPid(child->childPid);
 }
 
 void logToServer(const char *type, const char *msg) {
-    char timebuffer[TIME_BUFFER_SIZE];
-    getCurrentTime(timebuffer);
-    LogMessage logMsg;
-    snprintf(logMsg.message, LOG_MESSAGE_LENGTH,
-             "[%s] %s: %s\n",
-             timebuffer, type, msg);
-    send(server, logMsg.message, strlen(logMsg.message), 0);
+    LogMessage* logMsg = &logBatch.records[logBatch.count];
+    commitRecord(lf_format(type, msg, logMsg->message, LOG_MESSAGE_LENGTH));
+}
+
+// the server does the echoing for anything logged here
+void logFormatted(LogLevel level, bool echo, const char *format, ...) {
+    LogMessage msg;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg.message, LOG_MESSAGE_LENGTH, format, args);
+    va_end(args);
+    logToServer(lv_typeName(level), msg.message);
+}
+
+void queueRecord(const char *format, ...) {
+    LogMessage* logMsg = &logBatch.records[logBatch.count];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(logMsg->message, LOG_MESSAGE_LENGTH, format, args);
+    va_end(args);
+    if (length >= LOG_MESSAGE_LENGTH) {
+        length = LOG_MESSAGE_LENGTH - 1;
+        logMsg->message[length - 1] = '\n';
+    }
+    commitRecord((size_t) length);
+}
+
+void commitRecord(size_t length) {
+    LogMessage* logMsg = &logBatch.records[logBatch.count];
+    if (logBatch.count == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &logBatch.oldest);
+    }
+    logBatch.iov[logBatch.count].iov_base = logMsg->message;
+    logBatch.iov[logBatch.count].iov_len = length;
+    logBatch.count++;
+    logBatch.bytes += length;
+
+    if (logBatch.count == LOG_BATCH_RECORDS || logBatch.bytes >= LOG_BATCH_BYTES) {
+        flushLogBatch();
+    }
+}
+
+void flushLogBatchIfStale() {
+    if (logBatch.count == 0) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ageMs = (now.tv_sec - logBatch.oldest.tv_sec) * 1000
+                 + (now.tv_nsec - logBatch.oldest.tv_nsec) / 1000000;
+    if (ageMs >= LOG_BATCH_MAX_AGE_MS) {
+        flushLogBatch();
+    }
+}
+
+void flushLogBatch() {
+    struct iovec* iov = logBatch.iov;
+    int count = logBatch.count;
+
+    if (sr_isOpen(&toServer)) {
+        while (count > 0 && sr_writeAll(&toServer, iov->iov_base, iov->iov_len)) {
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            // the server stopped reading, fall back to the socket for the rest
+            sr_close(&toServer);
+            sr_close(&toClient);
+        }
+    }
+
+    struct iovec frame[2];
+    char header[64];
+    if (count > 0 && compressDictionary != 0) {
+        // one frame for the whole batch, unless compressing does not pay
+        size_t rawLength = 0;
+        for (int i = 0; i < count; i++) {
+            memcpy(compressRaw + rawLength, iov[i].iov_base, iov[i].iov_len);
+            rawLength += iov[i].iov_len;
+        }
+        size_t compressedLength = lz_compressWithDictionary(compressRaw, rawLength, compressOut, sizeof(compressOut));
+        snprintf(header, sizeof(header), "%s %zu %zu %d\n", PROTOCOL_BATCH, rawLength, compressedLength,
+                 compressDictionary);
+        if (compressedLength != 0 && compressedLength + strlen(header) < rawLength) {
+            frame[0].iov_base = header;
+            frame[0].iov_len = strlen(header);
+            frame[1].iov_base = compressOut;
+            frame[1].iov_len = compressedLength;
+            iov = frame;
+            count = 2;
+        }
+    }
+
+    // writev may stop part way through, so step past whatever was sent
+    while (count > 0) {
+        ssize_t written = writev(server, iov, count);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        while (count > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    logBatch.count = 0;
+    logBatch.bytes = 0;
 }
 
 
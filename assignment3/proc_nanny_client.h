@@ -22,6 +22,11 @@
 #include <time.h>
 #include <sys/types.h>
 #include <stdbool.h>
+#include "intrusive_list.h"
+#include "heap.h"
+#include "linked_list.h"
+#include "names.h"
+#include <sys/uio.h>
 
 #define REFRESH_RATE 5
 #define MAX_PROCESSES 1024
@@ -29,10 +34,21 @@
 #define LOG_MESSAGE_LENGTH 512
 #define TIME_BUFFER_SIZE 40
 #define PROGRAM_NAME_LENGTH 128
+#define SERVER_BUFFER_SIZE 4096
 
 #define READ_PIPE 0
 #define WRITE_PIPE 1
 
+// log records are held back and sent together once either threshold is hit
+#define LOG_BATCH_RECORDS 64
+#define LOG_BATCH_BYTES 8192
+#define LOG_BATCH_MAX_AGE_MS 5
+
+// busy workers are kept in a 4-ary heap by when they will report back, and a
+// worker found still busy past that is looked at again this much later
+#define WORKER_HEAP_ARITY 4
+#define WORKER_RETRY_MS 5
+
 struct timeval;
 
 typedef struct _Pipe {
@@ -43,8 +59,17 @@ typedef struct _LogMessage {
     char message[LOG_MESSAGE_LENGTH];
 } LogMessage;
 
+typedef struct _LogBatch {
+    LogMessage records[LOG_BATCH_RECORDS];
+    struct iovec iov[LOG_BATCH_RECORDS];
+    int count;
+    size_t bytes;
+    struct timespec oldest;
+} LogBatch;
+
+// programs are interned names, see names.h
 typedef struct _ProgramConfig {
-    char programName[PROGRAM_NAME_LENGTH];
+    NameId program;     // NM_NONE for an unused line
     unsigned int runtime;
 } ProgramConfig;
 
@@ -52,19 +77,34 @@ typedef struct _ChildProcess {
     pid_t childPid; // may or may not be required... not sure yet
     Pipe toParent;
     Pipe toChild;
-    bool isAvailable;
+    Link state;     // on its pool's idle list while idle
+    int busyIndex;  // position in its pool's busy heap, HP_NOT_QUEUED while idle
     pid_t processPid;
-    char processName[PROGRAM_NAME_LENGTH];
+    NameId program;
     unsigned int runtime;
 } ChildProcess;
 
+// every worker is in children, and on idle or in busy
+typedef struct _WorkerPool {
+    List children;
+    Link idle;
+    Heap busy;          // by the time each worker will report back
+} WorkerPool;
+
 typedef struct _MonitoredProcess {
     pid_t processPid;
-    char processName[PROGRAM_NAME_LENGTH];
+    NameId program;
     unsigned int runtime;
     bool beingMonitored;
 } MonitoredProcess;
 
+// the configured programs being looked up together on the thread pool
+typedef struct _PidLookup {
+    int lines[CONFIG_FILE_LINES];   // indexes into configLines
+    pid_t pids[CONFIG_FILE_LINES][MAX_PROCESSES];   // one row per line
+    int count;
+} PidLookup;
+
 
 
 void beginProcNanny();
@@ -72,22 +112,33 @@ void connectToServer();
 void checkInputs(int args, char* argv[]);
 void cleanUp();
 void checkForNewMonitoredProcesses(bool logNoProcessesFound);
-void checkChild(void *childProcess);
+void checkBusyWorkers(WorkerPool* pool);
+bool checkChild(WorkerPool* pool, ChildProcess* child);
+void commitRecord(size_t length);
 void exitError(const char* errorMessage);
+void flushLogBatch();
+void flushLogBatchIfStale();
 void getCurrentTime(char* buffer);
+long long getMonotonicMs();
 void getPids(const char* processName, pid_t pids[MAX_PROCESSES]);
-void initializeChild(ChildProcess* childWorker, MonitoredProcess* processToBeMonitored);
+void handleAction(const char* fields);
+void handleServerLine(char* line);
+void switchToSharedMemory(const char* fields);
+void initializeChild(WorkerPool* pool, ChildProcess* childWorker, MonitoredProcess* processToBeMonitored);
 void killChild(void* childProcess);
 void killPid(pid_t pid);
+void lookUpPids(int chunk, void *argument);
 void killAllProcNannys();
 void logToServer(const char *type, const char *msg);
-void monitorNewProcesses(void *monitoredProcess);
+void monitorNewProcesses(void *monitoredProcess, void *workerPool);
+void queueRecord(const char *format, ...);
 void readConfigurationFromServer(struct timeval * tv);
+void reportMonitoring();
 void trimWhitespace(char* str);
 
-bool monitoredProcessComparator(void *mp1, void *mp2);
-bool getChildPredicate(void* childProcess);
+size_t consumeServerInput(char* pending, size_t length);
+
 
-ChildProcess* spawnNewChildWorker();
+ChildProcess* spawnNewChildWorker(WorkerPool* pool);
 
 #endif //PROC_NANNY_CLIENT_H
@@ -0,0 +1,117 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "proc_nanny_logcat.h"
+#include "event_log.h"
+#include "memwatch.h"
+
+int main(int args, char* argv[]) {
+    if (getopt(args, argv, "h") != -1) {
+        usage(argv[0]);
+    }
+
+    EventReader reader;
+    el_readerInit(&reader);
+    bool clean = true;
+    if (optind == args) {
+        clean = decode(stdin, &reader);
+    }
+    for (int i = optind; i < args; i++) {
+        FILE* input = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+        if (input == NULL) {
+            fprintf(stderr, "Error: could not read %s.\n", argv[i]);
+            clean = false;
+            continue;
+        }
+        // every file starts over with its own preamble
+        el_readerFree(&reader);
+        clean = decode(input, &reader) && clean;
+        if (input != stdin) {
+            fclose(input);
+        }
+    }
+    el_readerFree(&reader);
+    exit(clean ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void usage(const char* program) {
+    printf("Usage: %s [log file ...]\n", program);
+    printf("Prints a log written with PROCNANNYLOGFORMAT=binary as text, reading standard\n"
+           "input when no file is given. Text lines in the log are passed through.\n");
+    exit(EXIT_FAILURE);
+}
+
+// false if the input ended partway through a record
+bool decode(FILE* input, EventReader* reader) {
+    static char buffer[READ_BUFFER_SIZE];
+    static char line[EL_MAX_TEXT + 2 * EL_NAME_LENGTH + 128];
+    size_t start = 0;
+    size_t end = 0;
+    bool finished = false;
+
+    while (true) {
+        // keep at least one whole record and its text in the buffer
+        if (finished == false && end - start < sizeof(EventRecord) + EL_MAX_TEXT) {
+            memmove(buffer, buffer + start, end - start);
+            end -= start;
+            start = 0;
+            size_t received = fread(buffer + end, 1, sizeof(buffer) - end, input);
+            end += received;
+            finished = received == 0;
+            if (finished == false) {
+                continue;
+            }
+        }
+        if (start == end) {
+            return true;
+        }
+
+        EventRecord record;
+        bool isRecord = false;
+        if (end - start >= sizeof(record)) {
+            memcpy(&record, buffer + start, sizeof(record));
+            isRecord = record.type >= EL_CLOCK && record.type < EL_TYPES && record.reserved == 0
+                       && record.length <= EL_MAX_TEXT;
+        }
+
+        if (isRecord == false) {
+            // text written before the binary log started, passed through whole
+            char* newline = memchr(buffer + start, '\n', end - start);
+            if (newline == NULL && finished == false) {
+                start = end;    // a line too long for the buffer, dropped
+                continue;
+            }
+            size_t length = newline != NULL ? (size_t) (newline - buffer - start) + 1 : end - start;
+            fwrite(buffer + start, 1, length, stdout);
+            start += length;
+            continue;
+        }
+
+        if (end - start < sizeof(record) + record.length) {
+            return false;
+        }
+        size_t length = el_render(reader, &record, buffer + start + sizeof(record), line, sizeof(line));
+        fwrite(line, 1, length, stdout);
+        start += sizeof(record) + record.length;
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <limits.h>
+#include "proc_nanny_query.h"
+#include "segment_store.h"
+#include "memwatch.h"
+
+int main(int args, char* argv[]) {
+    const char* directory = getenv("PROCNANNYSEGMENTS");
+    if (directory == NULL) {
+        directory = DEFAULT_SEGMENT_DIRECTORY;
+    }
+
+    SegmentQuery query;
+    memset(&query, 0, sizeof(query));
+    bool showStats = false;
+
+    int option;
+    while ((option = getopt(args, argv, "d:f:t:n:p:ks")) != -1) {
+        switch (option) {
+            case 'd':
+                directory = optarg;
+                break;
+            case 'f':
+            case 't':
+                if (parseTime(optarg, option == 'f' ? &query.from : &query.to) == false) {
+                    printf("Error: could not read time '%s'.\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'n':
+                snprintf(query.node, sizeof(query.node), "%s", optarg);
+                break;
+            case 'p':
+                snprintf(query.program, sizeof(query.program), "%s", optarg);
+                break;
+            case 'k':
+                query.killsOnly = true;
+                break;
+            case 's':
+                showStats = true;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind != args) {
+        usage(argv[0]);
+    }
+
+    DIR* segments = opendir(directory);
+    if (segments == NULL) {
+        printf("Error: could not read segment directory %s.\n", directory);
+        exit(EXIT_FAILURE);
+    }
+    char (*names)[NAME_MAX + 1] = malloc(sizeof(*names) * MAX_SEGMENTS);
+    size_t count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(segments)) != NULL && count < MAX_SEGMENTS) {
+        if (isSegmentFile(entry->d_name)) {
+            snprintf(names[count++], NAME_MAX + 1, "%s", entry->d_name);
+        }
+    }
+    closedir(segments);
+    // segment names start with their creation time, so this is oldest first
+    qsort(names, count, sizeof(*names), &compareNames);
+
+    SegmentQueryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    char path[1024];
+    for (size_t i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+        if (ss_query(path, &query, &printRecord, NULL, &stats) == false) {
+            fprintf(stderr, "Warning: %s is not a segment, skipped.\n", path);
+        }
+    }
+    free(names);
+
+    if (showStats) {
+        fprintf(stderr, "%lu segment(s), %lu skipped whole, %lu block(s) read, %lu skipped, %llu record(s) matched\n",
+                stats.segments, stats.segmentsSkipped, stats.blocksRead, stats.blocksSkipped, stats.recordsMatched);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+void usage(const char* program) {
+    printf("Usage: %s [-d segment directory] [-f from] [-t to] [-n node] [-p program] [-k] [-s]\n", program);
+    printf("Prints matching records in the text log format. Times are epoch seconds or local\n"
+           "'YYYY-MM-DD HH:MM[:SS]'. -k keeps only kills, -s prints what was read to stderr.\n");
+    exit(EXIT_FAILURE);
+}
+
+int compareNames(const void* first, const void* second) {
+    return strcmp((const char*) first, (const char*) second);
+}
+
+bool isSegmentFile(const char* name) {
+    size_t length = strlen(name);
+    return strncmp(name, "segment-", 8) == 0 && length > 4 && strcmp(name + length - 4, ".seg") == 0;
+}
+
+bool parseTime(const char* text, time_t* result) {
+    char* end;
+    long long epoch = strtoll(text, &end, 10);
+    if (*end == '\0' && end != text) {
+        *result = (time_t) epoch;
+        return true;
+    }
+
+    const char* formats[] = {"%Y-%m-%d %H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%dT%H:%M"};
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        struct tm parsed;
+        memset(&parsed, 0, sizeof(parsed));
+        end = strptime(text, formats[i], &parsed);
+        if (end != NULL && *end == '\0') {
+            parsed.tm_isdst = -1;
+            *result = mktime(&parsed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void printRecord(const SegmentRecord* record, void* context) {
+    // the text is the log line exactly as procnanny.server wrote it
+    fwrite(record->text, 1, record->textLength, stdout);
+}
@@ -0,0 +1,33 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROC_NANNY_QUERY_H
+#define PROC_NANNY_QUERY_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "segment_store.h"
+
+#define DEFAULT_SEGMENT_DIRECTORY "./procnannyserver.segments"
+#define MAX_SEGMENTS 65536
+
+int compareNames(const void* first, const void* second);
+bool isSegmentFile(const char* name);
+bool parseTime(const char* text, time_t* result);
+void printRecord(const SegmentRecord* record, void* context);
+void usage(const char* program);
+
+#endif //PROC_NANNY_QUERY_H
@@ -21,14 +21,32 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <signal.h>
 #include <ctype.h>
 #include <time.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <netinet/in.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/un.h>
 #include "proc_nanny_server.h"
 #include "linked_list.h"
+#include "log_writer.h"
+#include "log_rotate.h"
+#include "log_format.h"
+#include "event_log.h"
+#include "log_level.h"
+#include "resolver.h"
+#include "relay.h"
+#include "compress.h"
+#include "kill_stats.h"
+#include "node_table.h"
+#include "admin.h"
+#include "shm_ring.h"
+#include "segment_store.h"
 #include "memwatch.h"
 
 bool receivedSIGHUP = false;
@@ -37,12 +55,36 @@ bool receivedSIGINT = false;
 char logLocation[512];
 char serverInfoLocation[512];
 char configFileLocation[512];
+char adminLocation[108];
 
-int numProcessesKilled = 0;
+int serverPort = PORT;
+char upstreamHost[NODE_NAME_LENGTH];
+int upstreamPort = 0;
 
 int selfPipe[2];
+int serverSocket = 0;
+
+// local clients are offered shared memory rings over this abstract socket
+int shmListener = 0;
+char shmSocketName[64];
+int shmPending[SHM_PENDING_CONNECTIONS];
+int shmPendingNext = 0;
+
+// configuration pushed down by the parent server when running as a relay
+char upstreamPending[CLIENT_BUFFER_SIZE];
+size_t upstreamPendingLength = 0;
+bool upstreamDiscarding = false;
+int upstreamConfigRemaining = 0;
+int upstreamConfigIndex = 0;
 
 ProgramConfig configLines[CONFIG_FILE_LINES];
+ClientConnection clients[MAXCLIENTS];
+unsigned long nextClientId = 1;
+
+PendingAction pendingActions[MAX_PENDING_ACTIONS];
+unsigned long nextActionId = 1;
+
+CompressionStats compressionStats;
 
 int main(int args, char* argv[]) {
 
@@ -52,11 +94,25 @@ int main(int args, char* argv[]) {
     if (signal(SIGINT, &signalHandler) == SIG_ERR)
         printf("error with catching SIGINT\n");
 
+    // a client or parent going away shows up as a failed send instead
+    signal(SIGPIPE, SIG_IGN);
 
     checkInputs(args, argv);
-    killAllProcNannys();
-    sleep(1);
-    readConfigurationFile();
+    startLogWriter();
+
+    char *procnannyLogLevel = getenv("PROCNANNYLOGLEVEL");
+    if (procnannyLogLevel != NULL && lv_configure(procnannyLogLevel) == false) {
+        LOG_WARNING(LM_CONFIG, true, "Could not read PROCNANNYLOGLEVEL '%s', using the defaults.", procnannyLogLevel);
+    }
+
+    // relays and servers on other ports share the host with another server
+    if (isRelay() == false && serverPort == PORT) {
+        killAllProcNannys();
+        sleep(1);
+    }
+    if (isRelay() == false) {
+        readConfigurationFile();
+    }
     beginProcNanny();
     cleanUp();
     exit(EXIT_SUCCESS);
@@ -113,7 +169,45 @@ void checkInputs(int args, char* argv[]) {
         snprintf(serverInfoLocation, 512, "%s", procnannyServerInfo);
     }
 
-    if (args <= 1) {
+    int option;
+    while ((option = getopt(args, argv, "p:u:")) != -1) {
+        switch (option) {
+            case 'p':
+                if (sscanf(optarg, "%d", &serverPort) != 1) {
+                    printf("Error: Failed to read given port.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'u':
+                if (sscanf(optarg, "%255[^:]:%d", upstreamHost, &upstreamPort) != 2) {
+                    printf("Error: Expected upstream server as hostname:port.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                printf("Usage: %s [-p port] [-u upstreamhost:port] [configuration file]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // servers on other ports get their own admin socket
+    char *procnannyAdmin = getenv("PROCNANNYADMIN");
+    if (procnannyAdmin != NULL) {
+        snprintf(adminLocation, sizeof(adminLocation), "%s", procnannyAdmin);
+    }
+    else if (serverPort == PORT) {
+        snprintf(adminLocation, sizeof(adminLocation), "%s", ADMIN_DEFAULT_PATH);
+    }
+    else {
+        snprintf(adminLocation, sizeof(adminLocation), "./procnannyserver.%d.sock", serverPort);
+    }
+
+    // a relay takes its configuration from the upstream server
+    if (isRelay()) {
+        return;
+    }
+
+    if (optind >= args) {
         char timebuffer[TIME_BUFFER_SIZE];
         getCurrentTime(timebuffer);
         LogMessage logMsg;
@@ -126,13 +220,13 @@ void checkInputs(int args, char* argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    if (access(argv[1], R_OK) == -1) {
+    if (access(argv[optind], R_OK) == -1) {
         char timebuffer[TIME_BUFFER_SIZE];
         getCurrentTime(timebuffer);
         LogMessage logMsg;
         snprintf(logMsg.message, LOG_MESSAGE_LENGTH,
                  "[%s] Error: Unable to read from configuration file (%s).\n",
-                 timebuffer, argv[1]);
+                 timebuffer, argv[optind]);
         FILE* log = fopen(logLocation, "a");
         fprintf(log, "%s", logMsg.message);
         fclose(log);
@@ -140,7 +234,48 @@ void checkInputs(int args, char* argv[]) {
     }
 
     // cache the location of the configuration file
-    strncpy(configFileLocation, argv[1], 512);
+    strncpy(configFileLocation, argv[optind], 512);
+}
+
+bool isRelay() {
+    return upstreamPort != 0;
+}
+
+void startLogWriter() {
+    unsigned int fsyncIntervalMs = 0;
+    char *procnannyFsync = getenv("PROCNANNYFSYNCMS");
+    if (procnannyFsync != NULL) {
+        sscanf(procnannyFsync, "%u", &fsyncIntervalMs);
+    }
+
+    LogRotateOptions rotation;
+    lr_optionsFromEnvironment(&rotation);
+    // the binary format needs the writer thread to start each file with its preamble
+    bool binary = el_requested();
+    if (binary) {
+        lw_setPreamble(&el_writePreamble);
+    }
+    if (lw_start(logLocation, fsyncIntervalMs, &rotation) == false) {
+        LOG_WARNING(LM_GENERAL, true, "Could not start the log writer thread, logging synchronously.");
+    }
+    else {
+        // every exit path drains the queue
+        atexit(&lw_stop);
+        if (binary) {
+            el_enable();
+        }
+    }
+
+    // an indexed binary copy of the log for procnanny.query
+    char *procnannySegments = getenv("PROCNANNYSEGMENTS");
+    if (procnannySegments != NULL && strlen(procnannySegments) != 0) {
+        if (ss_open(procnannySegments)) {
+            atexit(&ss_close);
+        }
+        else {
+            LOG_WARNING(LM_GENERAL, true, "Could not open the segment directory, no binary log is kept.");
+        }
+    }
 }
 
 void killAllProcNannys() {
@@ -161,7 +296,7 @@ void readConfigurationFile() {
     size_t len = 0;
     fp = fopen(configFileLocation, "r");
     if (fp == NULL) {
-        logToFile("Error", "Could not read configuration file.", true);
+        LOG_ERROR(LM_CONFIG, true, "Could not read configuration file.");
         exit(EXIT_FAILURE);
     }
 
@@ -175,11 +310,8 @@ void readConfigurationFile() {
     while (getline(&line, &len, fp) != -1) {
         int numMatched = sscanf(line, "%s %d", configLines[index].programName, &configLines[index].runtime);
         if (numMatched == 1 || numMatched > 2) {
-            LogMessage msg;
-            snprintf(msg.message, LOG_MESSAGE_LENGTH,
-                     "Expected two configuration arguments at line %d of %s.",
-                     index, configFileLocation);
-            logToFile("Error", msg.message, false);
+            LOG_ERROR(LM_CONFIG, false, "Expected two configuration arguments at line %d of %s.",
+                      index, configFileLocation);
             cleanUp();
             exit(EXIT_FAILURE);
         }
@@ -195,18 +327,16 @@ void readConfigurationFile() {
 }
 
 void beginProcNanny() {
-    List clientNames;
-    int serverSocket;
     int newSocket;
-    int clientSockets[MAXCLIENTS] = {0};
     struct sockaddr_in server;
     int max_sd;
 
     fd_set readable;
+    fd_set writable; // only admin connections and the upstream with output waiting
 
     server.sin_family = AF_INET;
     server.sin_addr.s_addr = INADDR_ANY;
-    server.sin_port = htons(PORT);
+    server.sin_port = htons((uint16_t) serverPort);
 
     // Create Socket
     serverSocket = socket(AF_INET, SOCK_STREAM, 0);
@@ -215,6 +345,10 @@ void beginProcNanny() {
         return;
     }
 
+    // allow a restarted server or relay to take the port straight back
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     // Bind
     if (bind(serverSocket, (struct sockaddr *) &server, sizeof(server)) < 0) {
         perror("Failed to bind master socket");
@@ -231,14 +365,22 @@ void beginProcNanny() {
     LogMessage msg;
     char name[64];
     gethostname(name, 64);
-    snprintf(msg.message, LOG_MESSAGE_LENGTH, "PID %d on node %s, port %d", getpid(), name, PORT);
+    snprintf(msg.message, LOG_MESSAGE_LENGTH, "PID %d on node %s, port %d", getpid(), name, serverPort);
     logToFile("procnanny server", msg.message, false);
 
     // write server information to PROCNANNYSERVERINFO
     FILE* log = fopen(serverInfoLocation, "w");
-    fprintf(log, "NODE %s PID %d PORT %d\n", name, getpid(), PORT);
+    fprintf(log, "NODE %s PID %d PORT %d\n", name, getpid(), serverPort);
     fclose(log);
 
+    if (isRelay()) {
+        if (relay_connect(upstreamHost, upstreamPort, name) == -1) {
+            LOG_ERROR(LM_CLIENTS, true, "Could not connect to upstream server %s:%d.", upstreamHost, upstreamPort);
+            exit(EXIT_FAILURE);
+        }
+        LOG_INFO(LM_CLIENTS, false, "Relaying to upstream server %s:%d.", upstreamHost, upstreamPort);
+    }
+
     // setup self pipe and have no blocking
     pipe(selfPipe);
     int flags = fcntl(selfPipe[0], F_GETFL);
@@ -248,11 +390,20 @@ void beginProcNanny() {
     flags |= O_NONBLOCK;
     fcntl(selfPipe[1], F_SETFL, flags);
 
-    ll_init(&clientNames, sizeof(ClientName), NULL);
+    // reverse lookups happen on a helper thread, clients stay numeric until then
+    rs_start();
+    ks_init();
+    nt_init();
+
+    if (admin_open(adminLocation) == false) {
+        LOG_WARNING(LM_GENERAL, true, "Could not open admin socket %s.", adminLocation);
+    }
+    openSharedMemoryListener();
 
     // Accept
     while (1) {
         FD_ZERO(&readable);
+        FD_ZERO(&writable);
         FD_SET(serverSocket, &readable);
         max_sd = serverSocket;
 
@@ -260,10 +411,27 @@ void beginProcNanny() {
         if (selfPipe[0] > max_sd)
             max_sd = selfPipe[0];
 
+        int upstreamFd = relay_socket();
+        if (upstreamFd > 0) {
+            FD_SET(upstreamFd, &readable);
+            if (relay_hasOutput()) {
+                FD_SET(upstreamFd, &writable);
+            }
+            if (upstreamFd > max_sd)
+                max_sd = upstreamFd;
+        }
+
+        int resolverFd = rs_notifyFd();
+        if (resolverFd != -1) {
+            FD_SET(resolverFd, &readable);
+            if (resolverFd > max_sd)
+                max_sd = resolverFd;
+        }
+
         //add child sockets to set
         for (int i = 0 ; i < MAXCLIENTS ; i++)
         {
-            int sd = clientSockets[i];
+            int sd = clients[i].socket;
             if(sd > 0) {
                 FD_SET(sd, &readable);
             }
@@ -273,63 +441,130 @@ void beginProcNanny() {
             }
         }
 
-        int activity = select(max_sd + 1 , &readable , NULL , NULL , NULL);
+        max_sd = admin_addToSet(&readable, &writable, max_sd);
+
+        if (shmListener > 0) {
+            FD_SET(shmListener, &readable);
+            if (shmListener > max_sd)
+                max_sd = shmListener;
+        }
+        for (int i = 0; i < SHM_PENDING_CONNECTIONS; i++) {
+            if (shmPending[i] > 0) {
+                FD_SET(shmPending[i], &readable);
+                if (shmPending[i] > max_sd)
+                    max_sd = shmPending[i];
+            }
+        }
+
+        // a ring with data left in it must not wait for its eventfd
+        bool ringsPending = false;
+        for (int i = 0; i < MAXCLIENTS; i++) {
+            if (clients[i].socket > 0 && sr_isOpen(&clients[i].toServer)) {
+                int ringFd = sr_notifyFd(&clients[i].toServer);
+                FD_SET(ringFd, &readable);
+                if (ringFd > max_sd)
+                    max_sd = ringFd;
+                if (sr_isEmpty(&clients[i].toServer) == false)
+                    ringsPending = true;
+            }
+        }
+
+        // wake up in time to send a relay batch that is going stale, or to
+        // give up on an action that has not been acknowledged
+        struct timeval timeout;
+        struct timeval* tv = NULL;
+        long waitMs = relay_msUntilFlush();
+        long actionMs = msUntilActionTimeout();
+        if (actionMs >= 0 && (waitMs < 0 || actionMs < waitMs)) {
+            waitMs = actionMs;
+        }
+        long segmentMs = ss_msUntilFlush();
+        if (segmentMs >= 0 && (waitMs < 0 || segmentMs < waitMs)) {
+            waitMs = segmentMs;
+        }
+        if (ringsPending) {
+            waitMs = 0;
+        }
+        if (waitMs >= 0) {
+            timeout.tv_sec = waitMs / 1000;
+            timeout.tv_usec = (waitMs % 1000) * 1000;
+            tv = &timeout;
+        }
+
+        int activity = select(max_sd + 1 , &readable , &writable , NULL , tv);
 
         if (activity == -1) {
             continue;
         }
 
+        if (relay_flushIfStale() == false) {
+            lostUpstream();
+        }
+        ss_flushIfStale();
+        expireActions();
+
+        if (upstreamFd > 0 && FD_ISSET(upstreamFd, &writable) && relay_sendOutput() == false) {
+            lostUpstream();
+        }
+        if (relay_socket() > 0 && FD_ISSET(upstreamFd, &readable)) {
+            readFromUpstream();
+        }
+
+        admin_handle(&readable, &writable, &handleAdminRequest);
+
+        for (int i = 0; i < SHM_PENDING_CONNECTIONS; i++) {
+            if (shmPending[i] > 0 && FD_ISSET(shmPending[i], &readable)) {
+                receiveSharedMemory(shmPending[i]);
+                shmPending[i] = 0;
+            }
+        }
+        if (shmListener > 0 && FD_ISSET(shmListener, &readable)) {
+            acceptSharedMemory();
+        }
+
+        for (int i = 0; i < MAXCLIENTS; i++) {
+            if (clients[i].socket > 0 && sr_isOpen(&clients[i].toServer)) {
+                readFromRing(&clients[i]);
+            }
+        }
+
+        if (resolverFd != -1 && FD_ISSET(resolverFd, &readable)) {
+            ResolverResult result;
+            while (rs_nextResult(&result)) {
+                for (int i = 0; i < MAXCLIENTS; i++) {
+                    if (clients[i].socket > 0 && clients[i].id == result.tag) {
+                        strncpy(clients[i].host, result.name, NODE_NAME_LENGTH);
+                    }
+                }
+            }
+        }
+
         // check the self pipe trick
         if (FD_ISSET(selfPipe[0], &readable)) {
             char ch;
             while(read(selfPipe[0], &ch, 1) != -1) {}
 
+            if (receivedSIGHUP && isRelay()) {
+                receivedSIGHUP = false;
+                LOG_INFO(LM_CONFIG, true, "Caught SIGHUP. Relays take their configuration from upstream, ignored.");
+            }
+
             if (receivedSIGHUP) {
                 receivedSIGHUP = false;
                 readConfigurationFile();
 
                 for (int i = 0; i < MAXCLIENTS; i++) {
-                    int sd = clientSockets[i];
-                    if (sd == 0) {
-                        continue;
-                    }
-
-                    for(int j = 0; j < CONFIG_FILE_LINES; j++) {
-                        if (strlen(configLines[j].programName) != 0) {
-                            char buffer[1024];
-                            snprintf(buffer, 1024, "%s %d\n", configLines[j].programName, configLines[j].runtime);
-                            send(newSocket, buffer, strlen(buffer), 0);
-                        }
+                    if (clients[i].socket > 0) {
+                        sendConfiguration(&clients[i]);
                     }
                 }
 
-                LogMessage msg;
-                snprintf(msg.message, LOG_MESSAGE_LENGTH,
-                         "Caught SIGHUP. Configuration file '%s' re-read.",
-                         configFileLocation);
-                char type[] = "Info";
-                logToFile(type, msg.message, true);
+                LOG_INFO(LM_CONFIG, true, "Caught SIGHUP. Configuration file '%s' re-read.", configFileLocation);
             }
 
             if (receivedSIGINT) {
                 receivedSIGINT = false;
-                cleanUp();
-                ll_free(&clientNames);
-                for (int i = 0; i < MAXCLIENTS; i++) {
-                    int sd = clientSockets[i];
-                    char msg[] = "___KILL___ 0\n";
-                    send(sd, msg, strlen(msg), 0);
-                    close(sd);
-                }
-                LogMessage msg;
-                snprintf(msg.message, LOG_MESSAGE_LENGTH,
-                         "Caught SIGINT. Exiting cleanly. %d process(es) killed.",
-                         numProcessesKilled);
-                logToFile("Info", msg.message, true);
-                close(selfPipe[0]);
-                close(selfPipe[1]);
-                close(serverSocket);
-                exit(EXIT_SUCCESS);
+                shutdownServer("Caught SIGINT");
             }
         }
 
@@ -342,25 +577,35 @@ void beginProcNanny() {
                 exit(EXIT_FAILURE);
             }
 
-            struct hostent* host = gethostbyaddr((const void*)&client.sin_addr, sizeof(struct in_addr), AF_INET);
-            ClientName name;
-            strncpy(name.name, host->h_name, strlen(host->h_name));
-            ll_add(&clientNames, &name);
-
             //add new socket
+            ClientConnection* added = NULL;
             for (int i = 0; i < MAXCLIENTS; i++) {
-                if( clientSockets[i] == 0 ) {
-                    clientSockets[i] = newSocket;
+                if( clients[i].socket == 0 ) {
+                    added = &clients[i];
+                    clients[i].socket = newSocket;
+                    clients[i].id = nextClientId++;
+                    clients[i].pendingLength = 0;
+                    clients[i].frame = NULL;
+                    clients[i].isRelay = false;
+                    strcpy(clients[i].node, "");
+                    inet_ntop(AF_INET, &client.sin_addr, clients[i].host, NODE_NAME_LENGTH);
+                    rs_lookup(client.sin_addr, clients[i].id, clients[i].host);
+                    clients[i].shmPendingLength = 0;
+                    strcpy(clients[i].shmToken, "");
                     break;
                 }
             }
 
-            // send the program configuration to the client
-            for(int i = 0; i < CONFIG_FILE_LINES; i++) {
-                if (strlen(configLines[i].programName) != 0) {
-                    char buffer[1024];
-                    snprintf(buffer, 1024, "%s %d\n", configLines[i].programName, configLines[i].runtime);
-                    send(newSocket, buffer, strlen(buffer), 0);
+            if (added == NULL) {
+                LOG_WARNING(LM_CLIENTS, false, "Too many clients, connection refused.");
+                close(newSocket);
+            }
+            else {
+                // send the program configuration to the client
+                offerCompression(added);
+                sendConfiguration(added);
+                if (added->socket > 0) {
+                    offerSharedMemory(added, client.sin_addr);
                 }
             }
         }
@@ -368,29 +613,1025 @@ void beginProcNanny() {
         else {
             //read data from the client
             for (int i = 0; i < MAXCLIENTS; i++) {
-                int sd = clientSockets[i];
-                ssize_t valread;
-                char buffer[1024];
-
-                if (FD_ISSET(sd, &readable)) {
-                    // Check if client socket is closing
-                    if ((valread = read(sd, buffer, 1024)) == 0) {
-                        close(sd);
-                        clientSockets[i] = 0;
-                    }
-
-                    // log the message
-                    else {
-                        buffer[valread] = '\0';
-                        logToFileSimple(buffer);
-                    }
+                if (clients[i].socket > 0 && FD_ISSET(clients[i].socket, &readable)) {
+                    readFromClient(&clients[i]);
                 }
             }
         }
     }
 }
 
+void readFromClient(ClientConnection* client) {
+    ssize_t valread = read(client->socket, client->pending + client->pendingLength,
+                           CLIENT_BUFFER_SIZE - 1 - client->pendingLength);
+
+    // Check if client socket is closing
+    if (valread <= 0) {
+        dropClient(client);
+        return;
+    }
+    client->pendingLength = consumePending(client, client->pending, client->pendingLength + valread);
+}
+
+void readFromRing(ClientConnection* client) {
+    // the same stream as the socket would carry, drained until empty
+    size_t valread;
+    while ((valread = sr_read(&client->toServer, client->shmPending + client->shmPendingLength,
+                              CLIENT_BUFFER_SIZE - 1 - client->shmPendingLength)) > 0) {
+        client->shmPendingLength = consumePending(client, client->shmPending, client->shmPendingLength + valread);
+    }
+}
+
+size_t consumePending(ClientConnection* client, char* pending, size_t length) {
+    size_t used = consumeClientInput(client, pending, length);
+    size_t remaining = length - used;
+    if (remaining == CLIENT_BUFFER_SIZE - 1) {
+        // no newline in a full buffer, log what we have rather than stall
+        handleClientLine(client, pending + used, remaining);
+        remaining = 0;
+    }
+    memmove(pending, pending + used, remaining);
+    return remaining;
+}
+
+void dropClient(ClientConnection* client) {
+    if (strlen(client->node) != 0) {
+        if (client->isRelay) {
+            // every node behind the relay goes with it
+            nt_forEach(&forwardRelayedDisconnect, client->node);
+            nt_relayDisconnected(client->node);
+        }
+        else {
+            nt_disconnected(client->node);
+            forwardNodeState(client->node, -1);
+        }
+    }
+    closeClient(client);
+}
+
+void closeClient(ClientConnection* client) {
+    close(client->socket);
+    client->socket = 0;
+    client->pendingLength = 0;
+    if (client->frame != NULL) {
+        free(client->frame);
+        client->frame = NULL;
+    }
+    sr_close(&client->toServer);
+    sr_close(&client->toClient);
+    client->shmPendingLength = 0;
+}
+
+void offerCompression(ClientConnection* client) {
+    char *procnannyCompress = getenv("PROCNANNYCOMPRESS");
+    if (procnannyCompress != NULL && strcmp(procnannyCompress, "0") == 0) {
+        return;
+    }
+    char offer[64];
+    snprintf(offer, sizeof(offer), "%s %d\n", PROTOCOL_COMPRESS, LZ_DICTIONARY_VERSION);
+    sendToClient(client, offer, strlen(offer));
+}
+
+void openSharedMemoryListener() {
+    char *procnannyShm = getenv("PROCNANNYSHM");
+    if (procnannyShm != NULL && strcmp(procnannyShm, "0") == 0) {
+        return;
+    }
+
+    // abstract, so nothing is left on disk and no path has to be agreed on
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(shmSocketName, sizeof(shmSocketName), "procnanny.shm.%d", getpid());
+    memcpy(address.sun_path + 1, shmSocketName, strlen(shmSocketName));
+    socklen_t length = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + 1 + strlen(shmSocketName));
+
+    shmListener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (shmListener < 0 || bind(shmListener, (struct sockaddr*) &address, length) < 0
+        || listen(shmListener, MAXCLIENTS) < 0) {
+        if (shmListener >= 0) {
+            close(shmListener);
+        }
+        shmListener = 0;
+        LOG_WARNING(LM_CLIENTS, false, "Could not open the shared memory socket, local clients will use TCP.");
+    }
+}
+
+void offerSharedMemory(ClientConnection* client, struct in_addr peer) {
+    if (shmListener == 0) {
+        return;
+    }
+    // same host when the client reached us from the address it connected to
+    struct sockaddr_in local;
+    socklen_t length = sizeof(local);
+    if (getsockname(client->socket, (struct sockaddr*) &local, &length) == -1
+        || (local.sin_addr.s_addr != peer.s_addr && (ntohl(peer.s_addr) >> 24) != 127)) {
+        return;
+    }
+
+    // the socket is open to every local user, only the client we told may use it
+    unsigned long long nonce = 0;
+    int random = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (random == -1 || read(random, &nonce, sizeof(nonce)) != sizeof(nonce)) {
+        if (random != -1) {
+            close(random);
+        }
+        return;
+    }
+    close(random);
+    snprintf(client->shmToken, PROTOCOL_SHM_TOKEN_LENGTH, "%lu-%016llx", client->id, nonce);
+
+    char offer[sizeof(shmSocketName) + PROTOCOL_SHM_TOKEN_LENGTH + 32];
+    int offerLength = snprintf(offer, sizeof(offer), "%s %s %s\n", PROTOCOL_SHM, shmSocketName, client->shmToken);
+    sendToClient(client, offer, (size_t) offerLength);
+}
+
+void acceptSharedMemory() {
+    int sd = accept4(shmListener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (sd < 0) {
+        return;
+    }
+    // the descriptors are read once they arrive, a connection that never
+    // sends any loses its place to later ones
+    if (shmPending[shmPendingNext] > 0) {
+        close(shmPending[shmPendingNext]);
+    }
+    shmPending[shmPendingNext] = sd;
+    shmPendingNext = (shmPendingNext + 1) % SHM_PENDING_CONNECTIONS;
+}
+
+void receiveSharedMemory(int sd) {
+    char token[PROTOCOL_SHM_TOKEN_LENGTH];
+    int fds[SHM_RING_FDS];
+    bool received = sr_receiveFds(sd, token, sizeof(token), fds);
+    close(sd);
+    if (received == false) {
+        return;
+    }
+
+    ClientConnection* client = NULL;
+    for (int i = 0; i < MAXCLIENTS && client == NULL; i++) {
+        if (clients[i].socket > 0 && strlen(clients[i].shmToken) != 0 && strcmp(clients[i].shmToken, token) == 0) {
+            client = &clients[i];
+        }
+    }
+    if (client == NULL) {
+        for (int i = 0; i < SHM_RING_FDS; i++) {
+            close(fds[i]);
+        }
+        return;
+    }
+    strcpy(client->shmToken, "");
+
+    if (sr_attach(&client->toServer, fds[0], fds[1]) == false) {
+        close(fds[2]);
+        close(fds[3]);
+        return;
+    }
+    if (sr_attach(&client->toClient, fds[2], fds[3]) == false) {
+        sr_close(&client->toServer);
+        return;
+    }
+    LOG_INFO(LM_CLIENTS, false, "Client %s switched to shared memory.",
+             strlen(client->node) != 0 ? client->node : client->host);
+}
+
+bool sendToClient(ClientConnection* client, const char* data, size_t length) {
+    if (client->socket <= 0) {
+        return false;
+    }
+    // never waits, a client with no room for a message is not reading any more
+    bool sent;
+    if (sr_isOpen(&client->toClient)) {
+        sent = sr_write(&client->toClient, data, length) == length;
+    }
+    else {
+        sent = send(client->socket, data, length, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t) length;
+    }
+    if (sent == false) {
+        LOG_WARNING(LM_CLIENTS, false, "Client %s stopped reading, disconnected.",
+                    strlen(client->node) != 0 ? client->node : client->host);
+        dropClient(client);
+    }
+    return sent;
+}
+
+size_t consumeClientInput(ClientConnection* client, char* data, size_t length) {
+    size_t pos = 0;
+    size_t batchLength = strlen(PROTOCOL_BATCH);
+    while (pos < length) {
+        // the body of a compressed batch, which may span several reads
+        if (client->frame != NULL) {
+            size_t copy = client->frameLength - client->frameReceived;
+            if (copy > length - pos) {
+                copy = length - pos;
+            }
+            memcpy(client->frame + client->frameReceived, data + pos, copy);
+            client->frameReceived += copy;
+            pos += copy;
+            if (client->frameReceived == client->frameLength) {
+                handleBatch(client);
+                free(client->frame);
+                client->frame = NULL;
+            }
+            continue;
+        }
+
+        char* line = data + pos;
+        char* newline = memchr(line, '\n', length - pos);
+        if (newline == NULL) {
+            break;
+        }
+        size_t lineLength = newline - line + 1;
+        pos += lineLength;
+
+        if (strncmp(line, PROTOCOL_BATCH, batchLength) == 0) {
+            size_t rawLength = 0;
+            size_t compressedLength = 0;
+            int dictionary = 0;
+            if (sscanf(line + batchLength, "%zu %zu %d", &rawLength, &compressedLength, &dictionary) < 2
+                || rawLength > PROTOCOL_BATCH_MAX || compressedLength > lz_compressBound(PROTOCOL_BATCH_MAX)) {
+                LOG_WARNING(LM_CLIENTS, false, "Dropped a malformed batch header.");
+                continue;
+            }
+            client->frame = malloc(compressedLength > 0 ? compressedLength : 1);
+            client->frameLength = compressedLength;
+            client->frameReceived = 0;
+            client->frameRawLength = rawLength;
+            client->frameDictionary = dictionary;
+            if (compressedLength == 0) {
+                free(client->frame);
+                client->frame = NULL;
+            }
+            continue;
+        }
+
+        handleClientLine(client, line, lineLength);
+    }
+    return pos;
+}
+
+void handleBatch(ClientConnection* client) {
+    static char raw[PROTOCOL_BATCH_MAX];
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    ssize_t rawLength = -1;
+    if (client->frameDictionary == 0) {
+        rawLength = lz_decompress(client->frame, client->frameLength, raw, sizeof(raw));
+    }
+    else if (client->frameDictionary == LZ_DICTIONARY_VERSION) {
+        // sized to the announced length, the dictionary copy is made per call
+        rawLength = lz_decompressWithDictionary(client->frame, client->frameLength, raw, client->frameRawLength);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    compressionStats.decompressNs += (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+
+    if (rawLength < 0 || (size_t) rawLength != client->frameRawLength) {
+        LOG_WARNING(LM_CLIENTS, false, "Dropped a corrupt batch from %s.", client->node);
+        return;
+    }
+    compressionStats.batches++;
+    compressionStats.rawBytes += rawLength;
+    compressionStats.compressedBytes += client->frameLength;
+
+    char* line = raw;
+    char* rawEnd = raw + rawLength;
+    char* newline;
+    while ((newline = memchr(line, '\n', rawEnd - line)) != NULL) {
+        handleClientLine(client, line, newline - line + 1);
+        line = newline + 1;
+    }
+}
+
+void handleClientLine(ClientConnection* client, char* line, size_t length) {
+    size_t nodeLength = strlen(PROTOCOL_NODE);
+    if (strncmp(line, PROTOCOL_NODE, nodeLength) == 0) {
+        char* name = line + nodeLength;
+        char* nameEnd = line + length;
+        while (name < nameEnd && isspace(*name)) {
+            name++;
+        }
+        while (nameEnd > name && isspace(*(nameEnd - 1))) {
+            nameEnd--;
+        }
+        snprintf(client->node, NODE_NAME_LENGTH, "%.*s", (int) (nameEnd - name), name);
+        nt_connected(client->node, "");
+        return;
+    }
+
+    size_t monitoringLength = strlen(PROTOCOL_MONITORING);
+    if (strncmp(line, PROTOCOL_MONITORING, monitoringLength) == 0) {
+        handleMonitoringReport(client, line + monitoringLength, length - monitoringLength);
+        return;
+    }
+
+    size_t killedLength = strlen(PROTOCOL_KILLED);
+    if (strncmp(line, PROTOCOL_KILLED, killedLength) == 0) {
+        handleKillEvent(client, line + killedLength, length - killedLength);
+        return;
+    }
+
+    size_t ackLength = strlen(PROTOCOL_ACK);
+    if (strncmp(line, PROTOCOL_ACK, ackLength) == 0) {
+        handleAck(client, line + ackLength, length - ackLength);
+        return;
+    }
+
+    size_t relayLength = strlen(PROTOCOL_RELAY);
+    if (strncmp(line, PROTOCOL_RELAY, relayLength) == 0) {
+        client->isRelay = true;
+        snprintf(client->node, NODE_NAME_LENGTH, "%.*s", (int) (length - relayLength), line + relayLength);
+        trimWhitespace(client->node);
+        return;
+    }
+
+    // put the client's hostname back in place of the marker
+    char expanded[LOG_MESSAGE_LENGTH + NODE_NAME_LENGTH];
+    size_t used = 0;
+    size_t nodeNameLength = strlen(client->node);
+    for (size_t i = 0; i < length && used < sizeof(expanded) - 1; i++) {
+        if (line[i] == PROTOCOL_NODE_MARKER[0]) {
+            size_t copy = nodeNameLength;
+            if (copy > sizeof(expanded) - 1 - used) {
+                copy = sizeof(expanded) - 1 - used;
+            }
+            memcpy(expanded + used, client->node, copy);
+            used += copy;
+        }
+        else {
+            expanded[used++] = line[i];
+        }
+    }
+    expanded[used] = '\0';
+    recordClientLog(client, expanded, used);
+}
+
+void handleKillEvent(ClientConnection* client, const char* fields, size_t length) {
+    char event[LOG_MESSAGE_LENGTH];
+    snprintf(event, sizeof(event), "%.*s", (int) length, fields);
+
+    long when = 0;
+    int pid = 0;
+    unsigned int runtime = 0;
+    char program[PROGRAM_NAME_LENGTH];
+    char node[NODE_NAME_LENGTH];
+    int matched = sscanf(event, "%ld %d %u %127s %255s", &when, &pid, &runtime, program, node);
+    if (matched < 4) {
+        LOG_WARNING(LM_MONITOR, false, "Dropped a malformed kill event.");
+        return;
+    }
+    // any peer can send these, a time nowhere near ours is not a real kill
+    long now = (long) time(NULL);
+    if (when < 0 || when < now - KILL_EVENT_MAX_SKEW_S || when > now + KILL_EVENT_MAX_SKEW_S) {
+        LOG_WARNING(LM_MONITOR, false, "Dropped a kill event stamped %ld, %ld seconds from this server's clock.",
+                    when, when - now);
+        return;
+    }
+    // events forwarded by a relay name their node, direct clients do not
+    if (matched == 4) {
+        snprintf(node, NODE_NAME_LENGTH, "%s", client->node);
+    }
+
+    ks_recordKill(node, program, (time_t) when);
+
+    char record[LOG_MESSAGE_LENGTH + NODE_NAME_LENGTH];
+    if (relay_socket() > 0) {
+        int recordLength = snprintf(record, sizeof(record), "%s %ld %d %u %s %s\n",
+                                    PROTOCOL_KILLED, when, pid, runtime, program, node);
+        if (relay_append(record, (size_t) recordLength)) {
+            return;
+        }
+        lostUpstream();
+    }
+
+    // counted and stored whatever the level, so KILLS and procnanny.query -k
+    // answer the same however much is written to the log
+    bool logged = LOG_ENABLED(LV_ACTION, LM_MONITOR);
+    if (logged && el_enabled()) {
+        char binary[sizeof(EventRecord) * 3 + PROGRAM_NAME_LENGTH + NODE_NAME_LENGTH];
+        lw_write(binary, el_event(binary, sizeof(binary), EL_KILL, (time_t) when, pid, program, node, runtime));
+    }
+    bool textLogged = logged && el_enabled() == false;
+    if (textLogged == false && ss_isOpen() == false) {
+        return;
+    }
+
+    char timebuffer[TIME_BUFFER_SIZE];
+    formatTime((time_t) when, timebuffer);
+    if (runtime == 0) {
+        // killed by a KILL action rather than a timer
+        snprintf(record, sizeof(record), "[%s] Action: PID %d (%s) on %s killed on request.\n",
+                 timebuffer, pid, program, node);
+    }
+    else {
+        snprintf(record, sizeof(record), "[%s] Action: PID %d (%s) on %s killed after exceeding %u seconds.\n",
+                 timebuffer, pid, program, node, runtime);
+    }
+    if (ss_isOpen()) {
+        ss_append(SS_KIND_KILL, (time_t) when, node, program, record, strlen(record));
+    }
+    if (textLogged) {
+        logToFileSimple(record);
+    }
+}
+
+void handleAck(ClientConnection* client, const char* fields, size_t length) {
+    char ack[LOG_MESSAGE_LENGTH];
+    snprintf(ack, sizeof(ack), "%.*s", (int) length, fields);
+
+    unsigned long id = 0;
+    int count = 0;
+    char node[NODE_NAME_LENGTH];
+    int matched = sscanf(ack, "%lu %d %255s", &id, &count, node);
+    if (matched < 2) {
+        return;
+    }
+    // acknowledgements forwarded by a relay name their node, direct clients do not
+    if (matched == 2) {
+        snprintf(node, NODE_NAME_LENGTH, "%s", client->node);
+    }
+
+    PendingAction* action = NULL;
+    for (int i = 0; i < MAX_PENDING_ACTIONS && action == NULL; i++) {
+        if (pendingActions[i].id == id) {
+            action = &pendingActions[i];
+        }
+    }
+    if (action == NULL) {
+        // an action from further up, pass the answer straight back
+        if (relay_socket() > 0) {
+            char record[NODE_NAME_LENGTH + 64];
+            int recordLength = snprintf(record, sizeof(record), "%s %lu %d %s\n", PROTOCOL_ACK, id, count, node);
+            if (relay_append(record, (size_t) recordLength) == false || relay_flush() == false) {
+                lostUpstream();
+            }
+        }
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long latencyNs = (unsigned long long) (now.tv_sec - action->sent.tv_sec) * 1000000000ULL
+                                   + now.tv_nsec - action->sent.tv_nsec;
+    action->acknowledged++;
+    action->count += count > 0 ? count : 0;
+    action->totalLatencyNs += latencyNs;
+    if (latencyNs > action->maxLatencyNs) {
+        action->maxLatencyNs = latencyNs;
+    }
+
+    AdminConnection* connection = admin_find(action->adminId);
+    if (connection != NULL) {
+        admin_reply(connection, "%s count=%d latency_us=%llu", node, count, latencyNs / 1000);
+    }
+    if (action->acknowledged >= action->expected) {
+        finishAction(action, false);
+    }
+}
+
+void handleMonitoringReport(ClientConnection* client, const char* fields, size_t length) {
+    char report[LOG_MESSAGE_LENGTH];
+    snprintf(report, sizeof(report), "%.*s", (int) length, fields);
+
+    int monitored = 0;
+    char node[NODE_NAME_LENGTH];
+    int matched = sscanf(report, "%d %255s", &monitored, node);
+    if (matched < 1) {
+        return;
+    }
+
+    // reports forwarded by a relay name their node, direct clients do not
+    if (matched == 1) {
+        nt_setMonitored(client->node, "", monitored);
+        forwardNodeState(client->node, monitored);
+    }
+    else if (monitored < 0) {
+        nt_disconnected(node);
+        forwardNodeState(node, monitored);
+    }
+    else {
+        nt_setMonitored(node, client->node, monitored);
+        forwardNodeState(node, monitored);
+    }
+}
+
+void forwardNodeState(const char* node, int monitored) {
+    if (relay_socket() == 0) {
+        return;
+    }
+    char record[NODE_NAME_LENGTH + 64];
+    int recordLength = snprintf(record, sizeof(record), "%s %d %s\n", PROTOCOL_MONITORING, monitored, node);
+    if (relay_append(record, (size_t) recordLength) == false) {
+        lostUpstream();
+    }
+}
+
+void forwardRelayedDisconnect(const NodeState* state, void* via) {
+    if (state->connected && strcmp(state->via, (const char*) via) == 0) {
+        forwardNodeState(state->node, -1);
+    }
+}
+
+void recordClientLog(ClientConnection* client, const char* record, size_t length) {
+    if (relay_socket() > 0) {
+        if (relay_append(record, length)) {
+            return;
+        }
+        lostUpstream();
+    }
+
+    // clients quote the program they are talking about, relays have already
+    // put their node's name into the text so only direct clients are known
+    char program[PROGRAM_NAME_LENGTH] = "";
+    const char* quote = memchr(record, '\'', length);
+    if (quote != NULL) {
+        const char* closing = memchr(quote + 1, '\'', record + length - quote - 1);
+        if (closing != NULL && closing - quote - 1 < PROGRAM_NAME_LENGTH) {
+            snprintf(program, sizeof(program), "%.*s", (int) (closing - quote - 1), quote + 1);
+        }
+    }
+    ss_append(SS_KIND_LOG, time(NULL), client->isRelay ? "" : client->node, program, record, length);
+    logToFileSimple(record);
+}
+
+void lostUpstream() {
+    if (relay_socket() == 0) {
+        return;
+    }
+    relay_close();
+    LOG_WARNING(LM_CLIENTS, true, "Lost connection to upstream server, logging locally.");
+}
+
+void readFromUpstream() {
+    int upstream = relay_socket();
+    ssize_t valread = read(upstream, upstreamPending + upstreamPendingLength,
+                           CLIENT_BUFFER_SIZE - 1 - upstreamPendingLength);
+    if (valread <= 0) {
+        lostUpstream();
+        return;
+    }
+    upstreamPendingLength += valread;
+    upstreamPending[upstreamPendingLength] = '\0';
+
+    char* line = upstreamPending;
+    char* newline;
+    if (upstreamDiscarding) {
+        // still inside an over-long line, drop it up to its newline
+        if ((newline = strchr(line, '\n')) == NULL) {
+            upstreamPendingLength = 0;
+            return;
+        }
+        line = newline + 1;
+        upstreamDiscarding = false;
+    }
+    while ((newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        if (strncmp(line, PROTOCOL_KILL, strlen(PROTOCOL_KILL)) == 0) {
+            shutdownServer("Upstream server exited");
+        }
+        else if (strncmp(line, PROTOCOL_ACTION, strlen(PROTOCOL_ACTION)) == 0) {
+            // hand it to whichever of our nodes are targeted, acknowledgements
+            // find their own way back up
+            unsigned long id = 0;
+            char targets[CLIENT_BUFFER_SIZE];
+            if (sscanf(line + strlen(PROTOCOL_ACTION), "%lu %4095s", &id, targets) == 2) {
+                char action[CLIENT_BUFFER_SIZE + 1];
+                snprintf(action, sizeof(action), "%s\n", line);
+                dispatchAction(action, targets);
+            }
+        }
+        else if (strncmp(line, PROTOCOL_COMPRESS, strlen(PROTOCOL_COMPRESS)) == 0) {
+            char *procnannyCompress = getenv("PROCNANNYCOMPRESS");
+            int version = 0;
+            sscanf(line + strlen(PROTOCOL_COMPRESS), "%d", &version);
+            if (procnannyCompress == NULL || strcmp(procnannyCompress, "0") != 0) {
+                relay_useDictionary(version);
+            }
+        }
+        else if (strncmp(line, PROTOCOL_CONFIG, strlen(PROTOCOL_CONFIG)) == 0) {
+            upstreamConfigRemaining = 0;
+            sscanf(line + strlen(PROTOCOL_CONFIG), "%d", &upstreamConfigRemaining);
+            upstreamConfigIndex = 0;
+            for (int i = 0; i < CONFIG_FILE_LINES; i++) {
+                configLines[i].runtime = 0;
+                strcpy(configLines[i].programName, "");
+            }
+            if (upstreamConfigRemaining == 0) {
+                forwardUpstreamConfiguration();
+            }
+        }
+        else if (upstreamConfigRemaining > 0) {
+            if (upstreamConfigIndex < CONFIG_FILE_LINES
+                && sscanf(line, "%127s %u", configLines[upstreamConfigIndex].programName,
+                          &configLines[upstreamConfigIndex].runtime) == 2) {
+                upstreamConfigIndex++;
+            }
+            upstreamConfigRemaining--;
+            if (upstreamConfigRemaining == 0) {
+                forwardUpstreamConfiguration();
+            }
+        }
+        line = newline + 1;
+    }
+
+    size_t remaining = upstreamPending + upstreamPendingLength - line;
+    if (remaining == CLIENT_BUFFER_SIZE - 1) {
+        // no newline in a full buffer, nothing upstream sends is that long
+        LOG_WARNING(LM_CLIENTS, false, "Discarding over-long line from upstream server.");
+        upstreamDiscarding = true;
+        remaining = 0;
+    }
+    memmove(upstreamPending, line, remaining);
+    upstreamPendingLength = remaining;
+}
+
+void forwardUpstreamConfiguration() {
+    // the whole configuration has arrived, hand it down to every client
+    for (int i = 0; i < MAXCLIENTS; i++) {
+        if (clients[i].socket > 0) {
+            sendConfiguration(&clients[i]);
+        }
+    }
+    LOG_INFO(LM_CONFIG, false, "Configuration received from upstream server.");
+}
+
+void sendConfiguration(ClientConnection* client) {
+    char buffer[CONFIG_FILE_LINES * (PROGRAM_NAME_LENGTH + 16) + 32];
+    int lines = 0;
+    for (int i = 0; i < CONFIG_FILE_LINES; i++) {
+        if (strlen(configLines[i].programName) != 0) {
+            lines++;
+        }
+    }
+
+    // one send for the whole configuration
+    size_t used = snprintf(buffer, sizeof(buffer), "%s %d\n", PROTOCOL_CONFIG, lines);
+    for (int i = 0; i < CONFIG_FILE_LINES; i++) {
+        if (strlen(configLines[i].programName) != 0) {
+            used += snprintf(buffer + used, sizeof(buffer) - used, "%s %d\n",
+                             configLines[i].programName, configLines[i].runtime);
+        }
+    }
+    sendToClient(client, buffer, used);
+}
+
+void shutdownServer(const char* reason) {
+    cleanUp();
+    for (int i = 0; i < MAXCLIENTS; i++) {
+        if (clients[i].socket > 0) {
+            char msg[] = PROTOCOL_KILL " 0\n";
+            if (sendToClient(&clients[i], msg, strlen(msg))) {
+                closeClient(&clients[i]);
+            }
+        }
+    }
+    LOG_INFO(LM_GENERAL, true, "%s. Exiting cleanly. %llu process(es) killed.", reason, ks_total());
+    ks_forEach(&logKillCounter, NULL);
+
+    LogWriterStats stats;
+    lw_getStats(&stats);
+    LOG_INFO(LM_STATS, false,
+             "Log writer: %llu record(s) in %llu batch(es), queue depth %zu (peak %zu), "
+             "flush latency avg %llu us max %llu us, %llu fsync(s).",
+             stats.recordsWritten, stats.batchesWritten, stats.queueDepth, stats.peakQueueDepth,
+             stats.batchesWritten ? stats.totalFlushNs / stats.batchesWritten / 1000 : 0,
+             stats.maxFlushNs / 1000, stats.fsyncs);
+
+    if (compressionStats.batches > 0) {
+        LOG_INFO(LM_STATS, false,
+                 "Compression: %llu batch(es) received, %llu bytes compressed to %llu, %llu us decompressing.",
+                 compressionStats.batches, compressionStats.rawBytes, compressionStats.compressedBytes,
+                 compressionStats.decompressNs / 1000);
+    }
+
+    if (relay_socket() > 0) {
+        if (relay_flush()) {
+            relay_drain();
+        }
+        RelayStats relayStats;
+        relay_getStats(&relayStats);
+        LOG_INFO(LM_STATS, false, "Relay: %llu batch(es) sent upstream, %llu bytes compressed to %llu.",
+                 relayStats.batches, relayStats.rawBytes, relayStats.compressedBytes);
+        relay_close();
+    }
+
+    admin_close();
+    if (shmListener > 0) {
+        close(shmListener);
+    }
+    for (int i = 0; i < SHM_PENDING_CONNECTIONS; i++) {
+        if (shmPending[i] > 0) {
+            close(shmPending[i]);
+        }
+    }
+    nt_free();
+    ks_free();
+    close(selfPipe[0]);
+    close(selfPipe[1]);
+    close(serverSocket);
+    exit(EXIT_SUCCESS);
+}
+
+void logKillCounter(const KillCounter* counter, void* context) {
+    LOG_INFO(LM_STATS, false, "%llu '%s' process(es) killed on %s, %u in the last hour.",
+             counter->total, counter->program, counter->node,
+             ks_killsSince(counter, time(NULL), KILL_STATS_MINUTES));
+}
+
+void handleAdminRequest(AdminConnection* connection, char* request) {
+    char command[32] = "";
+    int consumed = 0;
+    sscanf(request, "%31s %n", command, &consumed);
+    char* arguments = request + consumed;
+
+    if (strcasecmp(command, "CLIENTS") == 0) {
+        for (int i = 0; i < MAXCLIENTS; i++) {
+            if (clients[i].socket > 0) {
+                admin_reply(connection, "%s host=%s type=%s",
+                            strlen(clients[i].node) != 0 ? clients[i].node : "-",
+                            clients[i].host, clients[i].isRelay ? "relay" : "client");
+            }
+        }
+    }
+    else if (strcasecmp(command, "NODES") == 0) {
+        nt_forEach(&replyNodeState, connection);
+    }
+    else if (strcasecmp(command, "KILLS") == 0) {
+        KillQuery query;
+        query.connection = connection;
+        query.now = time(NULL);
+        query.minutes = KILL_STATS_MINUTES;
+        strcpy(query.program, "");
+        query.totals = NULL;
+        query.totalCount = 0;
+        query.totalCapacity = 0;
+        sscanf(arguments, "%u %127s", &query.minutes, query.program);
+        if (query.minutes == 0 || query.minutes > KILL_STATS_MINUTES) {
+            admin_reply(connection, "ERR minutes must be between 1 and %d", KILL_STATS_MINUTES);
+        }
+        else {
+            ks_forEach(&collectKills, &query);
+            for (size_t i = 0; i < query.totalCount; i++) {
+                admin_reply(connection, "%s kills=%u", query.totals[i].name, query.totals[i].kills);
+            }
+            free(query.totals);
+        }
+    }
+    else if (strcasecmp(command, "QUEUES") == 0) {
+        LogWriterStats stats;
+        lw_getStats(&stats);
+        admin_reply(connection, "logwriter records=%llu depth=%zu peak=%zu stalls=%llu flush_last_us=%llu flush_max_us=%llu",
+                    stats.recordsWritten, stats.queueDepth, stats.peakQueueDepth, stats.producerStalls,
+                    stats.lastFlushNs / 1000, stats.maxFlushNs / 1000);
+        LogRotateStats rotateStats;
+        lr_getStats(&rotateStats);
+        admin_reply(connection, "rotation rotations=%llu compressed=%llu failed=%llu deleted=%llu pending=%zu",
+                    rotateStats.rotations, rotateStats.compressed, rotateStats.compressFailures,
+                    rotateStats.deleted, rotateStats.pending);
+        admin_reply(connection, "resolver depth=%d", rs_queueDepth());
+        admin_reply(connection, "compression batches=%llu raw_bytes=%llu compressed_bytes=%llu decompress_us=%llu",
+                    compressionStats.batches, compressionStats.rawBytes, compressionStats.compressedBytes,
+                    compressionStats.decompressNs / 1000);
+        if (relay_socket() > 0) {
+            RelayStats relayStats;
+            relay_getStats(&relayStats);
+            admin_reply(connection, "relay pending_bytes=%zu unsent_bytes=%zu batches=%llu",
+                        relayStats.pendingBytes, relayStats.unsentBytes, relayStats.batches);
+        }
+    }
+    else if (strcasecmp(command, "KILL") == 0 || strcasecmp(command, "RULE") == 0) {
+        if (isRelay()) {
+            admin_reply(connection, "ERR actions are sent from the top server, not a relay");
+        }
+        else {
+            // answered once every target has acknowledged or given up on
+            startAction(connection, arguments, strcasecmp(command, "RULE") == 0);
+            return;
+        }
+    }
+    else if (strcasecmp(command, "LEVEL") == 0) {
+        if (strlen(arguments) != 0 && lv_configure(arguments) == false) {
+            admin_reply(connection, "ERR could not read '%s', try LEVEL info,monitor=debug", arguments);
+        }
+        else {
+            char levels[128];
+            lv_describe(levels, sizeof(levels));
+            admin_reply(connection, "levels %s built=%s", levels, lv_levelName(PROCNANNY_LOG_LEVEL));
+        }
+    }
+    else if (strcasecmp(command, "HELP") == 0) {
+        admin_reply(connection, "CLIENTS          connected clients and relays");
+        admin_reply(connection, "NODES            processes monitored on every known node");
+        admin_reply(connection, "KILLS <minutes>  kills per program, or per node with KILLS <minutes> <program>");
+        admin_reply(connection, "QUEUES           log writer, resolver and relay queue depths, compression totals");
+        admin_reply(connection, "LEVEL [filter]   show or set log levels, such as LEVEL warning or LEVEL info,monitor=debug");
+        admin_reply(connection, "KILL <program> <nodes>            kill a program now, nodes is '*' or a comma separated list");
+        admin_reply(connection, "RULE <program> <runtime> <nodes>  override a program's runtime until the next SIGHUP");
+    }
+    else {
+        admin_reply(connection, "ERR unknown command '%s', try HELP", command);
+    }
+    admin_end(connection);
+}
+
+void startAction(AdminConnection* connection, char* arguments, bool isRule) {
+    char program[PROGRAM_NAME_LENGTH];
+    char targets[ADMIN_REQUEST_LENGTH];
+    unsigned int runtime = 0;
+    char line[ADMIN_REQUEST_LENGTH + PROGRAM_NAME_LENGTH + 128];
+    PendingAction* action = NULL;
+    for (int i = 0; i < MAX_PENDING_ACTIONS && action == NULL; i++) {
+        if (pendingActions[i].id == 0) {
+            action = &pendingActions[i];
+        }
+    }
+
+    if (action == NULL) {
+        admin_reply(connection, "ERR too many actions in flight");
+        admin_end(connection);
+        return;
+    }
+    if (isRule && sscanf(arguments, "%127s %u %511s", program, &runtime, targets) == 3) {
+        snprintf(action->description, sizeof(action->description), "RULE %s %u", program, runtime);
+    }
+    else if (isRule == false && sscanf(arguments, "%127s %511s", program, targets) == 2) {
+        snprintf(action->description, sizeof(action->description), "KILL %s", program);
+    }
+    else {
+        admin_reply(connection, isRule ? "ERR usage: RULE <program> <runtime> <nodes>"
+                                       : "ERR usage: KILL <program> <nodes>");
+        admin_end(connection);
+        return;
+    }
+
+    // every target gets the action before any acknowledgement is waited on
+    unsigned long id = nextActionId++;
+    snprintf(line, sizeof(line), "%s %lu %s %s\n", PROTOCOL_ACTION, id, targets, action->description);
+    clock_gettime(CLOCK_MONOTONIC, &action->sent);
+    int expected = dispatchAction(line, targets);
+    if (expected == 0) {
+        admin_reply(connection, "ERR no connected node matches '%s'", targets);
+        admin_end(connection);
+        return;
+    }
+
+    action->id = id;
+    action->adminId = connection->id;
+    action->expected = expected;
+    action->acknowledged = 0;
+    action->count = 0;
+    action->totalLatencyNs = 0;
+    action->maxLatencyNs = 0;
+
+    LOG_INFO(LM_MONITOR, false, "Action %lu (%s) sent to %d node(s).", id, action->description, expected);
+}
+
+int dispatchAction(const char* line, const char* targets) {
+    int expected = 0;
+    size_t length = strlen(line);
+    for (int i = 0; i < MAXCLIENTS; i++) {
+        if (clients[i].socket <= 0 || strlen(clients[i].node) == 0) {
+            continue;
+        }
+        int acks = 0;
+        if (clients[i].isRelay) {
+            TargetCount behind = {targets, clients[i].node, 0};
+            nt_forEach(&countRelayedTargets, &behind);
+            acks = behind.count;
+        }
+        else if (targetMatches(targets, clients[i].node)) {
+            acks = 1;
+        }
+        if (acks > 0 && sendToClient(&clients[i], line, length)) {
+            expected += acks;
+        }
+    }
+    return expected;
+}
+
+void countRelayedTargets(const NodeState* state, void* context) {
+    TargetCount* behind = context;
+    if (state->connected && strcmp(state->via, behind->via) == 0 && targetMatches(behind->targets, state->node)) {
+        behind->count++;
+    }
+}
+
+bool targetMatches(const char* targets, const char* node) {
+    if (strcmp(targets, "*") == 0) {
+        return true;
+    }
+    size_t nodeLength = strlen(node);
+    const char* target = targets;
+    while (*target != '\0') {
+        const char* end = strchr(target, ',');
+        size_t targetLength = end != NULL ? (size_t) (end - target) : strlen(target);
+        if (targetLength == nodeLength && strncmp(target, node, nodeLength) == 0) {
+            return true;
+        }
+        if (end == NULL) {
+            break;
+        }
+        target = end + 1;
+    }
+    return false;
+}
+
+void finishAction(PendingAction* action, bool timedOut) {
+    unsigned long long averageUs = action->acknowledged > 0
+                                   ? action->totalLatencyNs / action->acknowledged / 1000 : 0;
+    AdminConnection* connection = admin_find(action->adminId);
+    if (connection != NULL) {
+        admin_reply(connection, "acked=%d/%d count=%u latency_avg_us=%llu latency_max_us=%llu",
+                    action->acknowledged, action->expected, action->count,
+                    averageUs, action->maxLatencyNs / 1000);
+        if (timedOut) {
+            admin_reply(connection, "ERR %d node(s) did not acknowledge within %d ms",
+                        action->expected - action->acknowledged, ACTION_TIMEOUT_MS);
+        }
+        admin_end(connection);
+    }
+
+    LOG_AT(timedOut ? LV_WARNING : LV_INFO, LM_MONITOR, false,
+           "Action %lu (%s) acknowledged by %d of %d node(s), count %u, latency avg %llu us max %llu us.",
+           action->id, action->description, action->acknowledged, action->expected, action->count,
+           averageUs, action->maxLatencyNs / 1000);
+    action->id = 0;
+}
+
+long msUntilTimeout(const PendingAction* action) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ageMs = (now.tv_sec - action->sent.tv_sec) * 1000
+                 + (now.tv_nsec - action->sent.tv_nsec) / 1000000;
+    return ageMs >= ACTION_TIMEOUT_MS ? 0 : ACTION_TIMEOUT_MS - ageMs;
+}
+
+long msUntilActionTimeout() {
+    long soonest = -1;
+    for (int i = 0; i < MAX_PENDING_ACTIONS; i++) {
+        if (pendingActions[i].id != 0) {
+            long remaining = msUntilTimeout(&pendingActions[i]);
+            if (soonest == -1 || remaining < soonest) {
+                soonest = remaining;
+            }
+        }
+    }
+    return soonest;
+}
+
+void expireActions() {
+    for (int i = 0; i < MAX_PENDING_ACTIONS; i++) {
+        if (pendingActions[i].id != 0 && msUntilTimeout(&pendingActions[i]) == 0) {
+            finishAction(&pendingActions[i], true);
+        }
+    }
+}
+
+void replyNodeState(const NodeState* state, void* connection) {
+    admin_reply((AdminConnection*) connection, "%s monitored=%d connected=%s via=%s",
+                state->node, state->monitored, state->connected ? "yes" : "no",
+                strlen(state->via) != 0 ? state->via : "-");
+}
+
+void collectKills(const KillCounter* counter, void* context) {
+    KillQuery* query = context;
+    const char* name = counter->program;
+    if (strlen(query->program) != 0) {
+        // a single program is broken down by node instead
+        if (strcmp(counter->program, query->program) != 0) {
+            return;
+        }
+        name = counter->node;
+    }
+    unsigned int kills = ks_killsSince(counter, query->now, (int) query->minutes);
+    if (kills == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < query->totalCount; i++) {
+        if (strcmp(query->totals[i].name, name) == 0) {
+            query->totals[i].kills += kills;
+            return;
+        }
+    }
+    // not realloc, memwatch's realloc deadlocks on its own lock when built with MW_PTHREADS
+    if (query->totalCount == query->totalCapacity) {
+        query->totalCapacity = query->totalCapacity == 0 ? 16 : query->totalCapacity * 2;
+        KillTotal* totals = malloc(query->totalCapacity * sizeof(KillTotal));
+        if (query->totalCount > 0) {
+            memcpy(totals, query->totals, query->totalCount * sizeof(KillTotal));
+        }
+        free(query->totals);
+        query->totals = totals;
+    }
+    snprintf(query->totals[query->totalCount].name, NODE_NAME_LENGTH, "%s", name);
+    query->totals[query->totalCount].kills = kills;
+    query->totalCount++;
+}
+
 void cleanUp() {
+    rs_stop();
 }
 
 void trimWhitespace(char *str) {
@@ -432,12 +1673,11 @@ void getPids(const char *processName, pid_t pids[MAX_PROCESSES]) {
 }
 
 void getCurrentTime(char *buffer) {
-    time_t rawTime;
-    struct tm *timeInfo;
-    time (&rawTime);
-    timeInfo = localtime (&rawTime);
-    strftime(buffer,TIME_BUFFER_SIZE,"%a %b %d %H:%M:%S %Z %Y", timeInfo);
-    trimWhitespace(buffer);
+    formatTime(time(NULL), buffer);
+}
+
+void formatTime(time_t rawTime, char *buffer) {
+    lf_timestamp(rawTime, buffer);
 }
 
 void killPid(pid_t pid) {
@@ -447,28 +1687,37 @@ void killPid(pid_t pid) {
 }
 
 void logToFile(const char* type, const char* msg, bool logToSTDOUT) {
-    char timebuffer[TIME_BUFFER_SIZE];
-    getCurrentTime(timebuffer);
     LogMessage logMsg;
-    snprintf(logMsg.message, LOG_MESSAGE_LENGTH,
-             "[%s] %s: %s\n",
-             timebuffer, type, msg);
+    size_t length = lf_format(type, msg, logMsg.message, LOG_MESSAGE_LENGTH);
 
-    FILE* log = fopen(logLocation, "a");
-    fprintf(log, "%s", logMsg.message);
-    fclose(log);
+    if (el_enabled()) {
+        char record[sizeof(EventRecord) + LOG_MESSAGE_LENGTH];
+        lw_write(record, el_message(record, sizeof(record), type, msg));
+    }
+    else {
+        lw_write(logMsg.message, length);
+    }
+    ss_append(SS_KIND_LOG, time(NULL), "", "", logMsg.message, length);
 
     if (logToSTDOUT == true) {
         printf("%s", logMsg.message);
     }
 }
 
+void logFormatted(LogLevel level, bool echo, const char* format, ...) {
+    LogMessage msg;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg.message, LOG_MESSAGE_LENGTH, format, args);
+    va_end(args);
+    logToFile(lv_typeName(level), msg.message, echo);
+}
+
 void logToFileSimple(const char* msg) {
-    if (strstr(msg, "killed after") != NULL) {
-        numProcessesKilled++;
+    if (el_enabled()) {
+        char record[sizeof(EventRecord) + LOG_MESSAGE_LENGTH + NODE_NAME_LENGTH];
+        lw_write(record, el_line(record, sizeof(record), msg, strlen(msg)));
+        return;
     }
-
-    FILE* log = fopen(logLocation, "a");
-    fprintf(log, "%s", msg);
-    fclose(log);
+    lw_write(msg, strlen(msg));
 }
@@ -22,6 +22,12 @@
 #include <time.h>
 #include <sys/types.h>
 #include <stdbool.h>
+#include <netinet/in.h>
+#include "protocol.h"
+#include "kill_stats.h"
+#include "node_table.h"
+#include "admin.h"
+#include "shm_ring.h"
 
 #define PORT 8888
 #define MAXCLIENTS 32
@@ -30,6 +36,13 @@
 #define LOG_MESSAGE_LENGTH 512
 #define TIME_BUFFER_SIZE 40
 #define PROGRAM_NAME_LENGTH 128
+#define CLIENT_BUFFER_SIZE 4096
+#define MAX_PENDING_ACTIONS 16
+#define ACTION_TIMEOUT_MS 5000
+// kill events stamped further than this from our clock are dropped
+#define KILL_EVENT_MAX_SKEW_S (24 * 60 * 60)
+// shared memory connections waiting for their descriptors, the oldest goes first
+#define SHM_PENDING_CONNECTIONS 8
 
 typedef struct _LogMessage {
     char message[LOG_MESSAGE_LENGTH];
@@ -40,21 +53,124 @@ typedef struct _ProgramConfig {
     unsigned int runtime;
 } ProgramConfig;
 
-typedef struct _ClientName {
-    char name[128];
-} ClientName;
+typedef struct _ClientConnection {
+    int socket;
+    unsigned long id;
+    char host[NODE_NAME_LENGTH]; // numeric until the reverse lookup finishes
+    char node[NODE_NAME_LENGTH];
+    bool isRelay;
+    char pending[CLIENT_BUFFER_SIZE]; // bytes read but not yet a complete line
+    size_t pendingLength;
+    char* frame;                      // compressed batch being received
+    size_t frameLength;
+    size_t frameReceived;
+    size_t frameRawLength;
+    int frameDictionary;              // 0 for plain lz_compress output
+    ShmRing toServer;                 // only open once the client took the shared memory offer
+    ShmRing toClient;
+    char shmToken[PROTOCOL_SHM_TOKEN_LENGTH];
+    char shmPending[CLIENT_BUFFER_SIZE];
+    size_t shmPendingLength;
+} ClientConnection;
+
+// a targeted KILL or RULE waiting for every node to acknowledge it
+typedef struct _PendingAction {
+    unsigned long id;               // 0 when the slot is free
+    unsigned long adminId;          // admin connection waiting for the result
+    char description[PROGRAM_NAME_LENGTH + 32];
+    struct timespec sent;
+    int expected;
+    int acknowledged;
+    unsigned int count;             // processes killed or rules applied
+    unsigned long long totalLatencyNs;
+    unsigned long long maxLatencyNs;
+} PendingAction;
+
+typedef struct _TargetCount {
+    const char* targets;
+    const char* via;
+    int count;
+} TargetCount;
+
+// batches taken in from clients and relays
+typedef struct _CompressionStats {
+    unsigned long long batches;
+    unsigned long long rawBytes;
+    unsigned long long compressedBytes;
+    unsigned long long decompressNs;    // CPU time spent in the codec
+} CompressionStats;
+
+// running totals for one admin KILLS query
+typedef struct _KillTotal {
+    char name[NODE_NAME_LENGTH];    // program, or node when a program was given
+    unsigned int kills;
+} KillTotal;
+
+typedef struct _KillQuery {
+    AdminConnection* connection;
+    time_t now;
+    unsigned int minutes;
+    char program[PROGRAM_NAME_LENGTH];
+    KillTotal* totals;
+    size_t totalCount;
+    size_t totalCapacity;
+} KillQuery;
 
 void beginProcNanny();
+void acceptSharedMemory();
+void receiveSharedMemory(int sd);
 void checkInputs(int args, char* argv[]);
 void cleanUp();
+void closeClient(ClientConnection* client);
+void collectKills(const KillCounter* counter, void* context);
+void countRelayedTargets(const NodeState* state, void* context);
+void dropClient(ClientConnection* client);
+void expireActions();
+void finishAction(PendingAction* action, bool timedOut);
+void forwardNodeState(const char* node, int monitored);
+void forwardRelayedDisconnect(const NodeState* state, void* via);
+void forwardUpstreamConfiguration();
+void formatTime(time_t rawTime, char* buffer);
 void getCurrentTime(char* buffer);
 void getPids(const char* processName, pid_t pids[MAX_PROCESSES]);
+void handleAck(ClientConnection* client, const char* fields, size_t length);
+void handleAdminRequest(AdminConnection* connection, char* request);
+void handleBatch(ClientConnection* client);
+void handleClientLine(ClientConnection* client, char* line, size_t length);
+void handleKillEvent(ClientConnection* client, const char* fields, size_t length);
+void handleMonitoringReport(ClientConnection* client, const char* fields, size_t length);
+void readFromClient(ClientConnection* client);
+void readFromRing(ClientConnection* client);
+void readFromUpstream();
+void replyNodeState(const NodeState* state, void* connection);
+void recordClientLog(ClientConnection* client, const char* record, size_t length);
 void killPid(pid_t pid);
 void killAllProcNannys();
 void logToFileSimple(const char* msg);
 void logToFile(const char* type, const char* msg, bool logToSTDOUT);
+void logKillCounter(const KillCounter* counter, void* context);
+void lostUpstream();
+void offerCompression(ClientConnection* client);
+void offerSharedMemory(ClientConnection* client, struct in_addr peer);
+void openSharedMemoryListener();
 void readConfigurationFile();
+void sendConfiguration(ClientConnection* client);
+bool sendToClient(ClientConnection* client, const char* data, size_t length);
+void shutdownServer(const char* reason);
 void signalHandler(int signo);
+void startAction(AdminConnection* connection, char* arguments, bool isRule);
+void startLogWriter();
 void trimWhitespace(char* str);
 
+bool isRelay();
+bool targetMatches(const char* targets, const char* node);
+
+int dispatchAction(const char* line, const char* targets);
+
+long msUntilActionTimeout();
+long msUntilTimeout(const PendingAction* action);
+
+size_t consumeClientInput(ClientConnection* client, char* data, size_t length);
+size_t consumePending(ClientConnection* client, char* pending, size_t length);
+
 #endif //PROC_NANNY_SERVER_H
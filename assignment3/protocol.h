@@ -0,0 +1,78 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// Everything on the wire between procnanny.client and procnanny.server is
+// newline terminated. Lines starting with "___" are control lines, every
+// other line from a client is a log record.
+
+#define NODE_NAME_LENGTH 256
+
+// server -> client: exit cleanly
+#define PROTOCOL_KILL "___KILL___"
+
+// client -> server: sent once per connection, "___NODE___ <hostname>"
+#define PROTOCOL_NODE "___NODE___"
+
+// stands in for the client's hostname inside log records, the server
+// substitutes the name announced with PROTOCOL_NODE
+#define PROTOCOL_NODE_MARKER "\x01"
+
+// server -> client: "___CONFIG___ <n>" followed by n "<program> <runtime>" lines
+#define PROTOCOL_CONFIG "___CONFIG___"
+
+// server -> client: "___ACTION___ <id> <targets> KILL <program>" or
+// "___ACTION___ <id> <targets> RULE <program> <runtime>". Targets is "*" or a
+// comma separated list of nodes, relays use it to pick which clients get
+// the action. Each client answers with "___ACK___ <id> <count> [node]",
+// count being the processes killed or rules applied. A relay adds the node.
+#define PROTOCOL_ACTION "___ACTION___"
+#define PROTOCOL_ACK "___ACK___"
+
+// client -> server: "___KILLED___ <epoch> <pid> <runtime> <program> [node]",
+// the node is only present when a relay forwards the event
+#define PROTOCOL_KILLED "___KILLED___"
+
+// client -> server: "___MONITORING___ <count> [node]" whenever the number of
+// monitored processes changes. A relay adds the node, and reports a count of
+// -1 when that node disconnects from it.
+#define PROTOCOL_MONITORING "___MONITORING___"
+
+// server -> client: "___SHM___ <socket> <token>", offered when the client
+// connected from the same host. The client may answer by connecting to the
+// abstract UNIX socket and passing the token and the fds of two shm_ring
+// rings, after which both directions use the rings and the TCP connection
+// is only watched for the client going away.
+#define PROTOCOL_SHM "___SHM___"
+#define PROTOCOL_SHM_TOKEN_LENGTH 64
+
+// relay -> server: sent instead of PROTOCOL_NODE, "___RELAY___ <hostname>"
+#define PROTOCOL_RELAY "___RELAY___"
+
+// relay or client -> server: "___BATCH___ <raw length> <compressed length> [dictionary]"
+// followed by that many bytes of lz_compress output holding complete lines.
+// With a dictionary version the bytes are lz_compressWithDictionary output.
+#define PROTOCOL_BATCH "___BATCH___"
+#define PROTOCOL_BATCH_MAX 65536
+
+// server -> client or relay: "___COMPRESS___ <dictionary version>", the server
+// takes batches compressed with that dictionary. Clients that do not know
+// the line ignore it and keep sending plain lines.
+#define PROTOCOL_COMPRESS "___COMPRESS___"
+
+#endif //PROTOCOL_H
@@ -0,0 +1,257 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "queue.h"
+#include "memwatch.h"
+
+// The MPSC queue is Dmitry Vyukov's bounded queue: every cell carries a
+// sequence number equal to the position it is free for, or one past it once
+// its item is published, so producers only contend on enqueuePos.
+#define SEQUENCE_SIZE sizeof(size_t)
+
+static size_t roundUpCapacity(size_t capacity) {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+static char *cellAt(MpscQueue *queue, size_t pos) {
+    return queue->cells + (pos & queue->mask) * queue->cellSize;
+}
+
+static size_t *sequenceOf(char *cell) {
+    return (size_t *) cell;
+}
+
+bool mq_init(MpscQueue *queue, size_t itemSize, size_t capacity) {
+    memset(queue, 0, sizeof(*queue));
+    capacity = roundUpCapacity(capacity);
+    queue->mask = capacity - 1;
+    queue->itemSize = itemSize;
+    queue->cellSize = (SEQUENCE_SIZE + itemSize + SEQUENCE_SIZE - 1) / SEQUENCE_SIZE * SEQUENCE_SIZE;
+    queue->cells = malloc(queue->cellSize * capacity);
+    if (queue->cells == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        *sequenceOf(cellAt(queue, i)) = i;
+    }
+    return true;
+}
+
+void mq_free(MpscQueue *queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+void *mq_claim(MpscQueue *queue) {
+    size_t pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+    while (true) {
+        char *cell = cellAt(queue, pos);
+        size_t sequence = __atomic_load_n(sequenceOf(cell), __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return cell + SEQUENCE_SIZE;
+            }
+        }
+        else if (diff < 0) {
+            return NULL;
+        }
+        else {
+            pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void mq_publish(MpscQueue *queue, void *item) {
+    // the claimed cell still holds its position, nobody else touches it
+    size_t *sequence = sequenceOf((char *) item - SEQUENCE_SIZE);
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+}
+
+bool mq_push(MpscQueue *queue, const void *item) {
+    void *cell = mq_claim(queue);
+    if (cell == NULL) {
+        return false;
+    }
+    memcpy(cell, item, queue->itemSize);
+    mq_publish(queue, cell);
+    return true;
+}
+
+size_t mq_pushBatch(MpscQueue *queue, const void *items, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    // a run of cells is free once the consumer has released everything one
+    // capacity before its end, and it releases cells before moving dequeuePos
+    size_t pos;
+    size_t claimed;
+    do {
+        size_t dequeued = __atomic_load_n(&queue->dequeuePos, __ATOMIC_ACQUIRE);
+        pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+        // single claims can run a cell ahead of dequeuePos while it is moving
+        size_t used = pos - dequeued;
+        if (used >= queue->mask + 1) {
+            return 0;
+        }
+        size_t room = queue->mask + 1 - used;
+        claimed = count < room ? count : room;
+    } while (__atomic_compare_exchange_n(&queue->enqueuePos, &pos, pos + claimed, true,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false);
+
+    for (size_t i = 0; i < claimed; i++) {
+        char *cell = cellAt(queue, pos + i);
+        memcpy(cell + SEQUENCE_SIZE, (const char *) items + i * queue->itemSize, queue->itemSize);
+        __atomic_store_n(sequenceOf(cell), pos + i + 1, __ATOMIC_RELEASE);
+    }
+    return claimed;
+}
+
+void *mq_peek(MpscQueue *queue, size_t index) {
+    size_t pos = queue->dequeuePos + index;
+    char *cell = cellAt(queue, pos);
+    if (__atomic_load_n(sequenceOf(cell), __ATOMIC_ACQUIRE) != pos + 1) {
+        return NULL;
+    }
+    return cell + SEQUENCE_SIZE;
+}
+
+void mq_release(MpscQueue *queue, size_t count) {
+    size_t pos = queue->dequeuePos;
+    for (size_t i = 0; i < count; i++) {
+        __atomic_store_n(sequenceOf(cellAt(queue, pos + i)), pos + i + queue->mask + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&queue->dequeuePos, pos + count, __ATOMIC_RELEASE);
+}
+
+bool mq_pop(MpscQueue *queue, void *item) {
+    void *front = mq_peek(queue, 0);
+    if (front == NULL) {
+        return false;
+    }
+    memcpy(item, front, queue->itemSize);
+    mq_release(queue, 1);
+    return true;
+}
+
+size_t mq_popBatch(MpscQueue *queue, void *items, size_t max) {
+    size_t count = 0;
+    void *item;
+    while (count < max && (item = mq_peek(queue, count)) != NULL) {
+        memcpy((char *) items + count * queue->itemSize, item, queue->itemSize);
+        count++;
+    }
+    mq_release(queue, count);
+    return count;
+}
+
+size_t mq_size(MpscQueue *queue) {
+    size_t dequeued = __atomic_load_n(&queue->dequeuePos, __ATOMIC_RELAXED);
+    size_t enqueued = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+    return enqueued - dequeued;
+}
+
+// copies count items to or from the ring starting at pos, wrapping at the end
+static void copyIn(SpscQueue *queue, size_t pos, const void *items, size_t count) {
+    size_t start = pos & queue->mask;
+    size_t first = queue->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(queue->items + start * queue->itemSize, items, first * queue->itemSize);
+    memcpy(queue->items, (const char *) items + first * queue->itemSize, (count - first) * queue->itemSize);
+}
+
+static void copyOut(SpscQueue *queue, size_t pos, void *items, size_t count) {
+    size_t start = pos & queue->mask;
+    size_t first = queue->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(items, queue->items + start * queue->itemSize, first * queue->itemSize);
+    memcpy((char *) items + first * queue->itemSize, queue->items, (count - first) * queue->itemSize);
+}
+
+bool sq_init(SpscQueue *queue, size_t itemSize, size_t capacity) {
+    memset(queue, 0, sizeof(*queue));
+    capacity = roundUpCapacity(capacity);
+    queue->mask = capacity - 1;
+    queue->itemSize = itemSize;
+    queue->items = malloc(itemSize * capacity);
+    return queue->items != NULL;
+}
+
+void sq_free(SpscQueue *queue) {
+    free(queue->items);
+    queue->items = NULL;
+}
+
+size_t sq_pushBatch(SpscQueue *queue, const void *items, size_t count) {
+    size_t head = queue->head;
+    size_t capacity = queue->mask + 1;
+    // only look at the consumer's cache line when the old view says full
+    if (capacity - (head - queue->cachedTail) < count) {
+        queue->cachedTail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    }
+    size_t room = capacity - (head - queue->cachedTail);
+    if (count > room) {
+        count = room;
+    }
+    if (count > 0) {
+        copyIn(queue, head, items, count);
+        __atomic_store_n(&queue->head, head + count, __ATOMIC_RELEASE);
+    }
+    return count;
+}
+
+bool sq_push(SpscQueue *queue, const void *item) {
+    return sq_pushBatch(queue, item, 1) == 1;
+}
+
+size_t sq_popBatch(SpscQueue *queue, void *items, size_t max) {
+    size_t tail = queue->tail;
+    if (queue->cachedHead - tail < max) {
+        queue->cachedHead = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    }
+    size_t count = queue->cachedHead - tail;
+    if (count > max) {
+        count = max;
+    }
+    if (count > 0) {
+        copyOut(queue, tail, items, count);
+        __atomic_store_n(&queue->tail, tail + count, __ATOMIC_RELEASE);
+    }
+    return count;
+}
+
+bool sq_pop(SpscQueue *queue, void *item) {
+    return sq_popBatch(queue, item, 1) == 1;
+}
+
+size_t sq_size(SpscQueue *queue) {
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    return head - tail;
+}
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bounded queues of fixed size items for handing work from one thread to
+// another without a lock. MpscQueue takes items from any number of threads
+// for one consumer, SpscQueue is for exactly one thread at each end. Both
+// keep the producer and consumer positions on cache lines of their own.
+// Neither ever blocks: a full queue refuses the push and an empty one comes
+// back with nothing, waiting is left to the caller.
+
+#define QUEUE_CACHE_LINE 64
+
+typedef struct _MpscQueue {
+    size_t enqueuePos;
+    char padEnqueue[QUEUE_CACHE_LINE - sizeof(size_t)];
+    size_t dequeuePos;
+    char padDequeue[QUEUE_CACHE_LINE - sizeof(size_t)];
+    size_t mask;            // capacity - 1
+    size_t itemSize;
+    size_t cellSize;        // sequence number and item, rounded up
+    char *cells;
+} MpscQueue;
+
+typedef struct _SpscQueue {
+    size_t head;            // written by the producer
+    size_t cachedTail;      // the producer's last look at tail
+    char padHead[QUEUE_CACHE_LINE - 2 * sizeof(size_t)];
+    size_t tail;            // written by the consumer
+    size_t cachedHead;      // the consumer's last look at head
+    char padTail[QUEUE_CACHE_LINE - 2 * sizeof(size_t)];
+    size_t mask;
+    size_t itemSize;
+    char *items;
+} SpscQueue;
+
+// capacity is rounded up to a power of two, false if it could not be allocated
+bool    mq_init(MpscQueue *queue, size_t itemSize, size_t capacity);
+
+void    mq_free(MpscQueue *queue);
+
+// space for one item, NULL when the queue is full. Safe from any thread,
+// and the item is not seen by the consumer until it is published.
+void*   mq_claim(MpscQueue *queue);
+
+void    mq_publish(MpscQueue *queue, void *item);
+
+// copies one item in, false when the queue is full
+bool    mq_push(MpscQueue *queue, const void *item);
+
+// copies in as many of the items as fit with one claim, returns how many
+size_t  mq_pushBatch(MpscQueue *queue, const void *items, size_t count);
+
+// consumer only. The index-th item past the front, NULL until it has been
+// published. Stays valid until mq_release.
+void*   mq_peek(MpscQueue *queue, size_t index);
+
+// consumer only, hands the first count items back to the producers
+void    mq_release(MpscQueue *queue, size_t count);
+
+// consumer only, false when the front item is not there yet
+bool    mq_pop(MpscQueue *queue, void *item);
+
+// consumer only, copies out up to max items and returns how many
+size_t  mq_popBatch(MpscQueue *queue, void *items, size_t max);
+
+// items claimed and not yet released, only a snapshot while producers run
+size_t  mq_size(MpscQueue *queue);
+
+bool    sq_init(SpscQueue *queue, size_t itemSize, size_t capacity);
+
+void    sq_free(SpscQueue *queue);
+
+// producer only, false when the queue is full
+bool    sq_push(SpscQueue *queue, const void *item);
+
+// producer only, copies in as many of the items as fit and returns how many
+size_t  sq_pushBatch(SpscQueue *queue, const void *items, size_t count);
+
+// consumer only, false when the queue is empty
+bool    sq_pop(SpscQueue *queue, void *item);
+
+// consumer only, copies out up to max items and returns how many
+size_t  sq_popBatch(SpscQueue *queue, void *items, size_t max);
+
+size_t  sq_size(SpscQueue *queue);
+
+#endif //QUEUE_H
@@ -0,0 +1,264 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include "relay.h"
+#include "compress.h"
+#include "protocol.h"
+#include "memwatch.h"
+
+static int upstream = 0;
+static int dictionary = 0;     // version the upstream server offered, 0 for none
+
+static char batch[PROTOCOL_BATCH_MAX];
+static size_t batchLength = 0;
+static struct timespec batchOldest;
+
+static char compressed[PROTOCOL_BATCH_MAX + PROTOCOL_BATCH_MAX / 255 + 16];
+
+// batches the socket has not taken yet, sent once select finds it writable
+static char *output = NULL;
+static size_t outputLength = 0;
+static size_t outputCapacity = 0;
+
+static RelayStats stats;
+
+// writes without waiting, returns how much went or -1 if the parent is gone
+static ssize_t sendSome(struct iovec *iov, int count) {
+    ssize_t written = writev(upstream, iov, count);
+    if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return written;
+}
+
+static bool queueOutput(const char *data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    size_t needed = outputLength + length;
+    if (needed > RELAY_MAX_OUTPUT) {
+        return false;
+    }
+    if (needed > outputCapacity) {
+        size_t capacity = outputCapacity > 0 ? outputCapacity * 2 : PROTOCOL_BATCH_MAX;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        char *grown = malloc(capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        memcpy(grown, output, outputLength);
+        free(output);
+        output = grown;
+        outputCapacity = capacity;
+    }
+    memcpy(output + outputLength, data, length);
+    outputLength = needed;
+    return true;
+}
+
+int relay_connect(const char *host, int port, const char *nodeName) {
+    struct hostent *parent = gethostbyname(host);
+    if (parent == NULL) {
+        return -1;
+    }
+
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in details;
+    memset(&details, 0, sizeof(details));
+    details.sin_family = AF_INET;
+    memcpy(&details.sin_addr, parent->h_addr, (size_t) parent->h_length);
+    details.sin_port = htons((uint16_t) port);
+    if (connect(sd, (struct sockaddr *) &details, sizeof(details)) < 0) {
+        close(sd);
+        return -1;
+    }
+
+    char hello[NODE_NAME_LENGTH + 32];
+    snprintf(hello, sizeof(hello), "%s %s\n", PROTOCOL_RELAY, nodeName);
+    send(sd, hello, strlen(hello), MSG_NOSIGNAL);
+    // from here on the select loop decides when there is room to write
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL) | O_NONBLOCK);
+
+    upstream = sd;
+    dictionary = 0;
+    batchLength = 0;
+    memset(&stats, 0, sizeof(stats));
+    return sd;
+}
+
+void relay_useDictionary(int version) {
+    dictionary = version == LZ_DICTIONARY_VERSION ? version : 0;
+}
+
+void relay_close() {
+    if (upstream > 0) {
+        close(upstream);
+    }
+    upstream = 0;
+    batchLength = 0;
+    free(output);
+    output = NULL;
+    outputLength = 0;
+    outputCapacity = 0;
+}
+
+int relay_socket() {
+    return upstream;
+}
+
+bool relay_append(const char *record, size_t length) {
+    if (upstream <= 0) {
+        return false;
+    }
+    if (length > sizeof(batch)) {
+        length = sizeof(batch);
+    }
+    if (batchLength + length > sizeof(batch) && relay_flush() == false) {
+        return false;
+    }
+    if (batchLength == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &batchOldest);
+    }
+    memcpy(batch + batchLength, record, length);
+    batchLength += length;
+    return true;
+}
+
+bool relay_flush() {
+    if (upstream <= 0) {
+        return false;
+    }
+    if (batchLength == 0) {
+        return true;
+    }
+
+    char header[64];
+    size_t compressedLength = 0;
+    if (dictionary != 0) {
+        compressedLength = lz_compressWithDictionary(batch, batchLength, compressed, sizeof(compressed));
+        snprintf(header, sizeof(header), "%s %zu %zu %d\n", PROTOCOL_BATCH, batchLength, compressedLength,
+                 dictionary);
+    }
+    if (compressedLength == 0) {
+        // no dictionary, or no memory to prime it with, the plain form allocates nothing
+        compressedLength = lz_compress(batch, batchLength, compressed, sizeof(compressed));
+        snprintf(header, sizeof(header), "%s %zu %zu\n", PROTOCOL_BATCH, batchLength, compressedLength);
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = strlen(header);
+    iov[1].iov_base = compressed;
+    iov[1].iov_len = compressedLength;
+
+    stats.batches++;
+    stats.rawBytes += batchLength;
+    stats.compressedBytes += compressedLength;
+    batchLength = 0;
+
+    // behind earlier batches, or whatever the socket would not take now
+    ssize_t sent = 0;
+    if (outputLength == 0) {
+        sent = sendSome(iov, 2);
+        if (sent == -1) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        size_t skipped = (size_t) sent < iov[i].iov_len ? (size_t) sent : iov[i].iov_len;
+        sent -= (ssize_t) skipped;
+        if (queueOutput((char *) iov[i].iov_base + skipped, iov[i].iov_len - skipped) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool relay_hasOutput() {
+    return upstream > 0 && outputLength > 0;
+}
+
+bool relay_sendOutput() {
+    if (upstream <= 0) {
+        return false;
+    }
+    struct iovec iov;
+    iov.iov_base = output;
+    iov.iov_len = outputLength;
+    ssize_t sent = sendSome(&iov, 1);
+    if (sent == -1) {
+        return false;
+    }
+    outputLength -= (size_t) sent;
+    memmove(output, output + sent, outputLength);
+    return true;
+}
+
+bool relay_drain() {
+    if (upstream <= 0) {
+        return false;
+    }
+    fcntl(upstream, F_SETFL, fcntl(upstream, F_GETFL) & ~O_NONBLOCK);
+    while (outputLength > 0) {
+        if (relay_sendOutput() == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+long relay_msUntilFlush() {
+    if (upstream <= 0 || batchLength == 0) {
+        return -1;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ageMs = (now.tv_sec - batchOldest.tv_sec) * 1000
+                 + (now.tv_nsec - batchOldest.tv_nsec) / 1000000;
+    return ageMs >= RELAY_BATCH_MAX_AGE_MS ? 0 : RELAY_BATCH_MAX_AGE_MS - ageMs;
+}
+
+bool relay_flushIfStale() {
+    if (relay_msUntilFlush() == 0) {
+        return relay_flush();
+    }
+    return true;
+}
+
+void relay_getStats(RelayStats *out) {
+    *out = stats;
+    out->pendingBytes = batchLength;
+    out->unsentBytes = outputLength;
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// records are held back and sent upstream once either threshold is hit
+#define RELAY_BATCH_MAX_AGE_MS 5
+// compressed batches the parent has not taken yet, past this it counts as gone
+#define RELAY_MAX_OUTPUT (4 * 1024 * 1024)
+
+typedef struct _RelayStats {
+    unsigned long long batches;
+    unsigned long long rawBytes;
+    unsigned long long compressedBytes;
+    size_t pendingBytes;        // waiting for the next batch
+    size_t unsentBytes;         // batched, waiting for the socket to be writable
+} RelayStats;
+
+// connects to the parent server and announces this relay, returns the socket or -1
+int     relay_connect(const char *host, int port, const char *nodeName);
+
+void    relay_close();
+
+// compress batches with the shared dictionary once the upstream server offers
+// a version this build knows
+void    relay_useDictionary(int version);
+
+// 0 when not connected
+int     relay_socket();
+
+// queues a complete line for the parent, returns false if the parent is gone
+bool    relay_append(const char *record, size_t length);
+
+// never blocks, whatever the socket does not take now is kept for
+// relay_sendOutput, returns false if the parent is gone
+bool    relay_flush();
+
+// true when batches are waiting for the socket to be writable
+bool    relay_hasOutput();
+
+// sends what the socket takes now, returns false if the parent is gone
+bool    relay_sendOutput();
+
+// blocks until every batch has been sent, for shutting down
+bool    relay_drain();
+
+bool    relay_flushIfStale();
+
+// milliseconds until the pending batch goes stale, -1 when nothing is pending
+long    relay_msUntilFlush();
+
+void    relay_getStats(RelayStats *stats);
+
+#endif //RELAY_H
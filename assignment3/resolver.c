@@ -0,0 +1,259 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include "resolver.h"
+#include "memwatch.h"
+
+#define NO_ENTRY -1
+#define CACHE_BUCKETS (RESOLVER_CACHE_SIZE * 2)
+
+typedef struct _CacheEntry {
+    struct in_addr address;
+    char name[NODE_NAME_LENGTH];
+    time_t expires;
+    int hashNext;   // next entry in the same bucket
+    int lruPrev;    // towards the most recently used entry
+    int lruNext;    // towards the least recently used entry
+    bool used;
+} CacheEntry;
+
+typedef struct _LookupRequest {
+    struct in_addr address;
+    unsigned long tag;
+} LookupRequest;
+
+static CacheEntry cache[RESOLVER_CACHE_SIZE];
+static int buckets[CACHE_BUCKETS];
+static int lruHead = NO_ENTRY;
+static int lruTail = NO_ENTRY;
+
+static LookupRequest requests[RESOLVER_QUEUE_SIZE];
+static int requestHead = 0;
+static int requestCount = 0;
+
+static int resultPipe[2] = {-1, -1};
+static bool running = false;
+static bool stopping = false;
+
+static pthread_t resolverThread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t requestReady = PTHREAD_COND_INITIALIZER;
+
+static unsigned int bucketOf(struct in_addr address) {
+    return (address.s_addr * 2654435761u) % CACHE_BUCKETS;
+}
+
+static void lruUnlink(int index) {
+    CacheEntry *entry = &cache[index];
+    if (entry->lruPrev != NO_ENTRY) {
+        cache[entry->lruPrev].lruNext = entry->lruNext;
+    } else {
+        lruHead = entry->lruNext;
+    }
+    if (entry->lruNext != NO_ENTRY) {
+        cache[entry->lruNext].lruPrev = entry->lruPrev;
+    } else {
+        lruTail = entry->lruPrev;
+    }
+}
+
+static void lruPushFront(int index) {
+    cache[index].lruPrev = NO_ENTRY;
+    cache[index].lruNext = lruHead;
+    if (lruHead != NO_ENTRY) {
+        cache[lruHead].lruPrev = index;
+    }
+    lruHead = index;
+    if (lruTail == NO_ENTRY) {
+        lruTail = index;
+    }
+}
+
+static int cacheFind(struct in_addr address) {
+    int index = buckets[bucketOf(address)];
+    while (index != NO_ENTRY) {
+        if (cache[index].address.s_addr == address.s_addr) {
+            return index;
+        }
+        index = cache[index].hashNext;
+    }
+    return NO_ENTRY;
+}
+
+static void bucketRemove(int index) {
+    int *link = &buckets[bucketOf(cache[index].address)];
+    while (*link != index) {
+        link = &cache[*link].hashNext;
+    }
+    *link = cache[index].hashNext;
+}
+
+// must hold lock
+static void cacheInsert(struct in_addr address, const char *name) {
+    int index = cacheFind(address);
+    if (index != NO_ENTRY) {
+        lruUnlink(index);
+    } else {
+        // take an unused entry, or evict the least recently used one
+        for (int i = 0; i < RESOLVER_CACHE_SIZE && index == NO_ENTRY; i++) {
+            if (cache[i].used == false) {
+                index = i;
+            }
+        }
+        if (index == NO_ENTRY) {
+            index = lruTail;
+            lruUnlink(index);
+            bucketRemove(index);
+        }
+        cache[index].used = true;
+        cache[index].address = address;
+        unsigned int bucket = bucketOf(address);
+        cache[index].hashNext = buckets[bucket];
+        buckets[bucket] = index;
+    }
+    snprintf(cache[index].name, NODE_NAME_LENGTH, "%s", name);
+    cache[index].expires = time(NULL) + RESOLVER_TTL_SECONDS;
+    lruPushFront(index);
+}
+
+static void *resolverMain(void *unused) {
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (requestCount == 0 && stopping == false) {
+            pthread_cond_wait(&requestReady, &lock);
+        }
+        if (stopping) {
+            break;
+        }
+        LookupRequest request = requests[requestHead];
+        requestHead = (requestHead + 1) % RESOLVER_QUEUE_SIZE;
+        requestCount--;
+        pthread_mutex_unlock(&lock);
+
+        // the slow part, done without holding the lock
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr = request.address;
+        ResolverResult result;
+        result.tag = request.tag;
+        if (getnameinfo((struct sockaddr *) &address, sizeof(address), result.name, NODE_NAME_LENGTH,
+                        NULL, 0, NI_NAMEREQD) != 0) {
+            inet_ntop(AF_INET, &request.address, result.name, NODE_NAME_LENGTH);
+        }
+
+        pthread_mutex_lock(&lock);
+        cacheInsert(request.address, result.name);
+        pthread_mutex_unlock(&lock);
+
+        // smaller than PIPE_BUF, so the write is atomic
+        write(resultPipe[1], &result, sizeof(result));
+
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return unused;
+}
+
+bool rs_start() {
+    for (int i = 0; i < CACHE_BUCKETS; i++) {
+        buckets[i] = NO_ENTRY;
+    }
+    for (int i = 0; i < RESOLVER_CACHE_SIZE; i++) {
+        cache[i].used = false;
+    }
+
+    if (pipe(resultPipe) == -1) {
+        return false;
+    }
+    int flags = fcntl(resultPipe[0], F_GETFL);
+    flags |= O_NONBLOCK;
+    fcntl(resultPipe[0], F_SETFL, flags);
+
+    if (pthread_create(&resolverThread, NULL, &resolverMain, NULL) != 0) {
+        close(resultPipe[0]);
+        close(resultPipe[1]);
+        resultPipe[0] = resultPipe[1] = -1;
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void rs_stop() {
+    if (running == false) {
+        return;
+    }
+    running = false;
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&requestReady);
+    pthread_mutex_unlock(&lock);
+    pthread_join(resolverThread, NULL);
+    close(resultPipe[0]);
+    close(resultPipe[1]);
+    resultPipe[0] = resultPipe[1] = -1;
+}
+
+int rs_notifyFd() {
+    return resultPipe[0];
+}
+
+bool rs_lookup(struct in_addr address, unsigned long tag, char *name) {
+    bool found = false;
+    pthread_mutex_lock(&lock);
+    int index = cacheFind(address);
+    if (index != NO_ENTRY && cache[index].expires > time(NULL)) {
+        snprintf(name, NODE_NAME_LENGTH, "%s", cache[index].name);
+        lruUnlink(index);
+        lruPushFront(index);
+        found = true;
+    }
+    else if (running && requestCount < RESOLVER_QUEUE_SIZE) {
+        int tail = (requestHead + requestCount) % RESOLVER_QUEUE_SIZE;
+        requests[tail].address = address;
+        requests[tail].tag = tag;
+        requestCount++;
+        pthread_cond_signal(&requestReady);
+    }
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+int rs_queueDepth() {
+    pthread_mutex_lock(&lock);
+    int depth = requestCount;
+    pthread_mutex_unlock(&lock);
+    return depth;
+}
+
+bool rs_nextResult(ResolverResult *result) {
+    if (resultPipe[0] == -1) {
+        return false;
+    }
+    return read(resultPipe[0], result, sizeof(*result)) == sizeof(*result);
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stdbool.h>
+#include <netinet/in.h>
+#include "protocol.h"
+
+#define RESOLVER_CACHE_SIZE 256
+#define RESOLVER_TTL_SECONDS 300
+#define RESOLVER_QUEUE_SIZE 64
+
+typedef struct _ResolverResult {
+    unsigned long tag;
+    char name[NODE_NAME_LENGTH];
+} ResolverResult;
+
+// starts the helper thread, returns false if it could not be started
+bool    rs_start();
+
+void    rs_stop();
+
+// readable whenever rs_nextResult has something to return
+int     rs_notifyFd();
+
+// returns true and fills name straight away on a cache hit, otherwise the
+// lookup is queued and its result will carry the given tag
+bool    rs_lookup(struct in_addr address, unsigned long tag, char *name);
+
+// lookups waiting for the helper thread
+int     rs_queueDepth();
+
+// non blocking, returns false once every finished lookup has been read
+bool    rs_nextResult(ResolverResult *result);
+
+#endif //RESOLVER_H
@@ -0,0 +1,455 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "segment_store.h"
+#include "memwatch.h"
+
+#define BLOOM_BYTES (SS_BLOOM_BITS / 8)
+#define INITIAL_INDEX_CAPACITY 256
+
+static int segmentFd = -1;
+static char segmentDirectory[512];
+static unsigned int segmentSequence = 0;
+static uint64_t segmentOffset = 0;
+static int64_t segmentFirst;
+static int64_t segmentLast;
+static unsigned char nodeBloom[BLOOM_BYTES];
+static unsigned char programBloom[BLOOM_BYTES];
+
+static BlockIndex *blockIndex = NULL;
+static size_t blockCount = 0;
+static size_t blockCapacity = 0;
+
+static char block[SS_BLOCK_BYTES];
+static size_t blockLength = 0;
+static uint32_t blockRecords = 0;
+static int64_t blockFirst;
+static int64_t blockLast;
+static struct timespec blockOldest;
+
+// read side, one block at a time
+static char readBuffer[SS_BLOCK_BYTES];
+
+static uint64_t hash64(const char *value) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    while (*value != '\0') {
+        hash ^= (unsigned char) *value++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void bloomAdd(unsigned char *bloom, const char *value) {
+    uint64_t hash = hash64(value);
+    uint32_t h1 = (uint32_t) hash;
+    uint32_t h2 = (uint32_t) (hash >> 32) | 1;
+    for (uint32_t i = 0; i < SS_BLOOM_HASHES; i++) {
+        uint32_t bit = (h1 + i * h2) % SS_BLOOM_BITS;
+        bloom[bit / 8] |= (unsigned char) (1 << (bit % 8));
+    }
+}
+
+static bool bloomMayContain(const unsigned char *bloom, const char *value) {
+    uint64_t hash = hash64(value);
+    uint32_t h1 = (uint32_t) hash;
+    uint32_t h2 = (uint32_t) (hash >> 32) | 1;
+    for (uint32_t i = 0; i < SS_BLOOM_HASHES; i++) {
+        uint32_t bit = (h1 + i * h2) % SS_BLOOM_BITS;
+        if ((bloom[bit / 8] & (1 << (bit % 8))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeFully(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (count > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+static bool addIndexEntry(uint64_t offset, int64_t first, int64_t last) {
+    if (blockCount == blockCapacity) {
+        // grown by hand, memwatch's realloc does not get along with threads
+        size_t capacity = blockCapacity == 0 ? INITIAL_INDEX_CAPACITY : blockCapacity * 2;
+        BlockIndex *grown = malloc(capacity * sizeof(BlockIndex));
+        if (grown == NULL) {
+            return false;
+        }
+        if (blockIndex != NULL) {
+            memcpy(grown, blockIndex, blockCount * sizeof(BlockIndex));
+            free(blockIndex);
+        }
+        blockIndex = grown;
+        blockCapacity = capacity;
+    }
+    blockIndex[blockCount].offset = offset;
+    blockIndex[blockCount].firstTime = first;
+    blockIndex[blockCount].lastTime = last;
+    blockCount++;
+    return true;
+}
+
+static bool openSegment() {
+    char path[600];
+    time_t now = time(NULL);
+    snprintf(path, sizeof(path), "%s/segment-%010lld-%04u.seg", segmentDirectory, (long long) now,
+             segmentSequence++);
+    segmentFd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (segmentFd == -1) {
+        return false;
+    }
+
+    SegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SS_MAGIC, sizeof(header.magic));
+    header.created = now;
+    struct iovec iov = {&header, sizeof(header)};
+    if (writeFully(segmentFd, &iov, 1) == false) {
+        close(segmentFd);
+        segmentFd = -1;
+        return false;
+    }
+
+    segmentOffset = sizeof(header);
+    segmentFirst = INT64_MAX;
+    segmentLast = INT64_MIN;
+    memset(nodeBloom, 0, sizeof(nodeBloom));
+    memset(programBloom, 0, sizeof(programBloom));
+    blockCount = 0;
+    return true;
+}
+
+static bool flushBlock() {
+    if (blockRecords == 0) {
+        return true;
+    }
+    BlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SS_BLOCK_MAGIC;
+    header.records = blockRecords;
+    header.length = (uint32_t) blockLength;
+    header.firstTime = blockFirst;
+    header.lastTime = blockLast;
+
+    struct iovec iov[2] = {{&header, sizeof(header)}, {block, blockLength}};
+    bool written = writeFully(segmentFd, iov, 2);
+    if (written) {
+        addIndexEntry(segmentOffset, blockFirst, blockLast);
+        segmentOffset += sizeof(header) + blockLength;
+        if (blockFirst < segmentFirst) {
+            segmentFirst = blockFirst;
+        }
+        if (blockLast > segmentLast) {
+            segmentLast = blockLast;
+        }
+    }
+    blockLength = 0;
+    blockRecords = 0;
+    return written;
+}
+
+static void sealSegment() {
+    flushBlock();
+
+    SegmentTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.indexOffset = segmentOffset;
+    trailer.blocks = (uint32_t) blockCount;
+    trailer.magic = SS_TRAILER_MAGIC;
+    trailer.firstTime = blockCount > 0 ? segmentFirst : 0;
+    trailer.lastTime = blockCount > 0 ? segmentLast : 0;
+
+    struct iovec iov[4] = {
+        {nodeBloom, sizeof(nodeBloom)},
+        {programBloom, sizeof(programBloom)},
+        {blockIndex, blockCount * sizeof(BlockIndex)},
+        {&trailer, sizeof(trailer)}
+    };
+    writeFully(segmentFd, iov, 4);
+    close(segmentFd);
+    segmentFd = -1;
+}
+
+bool ss_open(const char *directory) {
+    if (segmentFd != -1) {
+        return true;
+    }
+    if (mkdir(directory, 0755) == -1 && errno != EEXIST) {
+        return false;
+    }
+    snprintf(segmentDirectory, sizeof(segmentDirectory), "%s", directory);
+    blockLength = 0;
+    blockRecords = 0;
+    return openSegment();
+}
+
+void ss_close() {
+    if (segmentFd == -1) {
+        return;
+    }
+    sealSegment();
+    free(blockIndex);
+    blockIndex = NULL;
+    blockCount = 0;
+    blockCapacity = 0;
+}
+
+bool ss_isOpen() {
+    return segmentFd != -1;
+}
+
+void ss_append(int kind, time_t when, const char *node, const char *program, const char *text, size_t length) {
+    if (segmentFd == -1) {
+        return;
+    }
+    size_t nodeLength = strnlen(node, SS_FIELD_LENGTH - 1);
+    size_t programLength = strnlen(program, SS_FIELD_LENGTH - 1);
+    size_t recordLength = sizeof(RecordHeader) + nodeLength + programLength + length;
+    if (recordLength > SS_BLOCK_BYTES) {
+        length = SS_BLOCK_BYTES - sizeof(RecordHeader) - nodeLength - programLength;
+        recordLength = SS_BLOCK_BYTES;
+    }
+    if (blockLength + recordLength > SS_BLOCK_BYTES) {
+        flushBlock();
+    }
+
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.time = when;
+    header.nodeLength = (uint16_t) nodeLength;
+    header.programLength = (uint16_t) programLength;
+    header.textLength = (uint16_t) length;
+    header.kind = (uint8_t) kind;
+
+    if (blockRecords == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &blockOldest);
+        blockFirst = when;
+        blockLast = when;
+    }
+    char *out = block + blockLength;
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), node, nodeLength);
+    memcpy(out + sizeof(header) + nodeLength, program, programLength);
+    memcpy(out + sizeof(header) + nodeLength + programLength, text, length);
+    blockLength += recordLength;
+    blockRecords++;
+    if (when < blockFirst) {
+        blockFirst = when;
+    }
+    if (when > blockLast) {
+        blockLast = when;
+    }
+    if (nodeLength > 0) {
+        bloomAdd(nodeBloom, node);
+    }
+    if (programLength > 0) {
+        bloomAdd(programBloom, program);
+    }
+
+    if (blockLength == SS_BLOCK_BYTES) {
+        flushBlock();
+    }
+    if (segmentOffset >= SS_SEGMENT_BYTES) {
+        sealSegment();
+        openSegment();
+    }
+}
+
+long ss_msUntilFlush() {
+    if (segmentFd == -1 || blockRecords == 0) {
+        return -1;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ageMs = (now.tv_sec - blockOldest.tv_sec) * 1000
+                 + (now.tv_nsec - blockOldest.tv_nsec) / 1000000;
+    return ageMs >= SS_BLOCK_MAX_AGE_MS ? 0 : SS_BLOCK_MAX_AGE_MS - ageMs;
+}
+
+bool ss_flushIfStale() {
+    if (ss_msUntilFlush() == 0) {
+        return flushBlock();
+    }
+    return true;
+}
+
+static bool readAt(int fd, void *buffer, size_t length, uint64_t offset) {
+    return pread(fd, buffer, length, (off_t) offset) == (ssize_t) length;
+}
+
+static bool overlaps(const SegmentQuery *query, int64_t first, int64_t last) {
+    return (query->from == 0 || last >= query->from) && (query->to == 0 || first <= query->to);
+}
+
+static void copyField(char *field, const char *bytes, size_t length) {
+    memcpy(field, bytes, length);
+    field[length] = '\0';
+}
+
+// false when the block is not where the index or previous block said
+static bool queryBlock(int fd, uint64_t offset, uint64_t fileSize, const SegmentQuery *query,
+                       SegmentRecordOperation operation, void *context, SegmentQueryStats *stats) {
+    BlockHeader header;
+    if (offset + sizeof(header) > fileSize || readAt(fd, &header, sizeof(header), offset) == false
+        || header.magic != SS_BLOCK_MAGIC || header.length > SS_BLOCK_BYTES
+        || offset + sizeof(header) + header.length > fileSize
+        || readAt(fd, readBuffer, header.length, offset + sizeof(header)) == false) {
+        return false;
+    }
+    stats->blocksRead++;
+
+    size_t position = 0;
+    for (uint32_t i = 0; i < header.records && position + sizeof(RecordHeader) <= header.length; i++) {
+        RecordHeader recordHeader;
+        memcpy(&recordHeader, readBuffer + position, sizeof(recordHeader));
+        size_t recordLength = sizeof(recordHeader) + recordHeader.nodeLength + recordHeader.programLength
+                              + recordHeader.textLength;
+        if (position + recordLength > header.length || recordHeader.nodeLength >= SS_FIELD_LENGTH
+            || recordHeader.programLength >= SS_FIELD_LENGTH) {
+            return false;
+        }
+
+        SegmentRecord record;
+        const char *fields = readBuffer + position + sizeof(recordHeader);
+        record.time = (time_t) recordHeader.time;
+        record.kind = recordHeader.kind;
+        copyField(record.node, fields, recordHeader.nodeLength);
+        copyField(record.program, fields + recordHeader.nodeLength, recordHeader.programLength);
+        record.text = fields + recordHeader.nodeLength + recordHeader.programLength;
+        record.textLength = recordHeader.textLength;
+        position += recordLength;
+
+        if (overlaps(query, recordHeader.time, recordHeader.time) == false
+            || (query->killsOnly && record.kind != SS_KIND_KILL)
+            || (strlen(query->node) != 0 && strcmp(query->node, record.node) != 0)
+            || (strlen(query->program) != 0 && strcmp(query->program, record.program) != 0)) {
+            continue;
+        }
+        stats->recordsMatched++;
+        operation(&record, context);
+    }
+    return true;
+}
+
+// the index and bloom filters of a sealed segment, false if it was never sealed
+static bool readTrailer(int fd, uint64_t fileSize, SegmentTrailer *trailer) {
+    if (fileSize < sizeof(SegmentHeader) + sizeof(*trailer)
+        || readAt(fd, trailer, sizeof(*trailer), fileSize - sizeof(*trailer)) == false
+        || trailer->magic != SS_TRAILER_MAGIC) {
+        return false;
+    }
+    uint64_t expected = trailer->indexOffset + 2 * BLOOM_BYTES + trailer->blocks * sizeof(BlockIndex)
+                        + sizeof(*trailer);
+    return expected == fileSize;
+}
+
+bool ss_query(const char *path, const SegmentQuery *query, SegmentRecordOperation operation, void *context,
+              SegmentQueryStats *stats) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat details;
+    SegmentHeader header;
+    if (fstat(fd, &details) == -1 || readAt(fd, &header, sizeof(header), 0) == false
+        || memcmp(header.magic, SS_MAGIC, sizeof(header.magic)) != 0) {
+        close(fd);
+        return false;
+    }
+    uint64_t fileSize = (uint64_t) details.st_size;
+    stats->segments++;
+
+    SegmentTrailer trailer;
+    if (readTrailer(fd, fileSize, &trailer)) {
+        unsigned char bloom[BLOOM_BYTES];
+        bool skip = trailer.blocks == 0 || overlaps(query, trailer.firstTime, trailer.lastTime) == false;
+        if (skip == false && strlen(query->node) != 0) {
+            skip = readAt(fd, bloom, sizeof(bloom), trailer.indexOffset) == false
+                   || bloomMayContain(bloom, query->node) == false;
+        }
+        if (skip == false && strlen(query->program) != 0) {
+            skip = readAt(fd, bloom, sizeof(bloom), trailer.indexOffset + BLOOM_BYTES) == false
+                   || bloomMayContain(bloom, query->program) == false;
+        }
+        if (skip) {
+            stats->segmentsSkipped++;
+            close(fd);
+            return true;
+        }
+
+        BlockIndex *entries = malloc(trailer.blocks * sizeof(BlockIndex));
+        if (entries != NULL
+            && readAt(fd, entries, trailer.blocks * sizeof(BlockIndex), trailer.indexOffset + 2 * BLOOM_BYTES)) {
+            for (uint32_t i = 0; i < trailer.blocks; i++) {
+                if (overlaps(query, entries[i].firstTime, entries[i].lastTime)) {
+                    queryBlock(fd, entries[i].offset, fileSize, query, operation, context, stats);
+                }
+                else {
+                    stats->blocksSkipped++;
+                }
+            }
+        }
+        free(entries);
+    }
+    else {
+        // never sealed, walk the block headers up to the last complete block
+        uint64_t offset = sizeof(header);
+        BlockHeader blockHeader;
+        while (offset + sizeof(blockHeader) <= fileSize
+               && readAt(fd, &blockHeader, sizeof(blockHeader), offset)
+               && blockHeader.magic == SS_BLOCK_MAGIC) {
+            if (overlaps(query, blockHeader.firstTime, blockHeader.lastTime)) {
+                if (queryBlock(fd, offset, fileSize, query, operation, context, stats) == false) {
+                    break;
+                }
+            }
+            else {
+                stats->blocksSkipped++;
+            }
+            offset += sizeof(blockHeader) + blockHeader.length;
+        }
+    }
+    close(fd);
+    return true;
+}
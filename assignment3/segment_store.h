@@ -0,0 +1,144 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_STORE_H
+#define SEGMENT_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// An optional binary copy of the server log, split into segment files so a
+// time range on one node or program only reads the blocks that can hold it.
+//
+// Segment layout:
+//   SegmentHeader
+//   blocks, each a BlockHeader followed by its records back to back
+//   node bloom filter, program bloom filter, BlockIndex per block
+//   SegmentTrailer
+// The trailer is written when a segment is sealed. A segment left behind by
+// a crash has none, readers then walk the block headers instead.
+
+#define SS_MAGIC "PNSEG001"
+#define SS_BLOCK_MAGIC 0x4B4C4250u          // "PBLK"
+#define SS_TRAILER_MAGIC 0x4C525450u        // "PTRL"
+#define SS_BLOCK_BYTES 65536                // records are flushed in blocks of this size
+#define SS_BLOCK_MAX_AGE_MS 1000            // or once the oldest record is this old
+#define SS_SEGMENT_BYTES (16 * 1024 * 1024) // a new segment is started past this
+#define SS_BLOOM_BITS 8192
+#define SS_BLOOM_HASHES 4
+#define SS_FIELD_LENGTH 256
+
+enum {
+    SS_KIND_LOG = 0,        // any line of the text log
+    SS_KIND_KILL = 1        // a process killed by a client
+};
+
+typedef struct _SegmentHeader {
+    char magic[8];
+    int64_t created;
+} SegmentHeader;
+
+typedef struct _BlockHeader {
+    uint32_t magic;
+    uint32_t records;
+    uint32_t length;        // bytes of records after this header
+    uint32_t reserved;
+    int64_t firstTime;      // smallest and largest record time in the block
+    int64_t lastTime;
+} BlockHeader;
+
+typedef struct _BlockIndex {
+    uint64_t offset;        // of the block header
+    int64_t firstTime;
+    int64_t lastTime;
+} BlockIndex;
+
+typedef struct _SegmentTrailer {
+    uint64_t indexOffset;   // of the node bloom filter
+    uint32_t blocks;
+    uint32_t magic;
+    int64_t firstTime;
+    int64_t lastTime;
+} SegmentTrailer;
+
+// each record in a block, followed by the node, program and text bytes
+typedef struct _RecordHeader {
+    int64_t time;
+    uint16_t nodeLength;
+    uint16_t programLength;
+    uint16_t textLength;    // the text log line, newline included
+    uint8_t kind;
+    uint8_t reserved;
+} RecordHeader;
+
+typedef struct _SegmentRecord {
+    time_t time;
+    int kind;
+    char node[SS_FIELD_LENGTH];
+    char program[SS_FIELD_LENGTH];
+    const char *text;       // valid until the next record is read
+    size_t textLength;
+} SegmentRecord;
+
+// filters for ss_query, empty strings and zero times match everything
+typedef struct _SegmentQuery {
+    time_t from;
+    time_t to;              // inclusive
+    char node[SS_FIELD_LENGTH];
+    char program[SS_FIELD_LENGTH];
+    bool killsOnly;
+} SegmentQuery;
+
+typedef struct _SegmentQueryStats {
+    unsigned long segments;
+    unsigned long segmentsSkipped;  // by time range or bloom filter
+    unsigned long blocksRead;
+    unsigned long blocksSkipped;
+    unsigned long long recordsMatched;
+} SegmentQueryStats;
+
+typedef void (*SegmentRecordOperation)(const SegmentRecord *record, void *context);
+
+// writer side, used from the server's main thread only
+
+// starts a new segment in directory, creating the directory if needed
+bool    ss_open(const char *directory);
+
+// flushes the last block and seals the open segment
+void    ss_close();
+
+bool    ss_isOpen();
+
+// does nothing unless a segment is open
+void    ss_append(int kind, time_t when, const char *node, const char *program, const char *text, size_t length);
+
+// writes out a block that has gone stale, returns false on a write error
+bool    ss_flushIfStale();
+
+// milliseconds until the pending block goes stale, -1 when nothing is pending
+long    ss_msUntilFlush();
+
+// reader side
+
+// calls operation for every record in the segment file at path that passes
+// query, returns false if the file is not a segment
+bool    ss_query(const char *path, const SegmentQuery *query, SegmentRecordOperation operation, void *context,
+                 SegmentQueryStats *stats);
+
+#endif //SEGMENT_STORE_H
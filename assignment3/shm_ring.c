@@ -0,0 +1,269 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "shm_ring.h"
+#include "memwatch.h"
+
+#define CACHE_LINE 64
+
+// head and tail only ever grow, their difference is the bytes in the ring
+struct _ShmRingHeader {
+    size_t capacity;
+    char padCapacity[CACHE_LINE - sizeof(size_t)];
+    size_t head;        // written by the producer
+    char padHead[CACHE_LINE - sizeof(size_t)];
+    size_t tail;        // written by the consumer
+    char padTail[CACHE_LINE - sizeof(size_t)];
+};
+
+static bool mapRing(ShmRing *ring, size_t capacity) {
+    void *mapped = mmap(NULL, sizeof(ShmRingHeader) + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, ring->memfd, 0);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    ring->header = mapped;
+    ring->data = (char *) mapped + sizeof(ShmRingHeader);
+    ring->capacity = capacity;
+    return true;
+}
+
+bool sr_create(ShmRing *ring, size_t capacity) {
+    ring->header = NULL;
+    ring->memfd = memfd_create("procnanny-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ring->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring->memfd == -1 || ring->eventfd == -1
+        || ftruncate(ring->memfd, (off_t) (sizeof(ShmRingHeader) + capacity)) == -1
+        || fcntl(ring->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1
+        || mapRing(ring, capacity) == false) {
+        sr_close(ring);
+        return false;
+    }
+    // a fresh memfd is zero filled, so head and tail already start at 0
+    ring->header->capacity = capacity;
+    return true;
+}
+
+bool sr_attach(ShmRing *ring, int memfd, int eventfd) {
+    ring->header = NULL;
+    ring->memfd = memfd;
+    ring->eventfd = eventfd;
+
+    // the other end picked the size, make sure the memfd really is that big
+    // and can not be shrunk under us later
+    ShmRingHeader header;
+    struct stat status;
+    int seals = fcntl(memfd, F_GET_SEALS);
+    if (seals == -1 || (seals & F_SEAL_SHRINK) == 0
+        || pread(memfd, &header, sizeof(header), 0) != sizeof(header)
+        || header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0
+        || fstat(memfd, &status) == -1 || (size_t) status.st_size < sizeof(ShmRingHeader) + header.capacity
+        || mapRing(ring, header.capacity) == false) {
+        sr_close(ring);
+        return false;
+    }
+    return true;
+}
+
+void sr_close(ShmRing *ring) {
+    if (ring->header != NULL) {
+        munmap(ring->header, sizeof(ShmRingHeader) + ring->capacity);
+    }
+    if (ring->memfd > 0) {
+        close(ring->memfd);
+    }
+    if (ring->eventfd > 0) {
+        close(ring->eventfd);
+    }
+    ring->header = NULL;
+    ring->data = NULL;
+    ring->memfd = 0;
+    ring->eventfd = 0;
+}
+
+bool sr_isOpen(const ShmRing *ring) {
+    return ring->header != NULL;
+}
+
+int sr_notifyFd(const ShmRing *ring) {
+    return ring->eventfd;
+}
+
+bool sr_isEmpty(const ShmRing *ring) {
+    return __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE)
+           == __atomic_load_n(&ring->header->tail, __ATOMIC_RELAXED);
+}
+
+size_t sr_write(ShmRing *ring, const void *data, size_t length) {
+    ShmRingHeader *header = ring->header;
+    size_t head = header->head;
+    size_t tail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+    size_t space = ring->capacity - (head - tail);
+    if (length > space) {
+        length = space;
+    }
+    if (length == 0) {
+        return 0;
+    }
+
+    size_t offset = head & (ring->capacity - 1);
+    size_t first = ring->capacity - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(ring->data + offset, data, first);
+    memcpy(ring->data, (const char *) data + first, length - first);
+    __atomic_store_n(&header->head, head + length, __ATOMIC_RELEASE);
+
+    // only wake the consumer if it had caught up, it may be asleep. Pairs
+    // with the fence in sr_read so one side always sees the other's store.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->tail, __ATOMIC_RELAXED) == head) {
+        uint64_t one = 1;
+        write(ring->eventfd, &one, sizeof(one));
+    }
+    return length;
+}
+
+bool sr_writeAll(ShmRing *ring, const void *data, size_t length) {
+    int spins = 0;
+    while (length > 0) {
+        size_t written = sr_write(ring, data, length);
+        data = (const char *) data + written;
+        length -= written;
+        if (written == 0) {
+            if (++spins > SHM_RING_WRITE_SPINS) {
+                return false;
+            }
+            sched_yield();
+        }
+    }
+    return true;
+}
+
+size_t sr_read(ShmRing *ring, void *out, size_t capacity) {
+    ShmRingHeader *header = ring->header;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    size_t tail = header->tail;
+    size_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        // about to report empty, so clear the wakeup and look once more. A
+        // write after the clear sets it again, one before it is seen here.
+        uint64_t count;
+        read(ring->eventfd, &count, sizeof(count));
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    }
+    size_t length = head - tail;
+    if (length > capacity) {
+        length = capacity;
+    }
+    if (length == 0) {
+        return 0;
+    }
+
+    size_t offset = tail & (ring->capacity - 1);
+    size_t first = ring->capacity - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(out, ring->data + offset, first);
+    memcpy((char *) out + first, ring->data, length - first);
+    __atomic_store_n(&header->tail, tail + length, __ATOMIC_RELEASE);
+    return length;
+}
+
+bool sr_sendFds(int sd, const char *token, const int fds[SHM_RING_FDS]) {
+    char control[CMSG_SPACE(sizeof(int) * SHM_RING_FDS)];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov;
+    iov.iov_base = (void *) token;
+    iov.iov_len = strlen(token) + 1;
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * SHM_RING_FDS);
+    memcpy(CMSG_DATA(header), fds, sizeof(int) * SHM_RING_FDS);
+
+    return sendmsg(sd, &message, MSG_NOSIGNAL) == (ssize_t) iov.iov_len;
+}
+
+// whatever descriptors a message we are not going to use brought with it
+static void closeReceivedFds(struct msghdr *message) {
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(message); header != NULL; header = CMSG_NXTHDR(message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+            close(fd);
+        }
+    }
+}
+
+bool sr_receiveFds(int sd, char *token, size_t tokenLength, int fds[SHM_RING_FDS]) {
+    char control[CMSG_SPACE(sizeof(int) * SHM_RING_FDS)];
+
+    struct iovec iov;
+    iov.iov_base = token;
+    iov.iov_len = tokenLength - 1;
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(sd, &message, MSG_CMSG_CLOEXEC);
+    if (received <= 0) {
+        return false;
+    }
+    token[received] = '\0';
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (header == NULL || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+        || header->cmsg_len != CMSG_LEN(sizeof(int) * SHM_RING_FDS)) {
+        closeReceivedFds(&message);
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(header), sizeof(int) * SHM_RING_FDS);
+    return true;
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// One direction of a shared memory connection: a single producer, single
+// consumer byte ring in a memfd, plus an eventfd the producer counts up
+// whenever the ring stops being empty so the consumer can sleep in select.
+
+#define SHM_RING_SIZE (1 << 20)
+#define SHM_RING_WRITE_SPINS 100000  // yields before a full ring counts as a dead peer
+#define SHM_RING_FDS 4               // memfd and eventfd for each direction
+
+typedef struct _ShmRingHeader ShmRingHeader;
+
+typedef struct _ShmRing {
+    ShmRingHeader *header;
+    char *data;
+    size_t capacity;
+    int memfd;
+    int eventfd;
+} ShmRing;
+
+// a fresh ring backed by a new memfd, returns false if either fd could not be made
+bool    sr_create(ShmRing *ring, size_t capacity);
+
+// maps a ring created by the other end, takes ownership of both fds
+bool    sr_attach(ShmRing *ring, int memfd, int eventfd);
+
+void    sr_close(ShmRing *ring);
+
+bool    sr_isOpen(const ShmRing *ring);
+
+// readable whenever the ring may have data
+int     sr_notifyFd(const ShmRing *ring);
+
+bool    sr_isEmpty(const ShmRing *ring);
+
+// copies as much as fits and returns how much that was
+size_t  sr_write(ShmRing *ring, const void *data, size_t length);
+
+// keeps yielding until everything is written, false if the consumer stopped reading
+bool    sr_writeAll(ShmRing *ring, const void *data, size_t length);
+
+// returns 0 once the ring is empty
+size_t  sr_read(ShmRing *ring, void *out, size_t capacity);
+
+// passes the fds of both rings and a token over a connected UNIX socket
+bool    sr_sendFds(int sd, const char *token, const int fds[SHM_RING_FDS]);
+
+// receives what sr_sendFds sent, token must hold at least tokenLength bytes
+bool    sr_receiveFds(int sd, char *token, size_t tokenLength, int fds[SHM_RING_FDS]);
+
+#endif //SHM_RING_H
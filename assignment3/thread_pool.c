@@ -0,0 +1,180 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include "thread_pool.h"
+#include "memwatch.h"
+
+typedef struct _PoolJob {
+    PoolTask task;
+    void *argument;
+    int chunks;
+    int nextChunk;          // taken with an atomic add
+    int unfinished;
+    int joined;             // workers still holding on to the job
+} PoolJob;
+
+static pthread_t workers[TP_MAX_THREADS];
+static int workerCount = 0;
+static pid_t owner = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+// one job at a time
+static pthread_mutex_t runLock = PTHREAD_MUTEX_INITIALIZER;
+
+static PoolJob *job = NULL;
+static unsigned long jobNumber = 0;
+static bool stopping = false;
+
+static __thread bool insideTask = false;
+
+// takes chunks until none are left, returns how many this thread ran
+static int runChunks(PoolJob *current) {
+    int ran = 0;
+    insideTask = true;
+    while (true) {
+        int chunk = __atomic_fetch_add(&current->nextChunk, 1, __ATOMIC_RELAXED);
+        if (chunk >= current->chunks) {
+            break;
+        }
+        current->task(chunk, current->argument);
+        ran++;
+    }
+    insideTask = false;
+    return ran;
+}
+
+static void *workerMain(void *unused) {
+    unsigned long seen = 0;
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (stopping == false && (job == NULL || jobNumber == seen)) {
+            pthread_cond_wait(&jobReady, &lock);
+        }
+        if (stopping) {
+            break;
+        }
+        seen = jobNumber;
+        PoolJob *current = job;
+        current->joined++;
+        pthread_mutex_unlock(&lock);
+
+        int ran = runChunks(current);
+
+        pthread_mutex_lock(&lock);
+        current->unfinished -= ran;
+        current->joined--;
+        if (current->unfinished == 0 && current->joined == 0) {
+            pthread_cond_signal(&jobDone);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return unused;
+}
+
+bool tp_start(int threads) {
+    if (workerCount > 0) {
+        return true;
+    }
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > TP_MAX_THREADS) {
+        threads = TP_MAX_THREADS;
+    }
+
+    // signals stay with the threads that were already running
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    stopping = false;
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&workers[workerCount], NULL, &workerMain, NULL) != 0) {
+            break;
+        }
+        workerCount++;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    owner = getpid();
+    return workerCount > 0;
+}
+
+void tp_stop() {
+    // forked children inherit the state but none of the threads
+    if (workerCount == 0 || getpid() != owner) {
+        workerCount = 0;
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&jobReady);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < workerCount; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    workerCount = 0;
+}
+
+int tp_threads() {
+    return workerCount + 1;
+}
+
+void tp_run(PoolTask task, int chunks, void *argument) {
+    if (chunks <= 0) {
+        return;
+    }
+    if (workerCount == 0 || chunks == 1 || insideTask || getpid() != owner) {
+        for (int i = 0; i < chunks; i++) {
+            task(i, argument);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&runLock);
+    PoolJob current;
+    current.task = task;
+    current.argument = argument;
+    current.chunks = chunks;
+    current.nextChunk = 0;
+    current.unfinished = chunks;
+    current.joined = 0;
+
+    pthread_mutex_lock(&lock);
+    job = &current;
+    jobNumber++;
+    pthread_cond_broadcast(&jobReady);
+    pthread_mutex_unlock(&lock);
+
+    int ran = runChunks(&current);
+
+    // the job lives on this stack, so wait for every worker to let go of it
+    pthread_mutex_lock(&lock);
+    current.unfinished -= ran;
+    while (current.unfinished > 0 || current.joined > 0) {
+        pthread_cond_wait(&jobDone, &lock);
+    }
+    job = NULL;
+    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&runLock);
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdbool.h>
+
+// One pool of worker threads shared by the whole program. tp_run hands out
+// the chunks of a job to the workers and the calling thread alike and returns
+// once every chunk is done. Without a pool, or when called from inside a
+// task, the chunks simply run in the caller.
+
+#define TP_MAX_THREADS 64
+
+// runs once per chunk, with chunk from 0 to chunks - 1
+typedef void (*PoolTask)(int chunk, void *argument);
+
+// threads counts the caller too, 0 picks one per online CPU. Returns false
+// if no worker could be started.
+bool    tp_start(int threads);
+
+void    tp_stop();
+
+// threads taking part in tp_run, 1 without a pool
+int     tp_threads();
+
+void    tp_run(PoolTask task, int chunks, void *argument);
+
+#endif //THREAD_POOL_H
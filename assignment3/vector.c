@@ -0,0 +1,211 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "vector.h"
+#include "memwatch.h"
+
+#define INDEX_MASK ((1ull << VC_INDEX_BITS) - 1)
+
+static VectorHandle handleOf(Vector *vector, int slot) {
+    return ((VectorHandle) vector->slots[slot].generation << VC_INDEX_BITS) | (VectorHandle) slot;
+}
+
+// the slot behind a handle, or NULL if the handle is stale
+static VectorSlot* slotOf(Vector *vector, VectorHandle handle) {
+    VectorHandle slot = handle & INDEX_MASK;
+    if (handle == 0 || slot >= (VectorHandle) vector->capacity) {
+        return NULL;
+    }
+    VectorSlot *entry = &vector->slots[slot];
+    return entry->generation == handle >> VC_INDEX_BITS ? entry : NULL;
+}
+
+static bool grow(Vector *vector) {
+    if (vector->capacity >= VC_MAX_CAPACITY) {
+        return false;
+    }
+    int capacity = vector->capacity * 2;
+    char *items = malloc((size_t) capacity * vector->itemSize);
+    VectorHandle *handles = malloc(sizeof(VectorHandle) * (size_t) capacity);
+    VectorSlot *slots = malloc(sizeof(VectorSlot) * (size_t) capacity);
+    if (items == NULL || handles == NULL || slots == NULL) {
+        free(items);
+        free(handles);
+        free(slots);
+        return false;
+    }
+
+    memcpy(items, vector->items, (size_t) vector->length * vector->itemSize);
+    memcpy(handles, vector->handles, sizeof(VectorHandle) * (size_t) vector->length);
+    memcpy(slots, vector->slots, sizeof(VectorSlot) * (size_t) vector->capacity);
+    // the new slots join the free list, lowest first
+    for (int i = vector->capacity; i < capacity; i++) {
+        slots[i].index = i + 1 < capacity ? i + 1 : -1;
+        slots[i].generation = 1;
+    }
+    vector->freeSlot = vector->capacity;
+
+    free(vector->items);
+    free(vector->handles);
+    free(vector->slots);
+    vector->items = items;
+    vector->handles = handles;
+    vector->slots = slots;
+    vector->capacity = capacity;
+    return true;
+}
+
+void vc_init(Vector *vector, size_t itemSize) {
+    vector->length = 0;
+    vector->capacity = VC_INITIAL_CAPACITY;
+    vector->itemSize = itemSize;
+    vector->items = malloc((size_t) VC_INITIAL_CAPACITY * itemSize);
+    vector->handles = malloc(sizeof(VectorHandle) * VC_INITIAL_CAPACITY);
+    vector->slots = malloc(sizeof(VectorSlot) * VC_INITIAL_CAPACITY);
+    for (int i = 0; i < VC_INITIAL_CAPACITY; i++) {
+        vector->slots[i].index = i + 1 < VC_INITIAL_CAPACITY ? i + 1 : -1;
+        vector->slots[i].generation = 1;
+    }
+    vector->freeSlot = 0;
+}
+
+void vc_free(Vector *vector) {
+    free(vector->items);
+    free(vector->handles);
+    free(vector->slots);
+    vector->items = NULL;
+    vector->handles = NULL;
+    vector->slots = NULL;
+    vector->length = 0;
+    vector->capacity = 0;
+    vector->freeSlot = -1;
+}
+
+void* vc_emplace(Vector *vector, VectorHandle *handle) {
+    // there are as many slots as items fit, so a full vector has no free slot
+    if (vector->freeSlot == -1 && grow(vector) == false) {
+        if (handle != NULL) {
+            *handle = 0;
+        }
+        return NULL;
+    }
+    int slot = vector->freeSlot;
+    vector->freeSlot = vector->slots[slot].index;
+    vector->slots[slot].index = vector->length;
+    vector->handles[vector->length] = handleOf(vector, slot);
+    if (handle != NULL) {
+        *handle = handleOf(vector, slot);
+    }
+
+    void *item = vector->items + (size_t) vector->length * vector->itemSize;
+    memset(item, 0, vector->itemSize);
+    vector->length++;
+    return item;
+}
+
+VectorHandle vc_add(Vector *vector, void *item) {
+    VectorHandle handle;
+    void *slot = vc_emplace(vector, &handle);
+    if (slot != NULL) {
+        memcpy(slot, item, vector->itemSize);
+    }
+    return handle;
+}
+
+void* vc_get(Vector *vector, VectorHandle handle) {
+    VectorSlot *slot = slotOf(vector, handle);
+    return slot != NULL ? vector->items + (size_t) slot->index * vector->itemSize : NULL;
+}
+
+bool vc_remove(Vector *vector, VectorHandle handle) {
+    VectorSlot *slot = slotOf(vector, handle);
+    if (slot == NULL) {
+        return false;
+    }
+
+    // the last item fills the gap and its slot follows it
+    int index = slot->index;
+    int last = vector->length - 1;
+    if (index != last) {
+        memcpy(vector->items + (size_t) index * vector->itemSize,
+               vector->items + (size_t) last * vector->itemSize, vector->itemSize);
+        vector->handles[index] = vector->handles[last];
+        vector->slots[vector->handles[index] & INDEX_MASK].index = index;
+    }
+    vector->length--;
+
+    // generation 0 is skipped so that no handle is ever 0
+    slot->generation++;
+    if (slot->generation == 0) {
+        slot->generation = 1;
+    }
+    slot->index = vector->freeSlot;
+    vector->freeSlot = (int) (handle & INDEX_MASK);
+    return true;
+}
+
+void* vc_at(Vector *vector, int index) {
+    return vector->items + (size_t) index * vector->itemSize;
+}
+
+void vc_forEach(Vector *vector, NodeOperation operation) {
+    if (operation == NULL) {
+        return;
+    }
+    char *item = vector->items;
+    for (int i = 0; i < vector->length; i++, item += vector->itemSize) {
+        if (i + VC_PREFETCH_DISTANCE < vector->length) {
+            __builtin_prefetch(item + VC_PREFETCH_DISTANCE * vector->itemSize);
+        }
+        operation(item);
+    }
+}
+
+void vc_forEachWith(Vector *vector, ContextOperation operation, void *context) {
+    if (operation == NULL) {
+        return;
+    }
+    char *item = vector->items;
+    for (int i = 0; i < vector->length; i++, item += vector->itemSize) {
+        if (i + VC_PREFETCH_DISTANCE < vector->length) {
+            __builtin_prefetch(item + VC_PREFETCH_DISTANCE * vector->itemSize);
+        }
+        operation(item, context);
+    }
+}
+
+void vc_removeIf(Vector *vector, Predicate operation) {
+    if (operation == NULL) {
+        return;
+    }
+    // whatever is swapped into position i is tested before moving on
+    int i = 0;
+    while (i < vector->length) {
+        if (operation(vc_at(vector, i))) {
+            vc_remove(vector, vector->handles[i]);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+int vc_size(Vector *vector) {
+    return vector->length;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright 2015 Kyle O'Shaughnessy
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "linked_list.h"
+
+// Items kept packed in one growing array, so walking them streams memory
+// instead of chasing nodes. Removal moves the last item into the gap, which
+// changes indexes and addresses, so items are found again through handles:
+// a handle stays valid, and keeps naming the same item, until that item is
+// removed. Handles of removed items are recognised as stale, until one slot
+// has been reused 2^32 - 1 times and its generation comes round again.
+
+#define VC_INITIAL_CAPACITY 16
+#define VC_INDEX_BITS 32
+// the most items a vector grows to, an int capacity cannot double past it
+#define VC_MAX_CAPACITY (1 << 30)
+// items ahead of the current one prefetched by vc_forEach
+#define VC_PREFETCH_DISTANCE 4
+
+// the slot's generation above its index, 0 is never a valid handle
+typedef unsigned long long VectorHandle;
+
+typedef struct _VectorSlot {
+    int index;                  // the item's position, or the next free slot
+    unsigned int generation;    // bumped when the item is removed
+} VectorSlot;
+
+typedef struct _Vector {
+    int length;
+    int capacity;
+    size_t itemSize;
+    char *items;
+    VectorHandle *handles;      // the handle of each item, in item order
+    VectorSlot *slots;          // capacity of them, one per handle index
+    int freeSlot;               // -1 once every slot has been handed out
+} Vector;
+
+void    vc_init(Vector *vector, size_t itemSize);
+
+void    vc_free(Vector *vector);
+
+// copies the item in, returns its handle or 0 if the vector cannot grow
+VectorHandle vc_add(Vector *vector, void *item);
+
+// appends a zeroed item to be filled in place, handle may be NULL. Returns
+// NULL once VC_MAX_CAPACITY items are held or memory runs out.
+void*   vc_emplace(Vector *vector, VectorHandle *handle);
+
+// NULL if the handle is stale. Pointers stay valid until the next add or
+// remove, hold on to the handle instead.
+void*   vc_get(Vector *vector, VectorHandle handle);
+
+// returns false if the handle is stale
+bool    vc_remove(Vector *vector, VectorHandle handle);
+
+// 0 <= index < vc_size
+void*   vc_at(Vector *vector, int index);
+
+// in memory order, the operation must not add or remove items
+void    vc_forEach(Vector *vector, NodeOperation operation);
+
+void    vc_forEachWith(Vector *vector, ContextOperation operation, void *context);
+
+void    vc_removeIf(Vector *vector, Predicate operation);
+
+int     vc_size(Vector *vector);
+
+#endif //VECTOR_H